@@ -0,0 +1,529 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef MYL_TEST
+#include <sstream>
+#include <Test/Test.h>
+#endif
+#include <Tracing/Tracing.h>
+
+#include "AstCache.h"
+
+extern TraceContext TC;
+
+namespace {
+
+constexpr char MAGIC[ 4 ] = { 'M', 'Y', 'L', 'A' };
+// Bump whenever the format changes, so old entries become misses.
+constexpr std::uint32_t FORMAT_VERSION = 1;
+
+struct Header {
+    char magic[ 4 ];
+    std::uint32_t version;
+    std::uint64_t sourceHash;
+    std::uint64_t sourceSize;
+};
+
+enum Tag : unsigned char {
+    // An absent `car` or `cdr`.
+    TAG_NONE,
+    TAG_CONS,
+    TAG_INT32,
+    TAG_FLOAT64,
+    TAG_SYMBOL,
+    TAG_LABEL,
+    TAG_PROC,
+};
+
+void
+writeVarint( std::string & out, std::uint64_t value ) {
+    while ( value >= 0x80 ) {
+        out.push_back( static_cast< char >( value | 0x80 ) );
+        value >>= 7;
+    }
+    out.push_back( static_cast< char >( value ) );
+}
+
+// Bounds-checked reads over an entry. Once a read fails, `ok` stays false and every
+// later read returns zero, so callers can check once at the end of a record.
+class Reader {
+public:
+    explicit Reader( std::string_view bytes )
+        : m_p( reinterpret_cast< const unsigned char * >( bytes.data() ) ),
+          m_end( m_p + bytes.size() ) {}
+
+    bool ok = true;
+
+    size_t remaining() const { return this->m_end - this->m_p; }
+
+    unsigned char
+    byte() {
+        if ( this->m_p == this->m_end ) {
+            this->ok = false;
+            return 0;
+        }
+        return *this->m_p++;
+    }
+
+    std::uint64_t
+    varint() {
+        std::uint64_t value = 0;
+        for ( int shift = 0; shift < 64; shift += 7 ) {
+            const unsigned char b = this->byte();
+            value |= std::uint64_t( b & 0x7f ) << shift;
+            if ( !( b & 0x80 ) ) {
+                return value;
+            }
+        }
+        this->ok = false;
+        return 0;
+    }
+
+    const char *
+    bytes( size_t n ) {
+        if ( n > this->remaining() ) {
+            this->ok = false;
+            this->m_p = this->m_end;
+            return nullptr;
+        }
+        const auto * p = reinterpret_cast< const char * >( this->m_p );
+        this->m_p += n;
+        return p;
+    }
+
+private:
+    const unsigned char * m_p;
+    const unsigned char * m_end;
+};
+
+std::optional< Parser::Result >
+decode( std::string_view bytes, std::uint64_t sourceHash, size_t sourceSize,
+        SymbolInterner & interner, SourceOffset baseOffset ) {
+    Header header;
+    if ( bytes.size() < sizeof( header ) ) {
+        return std::nullopt;
+    }
+    std::memcpy( &header, bytes.data(), sizeof( header ) );
+    if ( std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 ||
+         header.version != FORMAT_VERSION || header.sourceHash != sourceHash ||
+         header.sourceSize != sourceSize ) {
+        return std::nullopt;
+    }
+    Reader in( bytes.substr( sizeof( header ) ) );
+
+    // Every record takes at least a byte, which bounds counts read from the entry.
+    const auto count = [ & ]() {
+        const auto n = in.varint();
+        if ( n > in.remaining() ) {
+            in.ok = false;
+            return size_t( 0 );
+        }
+        return static_cast< size_t >( n );
+    };
+
+    std::vector< InternedSymbol > symbols( count() );
+    for ( auto & symbol : symbols ) {
+        const size_t length = in.varint();
+        const char * text = in.bytes( length );
+        if ( !in.ok ) {
+            return std::nullopt;
+        }
+        symbol = interner.intern( std::string_view( text, length ) );
+    }
+    const auto symbol = [ & ]() {
+        const auto idx = in.varint();
+        if ( idx >= symbols.size() ) {
+            in.ok = false;
+            return InternedSymbol( 0 );
+        }
+        return symbols[ idx ];
+    };
+
+    Parser::Result result{ {}, false, {} };
+    const size_t formCount = count();
+    result.locs.reserve( formCount );
+    for ( size_t i = 0; i < formCount; ++i ) {
+        const auto offset = in.varint();
+        const auto length = in.varint();
+        if ( offset > sourceSize || length > sourceSize - offset ) {
+            return std::nullopt;
+        }
+        result.locs.push_back( { static_cast< SourceOffset >( offset ) + baseOffset,
+                                 static_cast< SourceOffset >( length ) } );
+    }
+
+    // Slots still to be filled, in stream order. Slots point into nodes that are
+    // already in the tree, which don't move.
+    std::vector< std::unique_ptr< SExpr::Base > * > slots;
+    result.sexprs.resize( formCount );
+    for ( auto it = result.sexprs.rbegin(); it != result.sexprs.rend(); ++it ) {
+        slots.push_back( &*it );
+    }
+    while ( !slots.empty() && in.ok ) {
+        auto & slot = *slots.back();
+        slots.pop_back();
+        switch ( in.byte() ) {
+        case TAG_NONE:
+            break;
+        case TAG_CONS: {
+            auto cons = std::make_unique< SExpr::Cons >();
+            slots.push_back( &cons->cdr );
+            slots.push_back( &cons->car );
+            slot = std::move( cons );
+            break;
+        }
+        case TAG_INT32: {
+            const auto zigzag = static_cast< std::uint32_t >( in.varint() );
+            slot = std::make_unique< SExpr::Int32 >(
+                static_cast< I32 >( ( zigzag >> 1 ) ^ -( zigzag & 1 ) ) );
+            break;
+        }
+        case TAG_FLOAT64: {
+            F64 value = 0;
+            if ( const char * p = in.bytes( sizeof( value ) ) ) {
+                std::memcpy( &value, p, sizeof( value ) );
+            }
+            slot = std::make_unique< SExpr::Float64 >( value );
+            break;
+        }
+        case TAG_SYMBOL:
+            slot = std::make_unique< SExpr::Symbol >( symbol() );
+            break;
+        case TAG_LABEL:
+            slot = std::make_unique< SExpr::Label >( symbol() );
+            break;
+        case TAG_PROC: {
+            const auto procSymbol = symbol();
+            std::vector< SExpr::Proc::Parameter > parameters( count() );
+            for ( auto & parameter : parameters ) {
+                // Whether there is a label, then its symbol index if so.
+                if ( in.varint() != 0 ) {
+                    parameter.label = symbol();
+                }
+            }
+            auto proc = std::make_unique< SExpr::Proc >(
+                SExpr::Symbol( procSymbol ), std::move( parameters ) );
+            for ( auto it = proc->parameters.rbegin(); it != proc->parameters.rend();
+                  ++it ) {
+                slots.push_back( &it->value );
+            }
+            slot = std::move( proc );
+            break;
+        }
+        default:
+            in.ok = false;
+        }
+    }
+    if ( !in.ok || in.remaining() != 0 ) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace
+
+std::uint64_t
+AstCache::hashSource( std::string_view source ) {
+    constexpr std::uint64_t K1 = 0x9e3779b97f4a7c15ull;
+    constexpr std::uint64_t K2 = 0xbf58476d1ce4e5b9ull;
+    const auto rotl = []( std::uint64_t x, int r ) { return ( x << r ) | ( x >> ( 64 - r ) ); };
+    const auto word = [ & ]( size_t i ) {
+        std::uint64_t w;
+        std::memcpy( &w, source.data() + i, sizeof( w ) );
+        return w;
+    };
+    const auto mix = [ & ]( std::uint64_t h, std::uint64_t w ) {
+        return rotl( h ^ ( w * K1 ), 31 ) * K2;
+    };
+
+    // Four independent lanes, so the multiplies of consecutive words overlap.
+    std::uint64_t lanes[ 4 ] = { K1, K2, K1 ^ K2, ~K1 };
+    size_t i = 0;
+    for ( ; i + 32 <= source.size(); i += 32 ) {
+        for ( int lane = 0; lane < 4; ++lane ) {
+            lanes[ lane ] = mix( lanes[ lane ], word( i + 8 * lane ) );
+        }
+    }
+    std::uint64_t h = source.size() * K1;
+    for ( int lane = 0; lane < 4; ++lane ) {
+        h = mix( h, lanes[ lane ] );
+    }
+    for ( ; i + 8 <= source.size(); i += 8 ) {
+        h = mix( h, word( i ) );
+    }
+    std::uint64_t tail = 0;
+    std::memcpy( &tail, source.data() + i, source.size() - i );
+    h = mix( h, tail );
+
+    h ^= h >> 30;
+    h *= K2;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    return h ^ ( h >> 31 );
+}
+
+std::string
+AstCache::entryPath( std::uint64_t hash ) const {
+    char name[ 32 ];
+    std::snprintf( name, sizeof( name ), "%016llx.mylast",
+                   static_cast< unsigned long long >( hash ) );
+    return this->m_directory + "/" + name;
+}
+
+std::string
+AstCache::serialize( std::string_view source, const Parser::Result & result,
+                     const SymbolInterner & interner, SourceOffset baseOffset ) {
+    // Symbols are numbered in order of first use, and the table is written after
+    // the tree has been walked, so the tree goes to a buffer of its own first.
+    std::unordered_map< InternedSymbol, std::uint32_t > symbolIdxs;
+    std::vector< InternedSymbol > symbols;
+    const auto symbolIdx = [ & ]( InternedSymbol symbol ) {
+        const auto [ it, inserted ] = symbolIdxs.emplace( symbol, symbols.size() );
+        if ( inserted ) {
+            symbols.push_back( symbol );
+        }
+        return it->second;
+    };
+
+    std::string tree;
+    std::vector< const SExpr::Base * > pending;
+    for ( auto it = result.sexprs.rbegin(); it != result.sexprs.rend(); ++it ) {
+        pending.push_back( it->get() );
+    }
+    while ( !pending.empty() ) {
+        const auto * node = pending.back();
+        pending.pop_back();
+        if ( !node ) {
+            tree.push_back( TAG_NONE );
+        } else if ( const auto * cons = dynamic_cast< const SExpr::Cons * >( node ) ) {
+            tree.push_back( TAG_CONS );
+            pending.push_back( cons->cdr.get() );
+            pending.push_back( cons->car.get() );
+        } else if ( const auto * i = dynamic_cast< const SExpr::Int32 * >( node ) ) {
+            const auto value = static_cast< std::uint32_t >( i->value );
+            tree.push_back( TAG_INT32 );
+            writeVarint( tree, ( value << 1 ) ^ -( value >> 31 ) );
+        } else if ( const auto * f = dynamic_cast< const SExpr::Float64 * >( node ) ) {
+            tree.push_back( TAG_FLOAT64 );
+            tree.append( reinterpret_cast< const char * >( &f->value ), sizeof( f->value ) );
+        } else if ( const auto * s = dynamic_cast< const SExpr::Symbol * >( node ) ) {
+            tree.push_back( TAG_SYMBOL );
+            writeVarint( tree, symbolIdx( s->value ) );
+        } else if ( const auto * l = dynamic_cast< const SExpr::Label * >( node ) ) {
+            tree.push_back( TAG_LABEL );
+            writeVarint( tree, symbolIdx( l->value ) );
+        } else if ( const auto * proc = dynamic_cast< const SExpr::Proc * >( node ) ) {
+            tree.push_back( TAG_PROC );
+            writeVarint( tree, symbolIdx( proc->procSymbol.value ) );
+            writeVarint( tree, proc->parameters.size() );
+            for ( const auto & parameter : proc->parameters ) {
+                writeVarint( tree, parameter.label ? 1 : 0 );
+                if ( parameter.label ) {
+                    writeVarint( tree, symbolIdx( *parameter.label ) );
+                }
+            }
+            for ( auto it = proc->parameters.rbegin(); it != proc->parameters.rend();
+                  ++it ) {
+                pending.push_back( it->value.get() );
+            }
+        } else {
+            tassert( &TC, false, "Unexpected node in parse result" );
+        }
+    }
+
+    Header header;
+    std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+    header.version = FORMAT_VERSION;
+    header.sourceHash = hashSource( source );
+    header.sourceSize = source.size();
+
+    std::string out( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+    writeVarint( out, symbols.size() );
+    for ( const auto symbol : symbols ) {
+        const auto text = interner.lookup( symbol );
+        writeVarint( out, text.size() );
+        out.append( text );
+    }
+    writeVarint( out, result.locs.size() );
+    for ( const auto & loc : result.locs ) {
+        writeVarint( out, loc.byteOffset() - baseOffset );
+        writeVarint( out, loc.byteLength() );
+    }
+    out.append( tree );
+    return out;
+}
+
+std::optional< Parser::Result >
+AstCache::deserialize( std::string_view bytes, std::string_view source,
+                       SymbolInterner & interner, SourceOffset baseOffset ) {
+    return decode( bytes, hashSource( source ), source.size(), interner, baseOffset );
+}
+
+std::optional< Parser::Result >
+AstCache::load( std::string_view source, SymbolInterner & interner,
+                SourceOffset baseOffset ) const {
+    const auto hash = hashSource( source );
+    const auto path = this->entryPath( hash );
+    const int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return std::nullopt;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+        close( fd );
+        return std::nullopt;
+    }
+    const size_t size = static_cast< size_t >( st.st_size );
+    void * mapping = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( mapping == MAP_FAILED ) {
+        return std::nullopt;
+    }
+    madvise( mapping, size, MADV_SEQUENTIAL );
+    auto result = decode( std::string_view( static_cast< const char * >( mapping ), size ),
+                          hash, source.size(), interner, baseOffset );
+    munmap( mapping, size );
+    if ( !result ) {
+        t1( &TC, "Ignoring unusable cache entry %s", path.c_str() );
+    }
+    return result;
+}
+
+bool
+AstCache::store( std::string_view source, const Parser::Result & result,
+                 const SymbolInterner & interner, SourceOffset baseOffset ) const {
+    tassert( &TC, !result.error, "Caching a parse that failed" );
+    if ( mkdir( this->m_directory.c_str(), 0755 ) != 0 && errno != EEXIST ) {
+        std::cerr << "error: " << this->m_directory << ": " << std::strerror( errno )
+                  << "\n";
+        return false;
+    }
+    const auto bytes = serialize( source, result, interner, baseOffset );
+    const auto path = this->entryPath( hashSource( source ) );
+    const auto tempPath = path + ".tmp." + std::to_string( getpid() );
+
+    const int fd = open( tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 ) {
+        std::cerr << "error: " << tempPath << ": " << std::strerror( errno ) << "\n";
+        return false;
+    }
+    size_t written = 0;
+    while ( written < bytes.size() ) {
+        const auto n = write( fd, bytes.data() + written, bytes.size() - written );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            std::cerr << "error: " << tempPath << ": " << std::strerror( errno ) << "\n";
+            close( fd );
+            unlink( tempPath.c_str() );
+            return false;
+        }
+        written += n;
+    }
+    close( fd );
+    if ( rename( tempPath.c_str(), path.c_str() ) != 0 ) {
+        std::cerr << "error: " << path << ": " << std::strerror( errno ) << "\n";
+        unlink( tempPath.c_str() );
+        return false;
+    }
+    return true;
+}
+
+#ifdef MYL_TEST
+void
+testAstCache( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "AST cache" );
+
+    const auto parse = []( std::string_view src,
+                           const std::shared_ptr< SymbolInterner > & interner,
+                           bool procMode ) {
+        auto lexer = Lexer( src, interner );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        parser.setProcMode( procMode );
+        return parser.parse();
+    };
+    const auto toString = []( const Parser::Result & result ) {
+        std::ostringstream os;
+        for ( size_t i = 0; i < result.sexprs.size(); ++i ) {
+            os << *result.sexprs[ i ] << " " << result.locs[ i ] << "\n";
+        }
+        return os.str();
+    };
+    const std::string src =
+        "(a -1 @b 2.5 (c)) 2147483647 -2147483648 ()\n(d @e (f @g a))\nsym";
+
+    { // Round trip, in both parse modes.
+        for ( const bool procMode : { false, true } ) {
+            auto interner = std::make_shared< SymbolInterner >();
+            const auto result = parse( src, interner, procMode );
+            TM42_TEST_ASSERT( ctx, !result.error );
+            const auto bytes = AstCache::serialize( src, result, *interner );
+            const auto loaded = AstCache::deserialize( bytes, src, *interner );
+            TM42_TEST_ASSERT( ctx, loaded );
+            TM42_TEST_ASSERT( ctx, toString( *loaded ) == toString( result ) );
+        }
+    }
+    { // Symbols are remapped into the loading interner.
+        auto writer = std::make_shared< SymbolInterner >();
+        writer->intern( "unrelated" );
+        const auto result = parse( "(x y x)", writer, false );
+        const auto bytes = AstCache::serialize( "(x y x)", result, *writer );
+
+        auto reader = std::make_shared< SymbolInterner >();
+        const auto loaded = AstCache::deserialize( bytes, "(x y x)", *reader, 100 );
+        TM42_TEST_ASSERT( ctx, loaded );
+        TM42_TEST_ASSERT( ctx, reader->size() == 2 );
+        const auto & cons = dynamic_cast< const SExpr::Cons & >( *loaded->sexprs[ 0 ] );
+        const auto & x = dynamic_cast< const SExpr::Symbol & >( *cons.car );
+        TM42_TEST_ASSERT( ctx, reader->lookup( x.value ) == "x" );
+        TM42_TEST_ASSERT( ctx, loaded->locs[ 0 ].byteOffset() == 100 );
+    }
+    { // Entries that don't match or don't make sense are misses.
+        auto interner = std::make_shared< SymbolInterner >();
+        const auto result = parse( src, interner, false );
+        const auto bytes = AstCache::serialize( src, result, *interner );
+        auto changed = src;
+        changed[ 1 ] = 'z';
+        TM42_TEST_ASSERT( ctx, AstCache::hashSource( changed ) !=
+                                   AstCache::hashSource( src ) );
+        TM42_TEST_ASSERT( ctx, !AstCache::deserialize( bytes, changed, *interner ) );
+        for ( size_t size = 0; size < bytes.size(); ++size ) {
+            TM42_TEST_ASSERT( ctx, !AstCache::deserialize(
+                                       bytes.substr( 0, size ), src, *interner ) );
+        }
+        auto corrupt = bytes;
+        corrupt.back() = static_cast< char >( 0x7f );
+        TM42_TEST_ASSERT( ctx, !AstCache::deserialize( corrupt, src, *interner ) );
+    }
+    { // Through the file system.
+        char directory[] = "/tmp/myl_ast_cache_XXXXXX";
+        TM42_TEST_ASSERT( ctx, mkdtemp( directory ) );
+        const auto cache = AstCache( std::string( directory ) + "/entries" );
+        auto interner = std::make_shared< SymbolInterner >();
+        TM42_TEST_ASSERT( ctx, !cache.load( src, *interner ) );
+        const auto result = parse( src, interner, false );
+        TM42_TEST_ASSERT( ctx, cache.store( src, result, *interner ) );
+        const auto loaded = cache.load( src, *interner );
+        TM42_TEST_ASSERT( ctx, loaded );
+        TM42_TEST_ASSERT( ctx, toString( *loaded ) == toString( result ) );
+        TM42_TEST_ASSERT( ctx, !cache.load( src + " ", *interner ) );
+
+        unlink( cache.entryPath( AstCache::hashSource( src ) ).c_str() );
+        rmdir( ( std::string( directory ) + "/entries" ).c_str() );
+        rmdir( directory );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
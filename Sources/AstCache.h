@@ -0,0 +1,54 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "Intern.h"
+#include "Parser.h"
+
+// On-disk cache of parse results, so that sources which haven't changed since the
+// last run needn't be lexed or parsed again.
+//
+// Entries live in one directory, one file per source, named after a 64-bit hash of
+// the source's contents. An entry holds the hash and size of the source it came
+// from, the symbols its tree uses (as text), then every form as a preorder stream
+// of tagged nodes with varint-encoded integers. Loading `mmap`s the entry, interns
+// its symbols into the caller's interner, and rebuilds the tree with ids remapped
+// accordingly, so entries can be shared between runs and interners.
+//
+// Entries are in native byte order and are not meant to be portable: one written
+// on another architecture, truncated, or otherwise unreadable is just a miss.
+class AstCache {
+public:
+    explicit AstCache( std::string directory ) : m_directory( std::move( directory ) ) {}
+
+    static std::uint64_t hashSource( std::string_view source );
+    std::string entryPath( std::uint64_t hash ) const;
+
+    // `baseOffset` is the global offset of `source`, as for the parser: locations
+    // are stored relative to the source and rebased on load.
+    std::optional< Parser::Result > load( std::string_view source,
+                                          SymbolInterner & interner,
+                                          SourceOffset baseOffset = 0 ) const;
+    // Creates the directory if need be. The entry is written to a temporary file
+    // and renamed into place, so concurrent runs never see half an entry. Returns
+    // false after printing why, if it couldn't be written. `result` must be free of
+    // errors.
+    bool store( std::string_view source, const Parser::Result & result,
+                const SymbolInterner & interner, SourceOffset baseOffset = 0 ) const;
+
+    // The entry format, without the file handling.
+    static std::string serialize( std::string_view source, const Parser::Result & result,
+                                  const SymbolInterner & interner, SourceOffset baseOffset = 0 );
+    static std::optional< Parser::Result > deserialize( std::string_view bytes,
+                                                        std::string_view source,
+                                                        SymbolInterner & interner,
+                                                        SourceOffset baseOffset = 0 );
+
+private:
+    std::string m_directory;
+};
@@ -0,0 +1,297 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef MYL_TEST
+#include <unistd.h>
+#include <Test/Test.h>
+#endif
+#include <Tracing/Tracing.h>
+
+#include "AstCache.h"
+#include "Batch.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "SourceManager.h"
+
+extern TraceContext TC;
+
+std::optional< BatchOptions >
+parseBatchArgs( int argc, char ** argv, bool * usageError ) {
+    *usageError = false;
+    BatchOptions options;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( std::strcmp( argv[ i ], "--stats" ) == 0 ) {
+            options.stats = true;
+        } else if ( std::strcmp( argv[ i ], "--cache" ) == 0 ) {
+            if ( i + 1 == argc ) {
+                std::cerr << "error: --cache needs a directory\n";
+                *usageError = true;
+                return std::nullopt;
+            }
+            options.cacheDirectory = argv[ ++i ];
+        } else if ( argv[ i ][ 0 ] == '-' && argv[ i ][ 1 ] != '\0' ) {
+            std::cerr << "error: unknown option " << argv[ i ] << "\n";
+            *usageError = true;
+            return std::nullopt;
+        } else {
+            options.files.push_back( argv[ i ] );
+        }
+    }
+    if ( options.files.empty() ) {
+        if ( options.stats || !options.cacheDirectory.empty() ) {
+            std::cerr << "error: --stats and --cache need at least one file\n";
+            *usageError = true;
+        }
+        return std::nullopt;
+    }
+    return options;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct PhaseStats {
+    Clock::duration time{};
+    size_t bytes = 0;
+    size_t items = 0;
+};
+
+void
+printStats( std::ostream & os, const char * phase, const PhaseStats & stats,
+            const char * itemName ) {
+    const double ms =
+        std::chrono::duration< double, std::milli >( stats.time ).count();
+    char line[ 128 ];
+    std::snprintf( line, sizeof( line ), "%-8s %10.3f ms %12zu bytes %12zu %s\n",
+                   phase, ms, stats.bytes, stats.items, itemName );
+    os << line;
+}
+
+} // namespace
+
+int
+runBatch( const BatchOptions & options, std::ostream & out, std::ostream & statsOut ) {
+    // Flush to `out` in chunks this big, rather than once per form.
+    constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    std::optional< AstCache > cache;
+    if ( !options.cacheDirectory.empty() ) {
+        cache.emplace( options.cacheDirectory );
+    }
+    auto & interner = *SymbolInterner::global();
+    PhaseStats cacheStats;
+    PhaseStats lexStats;
+    PhaseStats parseStats;
+    size_t formCount = 0;
+    int failedFiles = 0;
+    std::ostringstream buffer;
+
+    const auto flush = [ & ]() {
+        const auto text = buffer.str();
+        out.write( text.data(), text.size() );
+        buffer.str( "" );
+    };
+
+    for ( const auto & path : options.files ) {
+        // One per file, so each file is unmapped once its output is buffered, rather
+        // than all of them staying mapped until the batch ends.
+        SourceManager sources;
+        const auto file = sources.addFile( path );
+        if ( file == SourceManager::INVALID_FILE ) {
+            failedFiles += 1;
+            continue;
+        }
+        t1( &TC, "Processing %s", path.c_str() );
+        const auto text = sources.text( file );
+        const SourceOffset baseOffset = sources.baseOffset( file );
+
+        std::optional< Parser::Result > ast;
+        bool parsed = false;
+        if ( cache ) {
+            const auto cacheBegin = Clock::now();
+            ast = cache->load( text, interner, baseOffset );
+            cacheStats.time += Clock::now() - cacheBegin;
+            if ( ast ) {
+                cacheStats.bytes += text.size();
+                cacheStats.items += 1;
+            }
+        }
+
+        if ( !ast ) {
+            const auto lexBegin = Clock::now();
+            auto lexer = Lexer( sources, file );
+            const auto lexResult = lexer.lex();
+            lexStats.time += Clock::now() - lexBegin;
+            lexStats.bytes += text.size();
+            lexStats.items += lexResult.tokens.size();
+            if ( lexResult.error ) {
+                failedFiles += 1;
+                continue;
+            }
+
+            const auto parseBegin = Clock::now();
+            auto parser = Parser( sources, file, lexResult.tokens );
+            ast = parser.parse();
+            parseStats.time += Clock::now() - parseBegin;
+            parseStats.bytes += text.size();
+            parsed = true;
+            if ( ast->error ) {
+                failedFiles += 1;
+                continue;
+            }
+            if ( cache ) {
+                // A failed store only costs the next run a reparse.
+                cache->store( text, *ast, interner, baseOffset );
+            }
+        }
+
+        for ( const auto & sexpr : ast->sexprs ) {
+            // Counting is not part of parsing, so it stays out of the timing.
+            if ( parsed ) {
+                parseStats.items += SExpr::countNodes( *sexpr );
+            }
+            buffer << *sexpr << "\n";
+            if ( buffer.tellp() >= static_cast< std::streamoff >( FLUSH_THRESHOLD ) ) {
+                flush();
+            }
+        }
+        formCount += ast->sexprs.size();
+    }
+    flush();
+    out.flush();
+
+    if ( options.stats ) {
+        statsOut << "files: " << options.files.size() << " (" << failedFiles
+                 << " failed), forms: " << formCount << "\n";
+        if ( cache ) {
+            printStats( statsOut, "cache", cacheStats, "hits" );
+        }
+        printStats( statsOut, "lex", lexStats, "tokens" );
+        printStats( statsOut, "parse", parseStats, "nodes" );
+        // There is no compile phase yet; once there is, report it here too.
+        printStats( statsOut, "total",
+                    { cacheStats.time + lexStats.time + parseStats.time,
+                      cacheStats.bytes + lexStats.bytes, formCount },
+                    "forms" );
+    }
+    return failedFiles ? 1 : 0;
+}
+
+#ifdef MYL_TEST
+void
+testBatch( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Batch mode" );
+
+    { // Arguments.
+        bool usageError;
+        const char * replArgs[] = { "myl" };
+        TM42_TEST_ASSERT( ctx, !parseBatchArgs( 1, const_cast< char ** >( replArgs ),
+                                                &usageError ) );
+        TM42_TEST_ASSERT( ctx, !usageError );
+
+        const char * fileArgs[] = { "myl", "--stats", "a.myl", "b.myl" };
+        const auto options =
+            parseBatchArgs( 4, const_cast< char ** >( fileArgs ), &usageError );
+        TM42_TEST_ASSERT( ctx, options && options->stats );
+        TM42_TEST_ASSERT( ctx, options && options->files.size() == 2 );
+
+        const char * cacheArgs[] = { "myl", "--cache", "dir", "a.myl" };
+        const auto cacheOptions =
+            parseBatchArgs( 4, const_cast< char ** >( cacheArgs ), &usageError );
+        TM42_TEST_ASSERT( ctx, cacheOptions && cacheOptions->cacheDirectory == "dir" );
+        TM42_TEST_ASSERT( ctx, cacheOptions && cacheOptions->files.size() == 1 );
+
+        const char * noDirArgs[] = { "myl", "a.myl", "--cache" };
+        TM42_TEST_ASSERT( ctx, !parseBatchArgs( 3, const_cast< char ** >( noDirArgs ),
+                                                &usageError ) );
+        TM42_TEST_ASSERT( ctx, usageError );
+
+        const char * badArgs[] = { "myl", "--nope", "a.myl" };
+        TM42_TEST_ASSERT( ctx, !parseBatchArgs( 3, const_cast< char ** >( badArgs ),
+                                                &usageError ) );
+        TM42_TEST_ASSERT( ctx, usageError );
+    }
+    { // Files are processed in order, errors don't stop the batch.
+        char goodPath[] = "/tmp/myl_batch_good_XXXXXX";
+        char badPath[] = "/tmp/myl_batch_bad_XXXXXX";
+        const int goodFd = mkstemp( goodPath );
+        const int badFd = mkstemp( badPath );
+        const std::string good = "(a 1)\nfoo\n";
+        const std::string bad = "(b";
+        TM42_TEST_ASSERT( ctx, write( goodFd, good.data(), good.size() ) ==
+                                   static_cast< ssize_t >( good.size() ) );
+        TM42_TEST_ASSERT( ctx, write( badFd, bad.data(), bad.size() ) ==
+                                   static_cast< ssize_t >( bad.size() ) );
+        close( goodFd );
+        close( badFd );
+
+        BatchOptions options;
+        options.stats = true;
+        options.files = { goodPath, badPath, goodPath };
+        std::ostringstream out;
+        std::ostringstream stats;
+        std::ostringstream errors;
+        auto * const oldCerr = std::cerr.rdbuf( errors.rdbuf() );
+        const int status = runBatch( options, out, stats );
+        std::cerr.rdbuf( oldCerr );
+
+        TM42_TEST_ASSERT( ctx, status == 1 );
+        std::ostringstream expected;
+        auto lexer = Lexer( good );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( good, lexResult.tokens );
+        const auto ast = parser.parse();
+        for ( int i = 0; i < 2; ++i ) {
+            for ( const auto & sexpr : ast.sexprs ) {
+                expected << *sexpr << "\n";
+            }
+        }
+        TM42_TEST_ASSERT( ctx, out.str() == expected.str() );
+        TM42_TEST_ASSERT( ctx, errors.str().find( badPath ) != std::string::npos );
+        TM42_TEST_ASSERT( ctx, stats.str().find( "(1 failed), forms: 4" ) !=
+                                   std::string::npos );
+        TM42_TEST_ASSERT( ctx, stats.str().find( "lex" ) != std::string::npos );
+
+        unlink( goodPath );
+        unlink( badPath );
+    }
+    { // With a cache, the second run lexes and parses nothing, to the same output.
+        char path[] = "/tmp/myl_batch_cached_XXXXXX";
+        char cacheDirectory[] = "/tmp/myl_batch_cache_XXXXXX";
+        const int fd = mkstemp( path );
+        TM42_TEST_ASSERT( ctx, mkdtemp( cacheDirectory ) );
+        const std::string text = "(a @b 1.5 (c -2))\nfoo\n";
+        TM42_TEST_ASSERT( ctx, write( fd, text.data(), text.size() ) ==
+                                   static_cast< ssize_t >( text.size() ) );
+        close( fd );
+
+        BatchOptions options;
+        options.stats = true;
+        options.cacheDirectory = cacheDirectory;
+        options.files = { path };
+        std::ostringstream firstOut;
+        std::ostringstream firstStats;
+        TM42_TEST_ASSERT( ctx, runBatch( options, firstOut, firstStats ) == 0 );
+        std::ostringstream secondOut;
+        std::ostringstream secondStats;
+        TM42_TEST_ASSERT( ctx, runBatch( options, secondOut, secondStats ) == 0 );
+
+        TM42_TEST_ASSERT( ctx, !firstOut.str().empty() );
+        TM42_TEST_ASSERT( ctx, secondOut.str() == firstOut.str() );
+        TM42_TEST_ASSERT( ctx, firstStats.str().find( " 0 hits" ) != std::string::npos );
+        TM42_TEST_ASSERT( ctx, secondStats.str().find( " 1 hits" ) != std::string::npos );
+        TM42_TEST_ASSERT( ctx, secondStats.str().find( " 0 tokens" ) != std::string::npos );
+
+        unlink( AstCache( cacheDirectory ).entryPath( AstCache::hashSource( text ) ).c_str() );
+        rmdir( cacheDirectory );
+        unlink( path );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
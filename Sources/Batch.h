@@ -0,0 +1,29 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Non-interactive mode: `myl [--stats] [--cache DIR] file...`.
+struct BatchOptions {
+    bool stats = false;
+    // If set, parse results are cached here (see `AstCache`), and files that
+    // haven't changed since they were cached are not lexed or parsed again.
+    std::string cacheDirectory;
+    std::vector< std::string > files;
+};
+
+// Returns nothing if there are no file arguments (i.e. run the REPL), or if they
+// are malformed, in which case `usageError` is set.
+std::optional< BatchOptions > parseBatchArgs( int argc, char ** argv,
+                                              bool * usageError );
+
+// Lex and parse each file, writing its forms to `out` in large chunks. With
+// `options.stats`, a per-phase summary (time, bytes, items) goes to `statsOut`;
+// time spent on cache lookups, hits or not, is its own phase.
+// Files with errors are reported and skipped. Returns the process exit code.
+int runBatch( const BatchOptions & options, std::ostream & out,
+              std::ostream & statsOut );
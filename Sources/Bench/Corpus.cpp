@@ -0,0 +1,205 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include "Corpus.h"
+
+namespace Corpus {
+
+namespace {
+
+class Random {
+public:
+    explicit Random( std::uint64_t seed ) : m_state( seed ) {}
+
+    std::uint64_t
+    next() {
+        this->m_state = this->m_state * 6364136223846793005ull + 1442695040888963407ull;
+        return this->m_state >> 33;
+    }
+
+    // In [ lo, hi ].
+    int
+    between( int lo, int hi ) {
+        return lo + static_cast< int >( this->next() % ( hi - lo + 1 ) );
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+void
+appendIdentifier( std::string & out, Random & random, int length ) {
+    out.push_back( char( 'a' + random.next() % 26 ) );
+    for ( int i = 1; i < length; ++i ) {
+        const auto r = random.next() % 36;
+        out.push_back( r < 26 ? char( 'a' + r ) : char( '0' + r - 26 ) );
+    }
+}
+
+void
+appendNumber( std::string & out, Random & random ) {
+    if ( random.next() % 4 == 0 ) {
+        out.push_back( '-' );
+    }
+    out += std::to_string( random.next() % 100000 );
+    if ( random.next() % 2 ) {
+        out.push_back( '.' );
+        out += std::to_string( random.next() % 1000 );
+    }
+}
+
+void
+appendAtom( std::string & out, Random & random ) {
+    if ( random.next() % 2 ) {
+        appendIdentifier( out, random, random.between( 1, 12 ) );
+    } else {
+        appendNumber( out, random );
+    }
+}
+
+} // namespace
+
+std::string
+deepNesting( size_t targetBytes, std::uint64_t seed ) {
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    while ( out.size() < targetBytes ) {
+        const int depth = random.between( 200, 800 );
+        for ( int d = 0; d < depth; ++d ) {
+            out.push_back( '(' );
+            appendAtom( out, random );
+            out.push_back( ' ' );
+        }
+        appendAtom( out, random );
+        out.append( depth, ')' );
+        out.push_back( '\n' );
+    }
+    return out;
+}
+
+std::string
+wideLists( size_t targetBytes, std::uint64_t seed ) {
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    while ( out.size() < targetBytes ) {
+        const int width = random.between( 5000, 20000 );
+        out.push_back( '(' );
+        for ( int i = 0; i < width && out.size() < targetBytes; ++i ) {
+            appendAtom( out, random );
+            out.push_back( ( i % 20 == 19 ) ? '\n' : ' ' );
+        }
+        out += ")\n";
+    }
+    return out;
+}
+
+std::string
+longIdentifiers( size_t targetBytes, std::uint64_t seed ) {
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    int form = 0;
+    while ( out.size() < targetBytes ) {
+        out.push_back( '(' );
+        // Exercise the out-of-line length path of `TokenBuffer` now and then.
+        const bool huge = ( form++ % 64 == 63 );
+        appendIdentifier( out, random, huge ? 70000 : random.between( 64, 512 ) );
+        for ( int i = 0; i < 4; ++i ) {
+            out.push_back( ' ' );
+            appendIdentifier( out, random, random.between( 64, 512 ) );
+        }
+        out += ")\n";
+    }
+    return out;
+}
+
+std::string
+numbers( size_t targetBytes, std::uint64_t seed ) {
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    while ( out.size() < targetBytes ) {
+        out.push_back( '(' );
+        for ( int i = 0; i < 16; ++i ) {
+            if ( i ) {
+                out.push_back( ' ' );
+            }
+            appendNumber( out, random );
+        }
+        out += ")\n";
+    }
+    return out;
+}
+
+std::string
+labeledProcs( size_t targetBytes, std::uint64_t seed ) {
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    while ( out.size() < targetBytes ) {
+        out.push_back( '(' );
+        appendIdentifier( out, random, random.between( 3, 10 ) );
+        const int parameterCount = random.between( 1, 12 );
+        for ( int i = 0; i < parameterCount; ++i ) {
+            out.push_back( ' ' );
+            if ( random.next() % 4 != 0 ) {
+                out.push_back( '@' );
+                appendIdentifier( out, random, random.between( 1, 8 ) );
+                out.push_back( ' ' );
+            }
+            appendAtom( out, random );
+        }
+        out += ")\n";
+    }
+    return out;
+}
+
+std::string
+nonAscii( size_t targetBytes, std::uint64_t seed ) {
+    static const char * const WORDS[] = {
+        "caf\xC3\xA9",         "na\xC3\xAFve",     "\xC3\xBC" "ber",
+        "\xCE\xBB",            "\xCE\xB1\xCE\xB2\xCE\xB3", "\xCF\x80r",
+        "\xE6\xBC\xA2\xE5\xAD\x97", "\xE5\xA4\x89\xE6\x95\xB0", "x\xE2\x82\x81",
+    };
+    constexpr int WORD_COUNT = sizeof( WORDS ) / sizeof( WORDS[ 0 ] );
+
+    Random random( seed );
+    std::string out;
+    out.reserve( targetBytes + 4096 );
+    while ( out.size() < targetBytes ) {
+        out.push_back( '(' );
+        const int count = random.between( 2, 10 );
+        for ( int i = 0; i < count; ++i ) {
+            if ( i ) {
+                out.push_back( ' ' );
+            }
+            out += WORDS[ random.next() % WORD_COUNT ];
+            if ( random.next() % 2 ) {
+                out += WORDS[ random.next() % WORD_COUNT ];
+            }
+        }
+        out += ")\n";
+    }
+    return out;
+}
+
+const std::vector< Shape > &
+allShapes() {
+    static const std::vector< Shape > SHAPES = {
+        { "deep_nesting", deepNesting },
+        { "wide_lists", wideLists },
+        { "long_identifiers", longIdentifiers },
+        { "numbers", numbers },
+        { "labeled_procs", labeledProcs },
+        { "non_ascii", nonAscii },
+    };
+    return SHAPES;
+}
+
+std::string
+nested( size_t depth ) {
+    return std::string( depth, '(' ) + "x" + std::string( depth, ')' );
+}
+
+} // namespace Corpus
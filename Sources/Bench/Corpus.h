@@ -0,0 +1,36 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic synthetic Myl sources, each stressing one part of the front end.
+// The same seed and size always give the same text, so runs are comparable.
+namespace Corpus {
+
+struct Shape {
+    const char * name;
+    std::string ( *generate )( size_t targetBytes, std::uint64_t seed );
+};
+
+// Forms nested hundreds of levels deep.
+std::string deepNesting( size_t targetBytes, std::uint64_t seed );
+// Lists with thousands of elements.
+std::string wideLists( size_t targetBytes, std::uint64_t seed );
+// Identifiers hundreds of bytes long, a few over 64KiB.
+std::string longIdentifiers( size_t targetBytes, std::uint64_t seed );
+// Integers and floats, positive and negative.
+std::string numbers( size_t targetBytes, std::uint64_t seed );
+// Procedure calls with mostly labeled parameters.
+std::string labeledProcs( size_t targetBytes, std::uint64_t seed );
+// Identifiers in Latin, Greek and CJK scripts.
+std::string nonAscii( size_t targetBytes, std::uint64_t seed );
+
+const std::vector< Shape > & allShapes();
+
+// A single atom inside `depth` nested lists.
+std::string nested( size_t depth );
+
+} // namespace Corpus
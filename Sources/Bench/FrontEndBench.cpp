@@ -0,0 +1,256 @@
+// Copyright (C) 2025 by Varun Malladi
+//
+// Measures Lexer::lex and Parser::parse, the latter also in proc mode and as
+// events (Parser::parseEvents), on each synthetic corpus shape, and prints the
+// results as JSON. For each phase: best wall time over the repetitions, MB/s,
+// tokens/s or nodes/s, and heap allocations per run.
+//
+// Then, parse and teardown time for a single form nested deeper and deeper, up to
+// CORPUS_BYTES / 2 levels: both should grow linearly with depth.
+//
+// usage: myl_bench [CORPUS_BYTES] [REPETITIONS] [SHAPE...]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <Tracing/Tracing.h>
+
+#include "Corpus.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+struct TraceContext TC;
+
+// --- Allocation counting ------------------------------------------------------------
+
+static std::atomic< size_t > ALLOCATION_COUNT( 0 );
+static std::atomic< size_t > ALLOCATED_BYTES( 0 );
+
+void *
+operator new( size_t size ) {
+    ALLOCATION_COUNT.fetch_add( 1, std::memory_order_relaxed );
+    ALLOCATED_BYTES.fetch_add( size, std::memory_order_relaxed );
+    if ( void * p = std::malloc( size ? size : 1 ) ) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *
+operator new[]( size_t size ) {
+    return operator new( size );
+}
+
+void
+operator delete( void * p ) noexcept {
+    std::free( p );
+}
+
+void
+operator delete[]( void * p ) noexcept {
+    std::free( p );
+}
+
+void
+operator delete( void * p, size_t ) noexcept {
+    std::free( p );
+}
+
+void
+operator delete[]( void * p, size_t ) noexcept {
+    std::free( p );
+}
+
+// --- Measurement --------------------------------------------------------------------
+
+namespace {
+
+struct PhaseResult {
+    double seconds = 0;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+};
+
+// Run `work` `repetitions` times, keeping the fastest run. `prepare` runs, untimed,
+// before each one. Allocation counts are the same every run, so they come from the
+// last one.
+template < typename Prepare, typename Work >
+PhaseResult
+measure( int repetitions, Prepare prepare, Work work ) {
+    PhaseResult result;
+    result.seconds = 1e300;
+    for ( int r = 0; r < repetitions; ++r ) {
+        prepare();
+        const size_t allocationsBefore = ALLOCATION_COUNT.load( std::memory_order_relaxed );
+        const size_t bytesBefore = ALLOCATED_BYTES.load( std::memory_order_relaxed );
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        const auto end = std::chrono::steady_clock::now();
+        result.allocations = ALLOCATION_COUNT.load( std::memory_order_relaxed ) -
+            allocationsBefore;
+        result.allocatedBytes = ALLOCATED_BYTES.load( std::memory_order_relaxed ) -
+            bytesBefore;
+        result.seconds = std::min(
+            result.seconds, std::chrono::duration< double >( end - start ).count() );
+    }
+    return result;
+}
+
+void
+printPhase( const char * name, const PhaseResult & phase, size_t bytes,
+            const char * itemName, size_t items, bool last ) {
+    std::printf( "      \"%s\": { \"seconds\": %.6f, \"mb_per_s\": %.2f, "
+                 "\"%s_per_s\": %.0f, \"allocations\": %zu, "
+                 "\"allocated_bytes\": %zu }%s\n",
+                 name, phase.seconds, bytes / phase.seconds / 1e6, itemName,
+                 items / phase.seconds, phase.allocations, phase.allocatedBytes,
+                 last ? "" : "," );
+}
+
+} // namespace
+
+int
+main( int argc, char ** argv ) {
+    init_tracing( &TC, stderr, "FrontEndBench" );
+
+    const size_t corpusBytes = argc > 1 ? std::atol( argv[ 1 ] ) : ( 8 << 20 );
+    const int repetitions = argc > 2 ? std::max( 1, std::atoi( argv[ 2 ] ) ) : 5;
+    std::vector< Corpus::Shape > shapes;
+    for ( const auto & shape : Corpus::allShapes() ) {
+        bool selected = argc <= 3;
+        for ( int i = 3; i < argc; ++i ) {
+            selected = selected || std::strcmp( argv[ i ], shape.name ) == 0;
+        }
+        if ( selected ) {
+            shapes.push_back( shape );
+        }
+    }
+
+    std::printf( "{\n  \"corpus_bytes\": %zu,\n  \"repetitions\": %d,\n"
+                 "  \"shapes\": [\n",
+                 corpusBytes, repetitions );
+    for ( size_t s = 0; s < shapes.size(); ++s ) {
+        const auto & shape = shapes[ s ];
+        const std::string source = shape.generate( corpusBytes, 42 );
+
+        // A fresh interner each run, so every run does the same interning work.
+        Lexer::Result lexResult{ {}, false };
+        std::shared_ptr< SymbolInterner > interner;
+        const auto lex = measure(
+            repetitions,
+            [ & ]() {
+                lexResult = { {}, false };
+                interner = std::make_shared< SymbolInterner >();
+            },
+            [ & ]() {
+                auto lexer = Lexer( source, interner );
+                lexResult = lexer.lex();
+            } );
+        if ( lexResult.error ) {
+            std::fprintf( stderr, "error: %s failed to lex\n", shape.name );
+            return 1;
+        }
+
+        // Tearing the previous tree down is not part of parsing.
+        Parser::Result parseResult{ {}, false, {} };
+        size_t nodeCount = 0;
+        const auto parse = measure(
+            repetitions, [ & ]() { parseResult = { {}, false, {} }; },
+            [ & ]() {
+                auto parser = Parser( source, lexResult.tokens );
+                parseResult = parser.parse();
+            } );
+        if ( parseResult.error ) {
+            std::fprintf( stderr, "error: %s failed to parse\n", shape.name );
+            return 1;
+        }
+        for ( const auto & sexpr : parseResult.sexprs ) {
+            nodeCount += SExpr::countNodes( *sexpr );
+        }
+
+        size_t procNodeCount = 0;
+        const auto parseProcs = measure(
+            repetitions, [ & ]() { parseResult = { {}, false, {} }; },
+            [ & ]() {
+                auto parser = Parser( source, lexResult.tokens );
+                parser.setProcMode( true );
+                parseResult = parser.parse();
+            } );
+        if ( parseResult.error ) {
+            std::fprintf( stderr, "error: %s failed to parse as procs\n", shape.name );
+            return 1;
+        }
+        for ( const auto & sexpr : parseResult.sexprs ) {
+            procNodeCount += SExpr::countNodes( *sexpr );
+        }
+
+        // Counts events, so that they can't be optimized away.
+        struct EventCounter : ParseEventHandler {
+            size_t events = 0;
+            void onListBegin( SourceCodeLocation ) { events += 1; }
+            void onListEnd( SourceCodeLocation ) { events += 1; }
+            void onInt32( I32, SourceCodeLocation ) { events += 1; }
+            void onFloat64( F64, SourceCodeLocation ) { events += 1; }
+            void onSymbol( InternedSymbol, SourceCodeLocation ) { events += 1; }
+            void onLabel( InternedSymbol, SourceCodeLocation ) { events += 1; }
+        } eventCounter;
+        const auto events = measure(
+            repetitions, [ & ]() { eventCounter.events = 0; },
+            [ & ]() {
+                auto parser = Parser( source, lexResult.tokens );
+                parser.parseEvents( eventCounter );
+            } );
+
+        std::printf( "    {\n      \"name\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, "
+                     "\"nodes\": %zu,\n",
+                     shape.name, source.size(), lexResult.tokens.size(), nodeCount );
+        printPhase( "lex", lex, source.size(), "tokens", lexResult.tokens.size(),
+                    false );
+        printPhase( "parse", parse, source.size(), "nodes", nodeCount, false );
+        printPhase( "parse_procs", parseProcs, source.size(), "nodes", procNodeCount,
+                    false );
+        printPhase( "parse_events", events, source.size(), "events",
+                    eventCounter.events, true );
+        std::printf( "    }%s\n", s + 1 < shapes.size() ? "," : "" );
+    }
+    std::printf( "  ],\n  \"depth_scaling\": [\n" );
+    for ( size_t depth = 1 << 12; depth <= corpusBytes / 2; depth *= 4 ) {
+        const std::string source = Corpus::nested( depth );
+        auto lexer = Lexer( source );
+        const auto lexResult = lexer.lex();
+
+        Parser::Result parseResult{ {}, false, {} };
+        const auto parse = measure(
+            repetitions, [ & ]() { parseResult = { {}, false, {} }; },
+            [ & ]() {
+                auto parser = Parser( source, lexResult.tokens );
+                parseResult = parser.parse();
+            } );
+        const auto teardown = measure(
+            repetitions,
+            [ & ]() {
+                auto parser = Parser( source, lexResult.tokens );
+                parseResult = parser.parse();
+            },
+            [ & ]() { parseResult = { {}, false, {} }; } );
+
+        std::printf( "    { \"depth\": %zu, \"parse_seconds\": %.6f, "
+                     "\"parse_ns_per_level\": %.2f, \"teardown_seconds\": %.6f, "
+                     "\"teardown_ns_per_level\": %.2f }%s\n",
+                     depth, parse.seconds, parse.seconds * 1e9 / depth,
+                     teardown.seconds, teardown.seconds * 1e9 / depth,
+                     depth * 4 <= corpusBytes / 2 ? "," : "" );
+    }
+    std::printf( "  ]\n}\n" );
+
+    deinit_tracing( &TC );
+    return 0;
+}
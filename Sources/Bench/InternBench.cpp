@@ -0,0 +1,152 @@
+// Copyright (C) 2025 by Varun Malladi
+//
+// Measures how interning scales with the number of threads sharing one
+// SymbolInterner, on identifier-heavy input.
+//
+// usage: myl_intern_bench [MAX_THREADS] [IDENTIFIER_COUNT]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <Tracing/Tracing.h>
+
+#include "Intern.h"
+#include "Lexer.h"
+
+struct TraceContext TC;
+
+// Work is split into this many slices, handed out to threads dynamically.
+static constexpr int SLICE_COUNT = 64;
+static constexpr int VOCABULARY_SIZE = 200000;
+
+// Deterministic, so runs are comparable.
+static std::uint64_t
+nextRandom( std::uint64_t & state ) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return state >> 33;
+}
+
+static std::vector< std::string >
+makeVocabulary( std::uint64_t & rng ) {
+    std::vector< std::string > vocabulary;
+    vocabulary.reserve( VOCABULARY_SIZE );
+    for ( int i = 0; i < VOCABULARY_SIZE; ++i ) {
+        std::string name( 1, char( 'a' + nextRandom( rng ) % 26 ) );
+        const int length = 4 + nextRandom( rng ) % 20;
+        for ( int j = 1; j < length; ++j ) {
+            const auto r = nextRandom( rng ) % 36;
+            name.push_back( r < 26 ? char( 'a' + r ) : char( '0' + r - 26 ) );
+        }
+        vocabulary.push_back( std::move( name ) );
+    }
+    return vocabulary;
+}
+
+// Each slice references a skewed mix of identifiers: most references go to a small
+// hot set, as in real code.
+static std::vector< std::string >
+makeSlices( const std::vector< std::string > & vocabulary, long identifierCount,
+            std::uint64_t & rng ) {
+    std::vector< std::string > slices( SLICE_COUNT );
+    const long perSlice = identifierCount / SLICE_COUNT;
+    const int hotCount = VOCABULARY_SIZE / 100;
+    for ( auto & slice : slices ) {
+        for ( long i = 0; i < perSlice; ++i ) {
+            const bool hot = nextRandom( rng ) % 10 < 8;
+            const auto idx = nextRandom( rng ) % ( hot ? hotCount : VOCABULARY_SIZE );
+            slice += vocabulary[ idx ];
+            slice.push_back( ( i % 16 == 15 ) ? '\n' : ' ' );
+        }
+    }
+    return slices;
+}
+
+template < typename Work >
+static double
+runThreads( int threadCount, Work work ) {
+    std::atomic< int > nextSlice( 0 );
+    const auto start = std::chrono::steady_clock::now();
+    std::vector< std::thread > threads;
+    for ( int t = 0; t < threadCount; ++t ) {
+        threads.emplace_back( [ & ]() {
+            for ( int slice = nextSlice++; slice < SLICE_COUNT; slice = nextSlice++ ) {
+                work( slice );
+            }
+        } );
+    }
+    for ( auto & thread : threads ) {
+        thread.join();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration< double >( end - start ).count();
+}
+
+int
+main( int argc, char ** argv ) {
+    init_tracing( &TC, stdout, "InternBench" );
+
+    const int maxThreads = argc > 1 ? std::atoi( argv[ 1 ] ) : 32;
+    const long identifierCount = argc > 2 ? std::atol( argv[ 2 ] ) : 4000000;
+
+    std::uint64_t rng = 42;
+    const auto vocabulary = makeVocabulary( rng );
+    const auto slices = makeSlices( vocabulary, identifierCount, rng );
+
+    // Pre-split views, so the intern-only numbers don't include lexing.
+    std::vector< std::vector< std::string_view > > words( SLICE_COUNT );
+    long totalWords = 0;
+    for ( int i = 0; i < SLICE_COUNT; ++i ) {
+        const std::string_view slice = slices[ i ];
+        size_t begin = 0;
+        while ( begin < slice.size() ) {
+            const size_t end = slice.find_first_of( " \n", begin );
+            words[ i ].push_back( slice.substr( begin, end - begin ) );
+            begin = end + 1;
+        }
+        totalWords += words[ i ].size();
+    }
+
+    std::printf( "%ld identifiers, %d distinct, hardware threads: %u\n", totalWords,
+                 VOCABULARY_SIZE, std::thread::hardware_concurrency() );
+    std::printf( "%8s %14s %9s %14s %9s\n", "threads", "intern M/s", "speedup",
+                 "lex M/s", "speedup" );
+
+    double internBase = 0;
+    double lexBase = 0;
+    for ( int threadCount = 1; threadCount <= maxThreads; threadCount *= 2 ) {
+        SymbolInterner internInterner;
+        const double internSeconds = runThreads( threadCount, [ & ]( int slice ) {
+            for ( const auto word : words[ slice ] ) {
+                internInterner.intern( word );
+            }
+        } );
+
+        const auto lexInterner = std::make_shared< SymbolInterner >();
+        const double lexSeconds = runThreads( threadCount, [ & ]( int slice ) {
+            auto lexer = Lexer( slices[ slice ], lexInterner );
+            const auto result = lexer.lex();
+            if ( result.error ) {
+                std::abort();
+            }
+        } );
+
+        const double internRate = totalWords / internSeconds / 1e6;
+        const double lexRate = totalWords / lexSeconds / 1e6;
+        if ( threadCount == 1 ) {
+            internBase = internRate;
+            lexBase = lexRate;
+        }
+        std::printf( "%8d %14.2f %8.2fx %14.2f %8.2fx\n", threadCount, internRate,
+                     internRate / internBase, lexRate, lexRate / lexBase );
+    }
+
+    deinit_tracing( &TC );
+    return 0;
+}
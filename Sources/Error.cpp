@@ -1,56 +1,143 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
+
+#ifdef MYL_TEST
+#include <cstring>
+#include <Test/Test.h>
+
+#include "Lexer.h"
+#endif
 
 #include "Error.h"
+#include "LineIndex.h"
+
+namespace {
+
+// Spans too long for a location's length field. Append-only, so indices handed out
+// stay valid; `indices` finds an existing entry for the same span.
+struct LongSpans {
+    std::mutex mutex;
+    std::deque< std::pair< SourceOffset, SourceOffset > > spans;
+    std::map< std::pair< SourceOffset, SourceOffset >, std::uint64_t > indices;
+};
+
+LongSpans &
+longSpans() {
+    static LongSpans table;
+    return table;
+}
+
+} // namespace
+
+SourceCodeLocation::SourceCodeLocation( SourceOffset byteOffset,
+                                        SourceOffset byteLength ) {
+    assert( byteOffset >= 0 && byteOffset <= MAX_OFFSET && byteLength >= 0 );
+    if ( static_cast< std::uint64_t >( byteLength ) < LONG_LENGTH ) {
+        this->m_bits = static_cast< std::uint64_t >( byteOffset ) |
+                       static_cast< std::uint64_t >( byteLength ) << OFFSET_BITS;
+        return;
+    }
+    auto & table = longSpans();
+    std::lock_guard< std::mutex > lock( table.mutex );
+    const auto [ it, inserted ] =
+        table.indices.try_emplace( { byteOffset, byteLength }, table.spans.size() );
+    if ( inserted ) {
+        table.spans.emplace_back( byteOffset, byteLength );
+    }
+    assert( it->second <= OFFSET_MASK );
+    this->m_bits = it->second | LONG_LENGTH << OFFSET_BITS;
+}
+
+std::pair< SourceOffset, SourceOffset >
+SourceCodeLocation::longSpan( std::uint64_t idx ) {
+    auto & table = longSpans();
+    std::lock_guard< std::mutex > lock( table.mutex );
+    return table.spans[ idx ];
+}
 
 std::ostream &
 operator<<( std::ostream & os, const SourceCodeLocation & loc ) {
-    return os << "{ byteOffset: " << loc.byteOffset
-              << ", byteLength: " << loc.byteLength << " }";
+    return os << "{ byteOffset: " << loc.byteOffset()
+              << ", byteLength: " << loc.byteLength() << " }";
 }
 
 bool
-SourceCodeLocation::isValid( const std::string & src ) {
-    return ( ( this->byteOffset >= 0 ) &&
-             ( this->byteOffset + this->byteLength < src.size() ) );
+SourceCodeLocation::isValid( std::string_view src ) const {
+    return static_cast< std::uint64_t >( this->byteOffset() + this->byteLength() ) <=
+           src.size();
 }
 
 void
-emitSourceError( const std::string & src, SourceCodeLocation loc,
+emitSourceError( std::string_view src, SourceCodeLocation loc,
                  const std::string & msg ) {
+    emitSourceError( src, LineIndex( src ), loc, msg );
+}
+
+void
+emitSourceError( std::string_view src, const LineIndex & lineIndex,
+                 SourceCodeLocation loc, const std::string & msg,
+                 std::string_view fileName ) {
     if ( !loc.isValid( src ) ) {
         std::cout << "invalid loc: " << loc
                   << " src size: " << src.size() << "\n";
         assert( false );
     }
 
-    // Count line number
-    int lineNumber = 1;
-    size_t lineStart = 0;
-    for ( size_t i = 0; i < (size_t)loc.byteOffset; ++i ) {
-        if ( src[ i ] == '\n' ) {
-            ++lineNumber;
-            lineStart = i + 1;
-        }
-    }
-
-    // Find end of the line.
-    size_t lineEnd = src.find( '\n', loc.byteOffset );
-    if ( lineEnd == std::string::npos ) {
-        lineEnd = src.size();
-    }
-
-    std::string line = src.substr( lineStart, lineEnd - lineStart );
+    const auto position = lineIndex.position( loc.byteOffset() );
+    const auto line = lineIndex.lineText( position.line );
+    const size_t lineStart = loc.byteOffset() - position.byteColumn;
 
-    // Compute column (number of characters from lineStart to byteOffset)
-    int column = loc.byteOffset - lineStart;
+    // Underline up to the end of the region or the line, whichever comes first, in
+    // display columns so carets line up under multi-byte characters and tabs.
+    const size_t caretEnd = std::min< size_t >( loc.byteOffset() + loc.byteLength(),
+                                                lineStart + line.size() );
+    const int caretWidth = std::max(
+        1, lineIndex.advanceColumn( loc.byteOffset(), caretEnd, position.column ) -
+               position.column );
 
-    std::cerr << "error <FILE>:" << lineNumber << ":" << column
+    std::cerr << "error " << fileName << ":" << position.line << ":" << position.column
               << ": " << msg << "\n";
     std::cerr << line << "\n";
-    std::cerr << std::string( column, ' ' )
-              << std::string( loc.byteLength > 0 ? loc.byteLength : 1, '^' )
+    std::cerr << std::string( position.column, ' ' )
+              << std::string( caretWidth, '^' )
               << "\n";
 }
+
+#ifdef MYL_TEST
+void
+testSourceCodeLocation( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Source code location" );
+
+    { // One word, and so are tokens no bigger for it.
+        TM42_TEST_ASSERT( ctx, sizeof( SourceCodeLocation ) == 8 );
+        TM42_TEST_ASSERT( ctx, sizeof( Token ) == 32 );
+    }
+    { // Round trip, either side of the longest length held inline.
+        const SourceOffset lengths[] = { 0, 1, ( 1 << 24 ) - 2, ( 1 << 24 ) - 1,
+                                         1 << 24, SourceOffset( 3 ) << 30 };
+        for ( const SourceOffset length : lengths ) {
+            const SourceOffset offset = SourceCodeLocation::MAX_OFFSET - length;
+            const SourceCodeLocation loc( offset, length );
+            TM42_TEST_ASSERT( ctx, loc.byteOffset() == offset );
+            TM42_TEST_ASSERT( ctx, loc.byteLength() == length );
+        }
+    }
+    { // Long spans are stored once, and can be moved.
+        const SourceCodeLocation a( 10, SourceOffset( 1 ) << 32 );
+        const SourceCodeLocation b( 10, SourceOffset( 1 ) << 32 );
+        TM42_TEST_ASSERT( ctx, std::memcmp( &a, &b, sizeof( a ) ) == 0 );
+        const auto moved = a.shifted( -4 );
+        TM42_TEST_ASSERT( ctx, moved.byteOffset() == 6 );
+        TM42_TEST_ASSERT( ctx, moved.byteLength() == SourceOffset( 1 ) << 32 );
+        TM42_TEST_ASSERT( ctx, a.byteOffset() == 10 );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
@@ -2,18 +2,70 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <utility>
 
-struct SourceCodeLocation {
-    // Region is str[ byteOffset:byteOffset+byteLength ].
-    int byteOffset;
-    int byteLength;
+class LineIndex;
+
+// A byte offset into a source, or into `SourceManager`'s global offset space. Wide
+// and signed, so sums and differences of offsets can't wrap; a location holds up
+// to `SourceCodeLocation::MAX_OFFSET` (1TiB).
+using SourceOffset = std::int64_t;
+
+// Region is str[ byteOffset():byteOffset()+byteLength() ].
+//
+// Packed into one 64-bit word: a 40-bit offset (so locations reach 1TiB) under a
+// 24-bit length. Lengths that don't fit, which only spans of whole forms reach, go
+// in a process-wide side table of ( offset, length ) pairs, and the word holds the
+// span's index there instead. Each distinct long span is stored once.
+class SourceCodeLocation {
+public:
+    static constexpr int OFFSET_BITS = 40;
+    static constexpr SourceOffset MAX_OFFSET = ( SourceOffset( 1 ) << OFFSET_BITS ) - 1;
+
+    SourceCodeLocation() = default;
+    SourceCodeLocation( SourceOffset byteOffset, SourceOffset byteLength );
+
+    SourceOffset
+    byteOffset() const {
+        return this->isLong() ? longSpan( this->m_bits & OFFSET_MASK ).first
+                              : SourceOffset( this->m_bits & OFFSET_MASK );
+    }
+    SourceOffset
+    byteLength() const {
+        return this->isLong() ? longSpan( this->m_bits & OFFSET_MASK ).second
+                              : SourceOffset( this->m_bits >> OFFSET_BITS );
+    }
+    // The same region, moved by `delta` bytes.
+    SourceCodeLocation
+    shifted( SourceOffset delta ) const {
+        return { this->byteOffset() + delta, this->byteLength() };
+    }
 
     // Check if this references a valid location in the provided string.
-    bool isValid( const std::string & src );
+    bool isValid( std::string_view src ) const;
+
+private:
+    static constexpr std::uint64_t OFFSET_MASK =
+        ( std::uint64_t( 1 ) << OFFSET_BITS ) - 1;
+    // A length field of all ones marks a span in the side table.
+    static constexpr std::uint64_t LONG_LENGTH = ( std::uint64_t( 1 ) << 24 ) - 1;
+
+    static std::pair< SourceOffset, SourceOffset > longSpan( std::uint64_t idx );
+
+    bool isLong() const { return ( this->m_bits >> OFFSET_BITS ) == LONG_LENGTH; }
+
+    std::uint64_t m_bits = 0;
 };
 
 std::ostream & operator<<( std::ostream & os, const SourceCodeLocation & loc );
 
-void emitSourceError( const std::string & src, SourceCodeLocation loc,
+void emitSourceError( std::string_view src, SourceCodeLocation loc,
                       const std::string & msg );
+// Same, but resolves the line and column through a prebuilt index of `src` instead
+// of scanning it. Use this when reporting more than one error per source.
+void emitSourceError( std::string_view src, const LineIndex & lineIndex,
+                      SourceCodeLocation loc, const std::string & msg,
+                      std::string_view fileName = "<FILE>" );
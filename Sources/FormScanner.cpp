@@ -0,0 +1,123 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <cctype>
+
+#ifdef MYL_TEST
+#include <Test/Test.h>
+#endif
+
+#include "FormScanner.h"
+
+static bool
+isFormSpace( char c ) {
+    return std::isspace( static_cast< unsigned char >( c ) );
+}
+
+bool
+FormScanner::next( std::string_view text, bool endOfInput ) {
+    for ( size_t i = this->m_position; i < text.size(); ++i ) {
+        const char c = text[ i ];
+
+        if ( !this->m_inForm ) {
+            if ( isFormSpace( c ) ) {
+                continue;
+            }
+            this->m_formBegin = i;
+            if ( c == ')' ) {
+                this->m_formEnd = i + 1;
+                this->m_position = i + 1;
+                return true;
+            }
+            this->m_inForm = true;
+            this->m_inAtom = ( c != '(' );
+            this->m_depth = ( c == '(' ) ? 1 : 0;
+            continue;
+        }
+
+        if ( this->m_inAtom ) {
+            if ( isFormSpace( c ) || c == '(' || c == ')' ) {
+                // Don't consume the terminator, it may start the next form.
+                this->m_inForm = false;
+                this->m_inAtom = false;
+                this->m_formEnd = i;
+                this->m_position = i;
+                return true;
+            }
+            continue;
+        }
+
+        if ( c == '(' ) {
+            this->m_depth += 1;
+        } else if ( c == ')' ) {
+            this->m_depth -= 1;
+            if ( this->m_depth == 0 ) {
+                this->m_inForm = false;
+                this->m_formEnd = i + 1;
+                this->m_position = i + 1;
+                return true;
+            }
+        }
+    }
+
+    this->m_position = text.size();
+    if ( endOfInput && this->m_inAtom ) {
+        this->m_inForm = false;
+        this->m_inAtom = false;
+        this->m_formEnd = text.size();
+        return true;
+    }
+    return false;
+}
+
+void
+FormScanner::shift( size_t amount ) {
+    this->m_position -= amount;
+    this->m_formBegin = this->m_formBegin >= amount ? this->m_formBegin - amount : 0;
+    this->m_formEnd = this->m_formEnd >= amount ? this->m_formEnd - amount : 0;
+}
+
+void
+FormScanner::reset( size_t position ) {
+    this->m_position = position;
+    this->m_formBegin = position;
+    this->m_formEnd = position;
+    this->m_depth = 0;
+    this->m_inForm = false;
+    this->m_inAtom = false;
+}
+
+#ifdef MYL_TEST
+void
+testFormScanner( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Scan top-level forms" );
+
+    { // Lists and atoms.
+        const std::string_view src = " (a (b) 1) foo\n(c)";
+        FormScanner scanner;
+        TM42_TEST_ASSERT( ctx, scanner.next( src, true ) );
+        TM42_TEST_ASSERT( ctx, scanner.formBegin() == 1 );
+        TM42_TEST_ASSERT( ctx, scanner.formEnd() == 10 );
+        TM42_TEST_ASSERT( ctx, scanner.next( src, true ) );
+        TM42_TEST_ASSERT( ctx, src.substr( scanner.formBegin(),
+                                           scanner.formEnd() - scanner.formBegin() )
+                          == "foo" );
+        TM42_TEST_ASSERT( ctx, scanner.next( src, true ) );
+        TM42_TEST_ASSERT( ctx, scanner.formBegin() == 15 );
+        TM42_TEST_ASSERT( ctx, scanner.formEnd() == 18 );
+        TM42_TEST_ASSERT( ctx, !scanner.next( src, true ) );
+    }
+    { // Resuming on a growing buffer.
+        FormScanner scanner;
+        TM42_TEST_ASSERT( ctx, !scanner.next( "(a (b", false ) );
+        TM42_TEST_ASSERT( ctx, scanner.inForm() );
+        TM42_TEST_ASSERT( ctx, scanner.next( "(a (b))", false ) );
+        TM42_TEST_ASSERT( ctx, scanner.formEnd() == 7 );
+        // An atom is only complete once we know nothing follows it.
+        TM42_TEST_ASSERT( ctx, !scanner.next( "(a (b)) 12", false ) );
+        TM42_TEST_ASSERT( ctx, scanner.next( "(a (b)) 12", true ) );
+        TM42_TEST_ASSERT( ctx, scanner.formBegin() == 8 );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
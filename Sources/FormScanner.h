@@ -0,0 +1,43 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Finds the boundaries of top-level forms without lexing them. A top-level form is
+// either a parenthesized list (from a '(' at depth zero to its matching ')') or an
+// atom at depth zero (a maximal run of bytes that are neither whitespace nor
+// parentheses). A stray ')' at depth zero is reported as a one-byte form, so that
+// the parser gets to complain about it.
+//
+// The scanner is resumable: `next()` can be called on a growing buffer, and will
+// pick up where it left off.
+class FormScanner {
+public:
+    // Scan `text` from the current position. Returns true if a complete form was
+    // found, in which case it is `text[ formBegin(), formEnd() )` and the scanner is
+    // positioned right after it. If `endOfInput` is set, an atom running into the
+    // end of `text` counts as complete; an unterminated list never does.
+    bool next( std::string_view text, bool endOfInput );
+
+    size_t formBegin() const { return m_formBegin; }
+    size_t formEnd() const { return m_formEnd; }
+    // Offset the scanner will resume from.
+    size_t position() const { return m_position; }
+    // True if we are in the middle of a form.
+    bool inForm() const { return m_inForm; }
+
+    // The caller dropped the first `amount` bytes of its buffer.
+    void shift( size_t amount );
+    // Resume scanning at `position`, which must be at depth zero.
+    void reset( size_t position );
+
+private:
+    size_t m_position = 0;
+    size_t m_formBegin = 0;
+    size_t m_formEnd = 0;
+    int m_depth = 0;
+    bool m_inForm = false;
+    bool m_inAtom = false;
+};
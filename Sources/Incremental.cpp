@@ -0,0 +1,221 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef MYL_TEST
+#include <sstream>
+#include <Test/Test.h>
+#endif
+#include <Tracing/Tracing.h>
+
+#include "FormScanner.h"
+#include "Incremental.h"
+#include "Lexer.h"
+
+extern TraceContext TC;
+
+static SourceOffset
+endOf( SourceCodeLocation loc ) {
+    return loc.byteOffset() + loc.byteLength();
+}
+
+static Parser::Result
+parseRange( std::string_view source, SourceOffset begin, SourceOffset end,
+            std::shared_ptr< SymbolInterner > symbolInterner ) {
+    const auto prefix = source.substr( 0, end );
+    auto lexer = Lexer( prefix, begin, std::move( symbolInterner ) );
+    const auto lexResult = lexer.lex();
+    if ( lexResult.error ) {
+        return { {}, true, {} };
+    }
+    auto parser = Parser( prefix, lexResult.tokens );
+    return parser.parse();
+}
+
+Parser::Result
+reparse( Parser::Result previous, std::string_view source, SourceEdit edit,
+         std::shared_ptr< SymbolInterner > symbolInterner ) {
+    auto & sexprs = previous.sexprs;
+    auto & locs = previous.locs;
+    const SourceOffset delta = edit.insertedLength - edit.removedLength;
+    const SourceOffset oldEditEnd = edit.byteOffset + edit.removedLength;
+
+    // Forms [ first, next ) touch the edit. Touching counts, since e.g. typing right
+    // after an atom extends it.
+    const size_t first = std::partition_point(
+        locs.begin(), locs.end(),
+        [ & ]( SourceCodeLocation loc ) { return endOf( loc ) < edit.byteOffset; } ) -
+        locs.begin();
+    size_t next = std::partition_point(
+        locs.begin() + first, locs.end(),
+        [ & ]( SourceCodeLocation loc ) { return loc.byteOffset() <= oldEditEnd; } ) -
+        locs.begin();
+
+    // Region to re-parse, in new source coordinates. It starts at depth zero: either
+    // at the first touched form, or in whitespace between forms.
+    SourceOffset regionBegin = edit.byteOffset;
+    SourceOffset regionEnd = edit.byteOffset + edit.insertedLength;
+    if ( first < next ) {
+        regionBegin = std::min( regionBegin, locs[ first ].byteOffset() );
+        regionEnd = std::max( regionEnd, endOf( locs[ next - 1 ] ) + delta );
+    }
+
+    SourceOffset scannedEnd = regionBegin;
+    if ( previous.error ) {
+        // Only the forms before the error are kept; nothing after them parsed, so it
+        // is all re-parsed, from the first form the edit touches or else from the
+        // end of the last form kept.
+        if ( first == locs.size() ) {
+            regionBegin = first > 0 ? endOf( locs[ first - 1 ] ) : 0;
+        }
+        next = locs.size();
+        scannedEnd = static_cast< SourceOffset >( source.size() );
+    } else {
+        // Grow the region form by form until it ends at a top-level boundary that
+        // doesn't cut into the following unchanged form. An edit that unbalances
+        // parentheses can swallow any number of following forms.
+        FormScanner scanner;
+        scanner.reset( regionBegin );
+        while ( true ) {
+            while ( scannedEnd < regionEnd ) {
+                if ( !scanner.next( source, true ) ) {
+                    scannedEnd = static_cast< SourceOffset >( source.size() );
+                    break;
+                }
+                scannedEnd = static_cast< SourceOffset >( scanner.formEnd() );
+            }
+            if ( next < locs.size() && locs[ next ].byteOffset() + delta < scannedEnd ) {
+                regionEnd = std::max( regionEnd, endOf( locs[ next ] ) + delta );
+                next += 1;
+                continue;
+            }
+            break;
+        }
+    }
+
+    t1( &TC, "Re-parsing bytes [%lld, %lld), forms [%zu, %zu) of %zu",
+        static_cast< long long >( regionBegin ), static_cast< long long >( scannedEnd ),
+        first, next, locs.size() );
+    auto region = parseRange( source, regionBegin, scannedEnd,
+                              std::move( symbolInterner ) );
+
+    // Splice the new forms in, and shift everything after them.
+    sexprs.erase( sexprs.begin() + first, sexprs.begin() + next );
+    sexprs.insert( sexprs.begin() + first,
+                   std::make_move_iterator( region.sexprs.begin() ),
+                   std::make_move_iterator( region.sexprs.end() ) );
+    locs.erase( locs.begin() + first, locs.begin() + next );
+    locs.insert( locs.begin() + first, region.locs.begin(), region.locs.end() );
+    for ( size_t i = first + region.locs.size(); i < locs.size(); ++i ) {
+        locs[ i ] = locs[ i ].shifted( delta );
+    }
+
+    if ( region.error ) {
+        // Like a full parse, stop at the first error.
+        sexprs.resize( first + region.sexprs.size() );
+        locs.resize( first + region.locs.size() );
+    }
+    previous.error = region.error;
+    return previous;
+}
+
+#ifdef MYL_TEST
+static std::string
+printResult( const Parser::Result & result ) {
+    std::ostringstream os;
+    for ( size_t i = 0; i < result.sexprs.size(); ++i ) {
+        os << *result.sexprs[ i ] << " @" << result.locs[ i ].byteOffset() << "+"
+           << result.locs[ i ].byteLength() << "\n";
+    }
+    return os.str();
+}
+
+static Parser::Result
+parseAll( std::string_view src ) {
+    auto lexer = Lexer( src );
+    const auto lexResult = lexer.lex();
+    auto parser = Parser( src, lexResult.tokens );
+    return parser.parse();
+}
+
+// Apply `edit` to `src`, and check the incremental result against a full parse.
+static bool
+checkEdit( std::string src, SourceEdit edit, const std::string & inserted ) {
+    auto previous = parseAll( src );
+    src.replace( edit.byteOffset, edit.removedLength, inserted );
+    const auto incremental = reparse( std::move( previous ), src, edit );
+    const auto full = parseAll( src );
+    return incremental.error == full.error &&
+        printResult( incremental ) == printResult( full );
+}
+
+void
+testIncrementalReparse( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Incremental re-parse" );
+
+    const std::string src = "(a 1)  (b (c 2))\nfoo (d @x 3.5)  bar";
+
+    { // Untouched forms are reused.
+        auto previous = parseAll( src );
+        const auto * firstForm = previous.sexprs[ 0 ].get();
+        const auto * lastForm = previous.sexprs[ 4 ].get();
+        std::string edited = src;
+        edited.replace( 12, 1, "222" );
+        const auto result = reparse( std::move( previous ), edited, { 12, 1, 3 } );
+        TM42_TEST_ASSERT( ctx, result.sexprs[ 0 ].get() == firstForm );
+        TM42_TEST_ASSERT( ctx, result.sexprs[ 4 ].get() == lastForm );
+        TM42_TEST_ASSERT( ctx, printResult( result ) == printResult( parseAll( edited ) ) );
+    }
+
+    // Change inside a form.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 3, 1, 2 }, "42" ) );
+    // Extend an atom.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 20, 0, 2 }, "oo" ) );
+    // New form in whitespace.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 6, 0, 3 }, "new" ) );
+    // Whitespace only.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 6, 0, 2 }, "\n\n" ) );
+    // Join two forms by deleting a ')'.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 4, 1, 0 }, "" ) );
+    // Split a form.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 10, 0, 2 }, ") " ) );
+    // Delete everything between two forms.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { 5, 12, 0 }, "" ) );
+    // Append at the end.
+    TM42_TEST_ASSERT( ctx, checkEdit( src, { int( src.size() ), 0, 4 }, " (z)" ) );
+
+    { // Unbalanced edits are errors, and recover once fixed.
+        auto previous = parseAll( src );
+        std::string edited = src;
+        edited.insert( 7, "(" );
+        auto broken = reparse( std::move( previous ), edited, { 7, 0, 1 } );
+        TM42_TEST_ASSERT( ctx, broken.error );
+        edited.erase( 7, 1 );
+        const auto fixed = reparse( std::move( broken ), edited, { 7, 1, 0 } );
+        TM42_TEST_ASSERT( ctx, !fixed.error );
+        TM42_TEST_ASSERT( ctx, printResult( fixed ) == printResult( parseAll( src ) ) );
+    }
+    { // While unbalanced, the forms before the error are kept.
+        const std::string broken = "(a 1)  (b (c 2)\nfoo (d @x 3.5)  bar";
+        auto previous = parseAll( broken );
+        TM42_TEST_ASSERT( ctx, previous.error && previous.sexprs.size() == 1 );
+        const auto * firstForm = previous.sexprs[ 0 ].get();
+        std::string edited = broken;
+        edited.insert( 20, "x" );
+        const auto result = reparse( std::move( previous ), edited, { 20, 0, 1 } );
+        TM42_TEST_ASSERT( ctx, result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs[ 0 ].get() == firstForm );
+        TM42_TEST_ASSERT( ctx, printResult( result ) == printResult( parseAll( edited ) ) );
+
+        // Typing inside the broken form, or before it, and closing it.
+        TM42_TEST_ASSERT( ctx, checkEdit( broken, { 20, 0, 1 }, "x" ) );
+        TM42_TEST_ASSERT( ctx, checkEdit( broken, { 3, 1, 2 }, "42" ) );
+        TM42_TEST_ASSERT( ctx, checkEdit( broken, { 6, 0, 3 }, "(y)" ) );
+        TM42_TEST_ASSERT( ctx, checkEdit( broken, { 15, 0, 1 }, ")" ) );
+        TM42_TEST_ASSERT( ctx, checkEdit( broken, { 7, 1, 0 }, "" ) );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
@@ -0,0 +1,36 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include "Intern.h"
+#include "Parser.h"
+
+// A single contiguous edit: `removedLength` bytes at `byteOffset` in the old source
+// were replaced by `insertedLength` bytes in the new one.
+struct SourceEdit {
+    SourceOffset byteOffset;
+    SourceOffset removedLength;
+    SourceOffset insertedLength;
+};
+
+// Update `previous`, the result of parsing the source before `edit`, to match
+// `source`, the text after it. Only the top-level forms the edit touches are
+// re-lexed and re-parsed (more, if the edit unbalances parentheses); every other
+// form is moved over as-is and has its location shifted.
+//
+// If `previous` has an error, the forms before it are kept as above, and parsing
+// resumes from the first of them the edit touches, or else from where the error
+// was, to the end of `source`.
+//
+// Lexing and parsing take time proportional to the region re-parsed, but splicing
+// the new forms into `previous` and shifting the locations after them is linear in
+// the number of forms: flat vectors, about 1ms per edit near the start of 100k
+// forms. That is kept over a relative-offset or gap-buffer layout so that a
+// `Parser::Result` stays the same whether it came from here or from `parse()`.
+Parser::Result reparse( Parser::Result previous, std::string_view source,
+                        SourceEdit edit,
+                        std::shared_ptr< SymbolInterner > symbolInterner =
+                            SymbolInterner::global() );
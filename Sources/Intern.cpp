@@ -1,24 +1,210 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
+#include <cstring>
+
 #include "Intern.h"
+#include "Metrics.h"
 
 #ifdef MYL_TEST
+#include <string>
+#include <thread>
 #include <Test/Test.h>
 #endif
 
+static constexpr size_t INITIAL_SLOT_COUNT = 64;
+static constexpr size_t ARENA_BLOCK_SIZE = 16 * 1024;
+
+SymbolInterner::Table::Table( size_t size )
+    : mask( size - 1 ), slots( new std::atomic< std::uint64_t >[ size ] ) {
+    for ( size_t i = 0; i < size; ++i ) {
+        this->slots[ i ].store( 0, std::memory_order_relaxed );
+    }
+}
+
+SymbolInterner::SymbolInterner(): m_shards( new Shard[ SHARD_COUNT ] ) {
+    for ( unsigned i = 0; i < SHARD_COUNT; ++i ) {
+        Shard & shard = this->m_shards[ i ];
+        shard.tables.push_back( std::make_unique< Table >( INITIAL_SLOT_COUNT ) );
+        shard.table.store( shard.tables.back().get(), std::memory_order_release );
+        for ( auto & segment : shard.segments ) {
+            segment.store( nullptr, std::memory_order_relaxed );
+        }
+        shard.count.store( 0, std::memory_order_relaxed );
+    }
+}
+
+SymbolInterner::~SymbolInterner() {
+    for ( unsigned i = 0; i < SHARD_COUNT; ++i ) {
+        for ( auto & segment : this->m_shards[ i ].segments ) {
+            delete[] segment.load( std::memory_order_relaxed );
+        }
+    }
+}
+
+std::shared_ptr< SymbolInterner >
+SymbolInterner::global() {
+    static const auto interner = std::make_shared< SymbolInterner >();
+    return interner;
+}
+
+// FNV-1a.
+std::uint32_t
+SymbolInterner::hash( std::string_view str ) {
+    std::uint32_t h = 2166136261u;
+    for ( const char c : str ) {
+        h ^= static_cast< unsigned char >( c );
+        h *= 16777619u;
+    }
+    return h;
+}
+
+const SymbolInterner::Entry &
+SymbolInterner::entry( const Shard & shard, std::uint32_t localIdx ) {
+    const std::uint32_t biased = localIdx + ( 1u << FIRST_SEGMENT_BITS );
+    const unsigned segmentIdx = ( 31 - __builtin_clz( biased ) ) - FIRST_SEGMENT_BITS;
+    const std::uint32_t segmentStart = ( 1u << FIRST_SEGMENT_BITS ) << segmentIdx;
+    const Entry * segment =
+        shard.segments[ segmentIdx ].load( std::memory_order_acquire );
+    return segment[ biased - segmentStart ];
+}
+
+// Returns the id of `str` if it is in `table`, 0 otherwise. If `emptyIdx` is
+// non-null, it is set to the empty slot at which the probe stopped.
 InternedSymbol
-SymbolInterner::intern( const std::string & str ) {
-    auto it = stringToId.find( str );
-    if ( it != stringToId.end() ) {
-        return it->second;
+SymbolInterner::probe( const Table & table, const Shard & shard, std::uint32_t h,
+                       std::string_view str, size_t * emptyIdx ) {
+    size_t idx = h & table.mask;
+    while ( true ) {
+        const std::uint64_t slot = table.slots[ idx ].load( std::memory_order_acquire );
+        if ( slot == 0 ) {
+            if ( emptyIdx ) {
+                *emptyIdx = idx;
+            }
+            return 0;
+        }
+        if ( static_cast< std::uint32_t >( slot ) == h ) {
+            const auto id = static_cast< InternedSymbol >( slot >> 32 );
+            const Entry & e = entry( shard, ( id >> SHARD_BITS ) - 1 );
+            if ( e.length == str.size() &&
+                 std::memcmp( e.data, str.data(), str.size() ) == 0 ) {
+                return id;
+            }
+        }
+        idx = ( idx + 1 ) & table.mask;
+    }
+}
+
+const char *
+SymbolInterner::copyToArena( Shard & shard, std::string_view str ) {
+    if ( shard.arenaBlockUsed + str.size() > shard.arenaBlockSize ) {
+        // Oversized strings get a block of their own.
+        const size_t blockSize = std::max( ARENA_BLOCK_SIZE, str.size() );
+        shard.arenaBlocks.push_back( std::make_unique< char[] >( blockSize ) );
+        Metrics::add( Metrics::Counter::INTERN_ARENA_BYTES, blockSize );
+        shard.arenaBlockSize = blockSize;
+        shard.arenaBlockUsed = 0;
     }
+    char * dest = shard.arenaBlocks.back().get() + shard.arenaBlockUsed;
+    std::memcpy( dest, str.data(), str.size() );
+    shard.arenaBlockUsed += str.size();
+    return dest;
+}
 
-    idToString.push_back(str);
-    const InternedSymbol id = static_cast<InternedSymbol>( idToString.size() );
-    stringToId[ str ] = id;
+void
+SymbolInterner::grow( Shard & shard ) {
+    const Table & old = *shard.tables.back();
+    auto table = std::make_unique< Table >( ( old.mask + 1 ) * 2 );
+    for ( size_t i = 0; i <= old.mask; ++i ) {
+        const std::uint64_t slot = old.slots[ i ].load( std::memory_order_relaxed );
+        if ( slot == 0 ) {
+            continue;
+        }
+        size_t idx = static_cast< std::uint32_t >( slot ) & table->mask;
+        while ( table->slots[ idx ].load( std::memory_order_relaxed ) != 0 ) {
+            idx = ( idx + 1 ) & table->mask;
+        }
+        table->slots[ idx ].store( slot, std::memory_order_relaxed );
+    }
+    // Readers may still be probing the old table, so it stays alive.
+    shard.table.store( table.get(), std::memory_order_release );
+    shard.tables.push_back( std::move( table ) );
+}
+
+InternedSymbol
+SymbolInterner::insert( Shard & shard, std::uint32_t h, std::string_view str,
+                        bool * inserted ) {
+    std::lock_guard< std::mutex > lock( shard.mutex );
+
+    // Someone may have inserted it since our lock-free probe.
+    Table & table = *shard.tables.back();
+    size_t emptyIdx;
+    if ( inserted ) {
+        *inserted = false;
+    }
+    if ( const auto id = probe( table, shard, h, str, &emptyIdx ); id != 0 ) {
+        return id;
+    }
+    if ( inserted ) {
+        *inserted = true;
+    }
+
+    const std::uint32_t localIdx = shard.count.load( std::memory_order_relaxed );
+    const std::uint32_t biased = localIdx + ( 1u << FIRST_SEGMENT_BITS );
+    const unsigned segmentIdx = ( 31 - __builtin_clz( biased ) ) - FIRST_SEGMENT_BITS;
+    const std::uint32_t segmentStart = ( 1u << FIRST_SEGMENT_BITS ) << segmentIdx;
+    Entry * segment = shard.segments[ segmentIdx ].load( std::memory_order_relaxed );
+    if ( !segment ) {
+        segment = new Entry[ segmentStart ];
+        shard.segments[ segmentIdx ].store( segment, std::memory_order_release );
+    }
+    segment[ biased - segmentStart ] = {
+        this->copyToArena( shard, str ), static_cast< std::uint32_t >( str.size() ) };
+    shard.count.store( localIdx + 1, std::memory_order_relaxed );
+
+    const auto shardIdx = static_cast< InternedSymbol >( &shard - this->m_shards.get() );
+    const InternedSymbol id = ( ( localIdx + 1 ) << SHARD_BITS ) | shardIdx;
+    // Publishing the slot makes the entry visible to lock-free readers.
+    table.slots[ emptyIdx ].store( ( std::uint64_t( id ) << 32 ) | h,
+                                   std::memory_order_release );
+
+    // Keep the load factor at or below 1/2.
+    if ( size_t( localIdx + 1 ) * 2 > table.mask + 1 ) {
+        this->grow( shard );
+    }
     return id;
 }
 
+InternedSymbol
+SymbolInterner::intern( std::string_view str, bool * inserted ) {
+    const std::uint32_t h = hash( str );
+    Shard & shard = this->m_shards[ h >> ( 32 - SHARD_BITS ) ];
+    const Table * table = shard.table.load( std::memory_order_acquire );
+    if ( const auto id = probe( *table, shard, h, str, nullptr ); id != 0 ) {
+        if ( inserted ) {
+            *inserted = false;
+        }
+        return id;
+    }
+    return this->insert( shard, h, str, inserted );
+}
+
+std::string_view
+SymbolInterner::lookup( InternedSymbol id ) const {
+    const Shard & shard = this->m_shards[ id & ( SHARD_COUNT - 1 ) ];
+    const Entry & e = entry( shard, ( id >> SHARD_BITS ) - 1 );
+    return std::string_view( e.data, e.length );
+}
+
+size_t
+SymbolInterner::size() const {
+    size_t total = 0;
+    for ( unsigned i = 0; i < SHARD_COUNT; ++i ) {
+        total += this->m_shards[ i ].count.load( std::memory_order_relaxed );
+    }
+    return total;
+}
+
 #ifdef MYL_TEST
 void
 testSymbolInterner( Tm42_TestContext * ctx ) {
@@ -32,6 +218,58 @@ testSymbolInterner( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT(
             ctx,
             interner.intern( "foo" ) != interner.intern( "bar" ) );
+        TM42_TEST_ASSERT( ctx, interner.lookup( interner.intern( "bar" ) ) == "bar" );
+        TM42_TEST_ASSERT( ctx, interner.size() == 2 );
+        bool inserted;
+        interner.intern( "foo", &inserted );
+        TM42_TEST_ASSERT( ctx, !inserted );
+        interner.intern( "baz", &inserted );
+        TM42_TEST_ASSERT( ctx, inserted );
+    }
+    { // Growing the table keeps ids and views stable.
+        auto interner = SymbolInterner();
+        const auto first = interner.intern( "sym0" );
+        const auto firstView = interner.lookup( first );
+        for ( int i = 1; i < 10000; ++i ) {
+            interner.intern( "sym" + std::to_string( i ) );
+        }
+        TM42_TEST_ASSERT( ctx, interner.size() == 10000 );
+        TM42_TEST_ASSERT( ctx, interner.intern( "sym0" ) == first );
+        TM42_TEST_ASSERT( ctx, firstView.data() == interner.lookup( first ).data() );
+        TM42_TEST_ASSERT( ctx, interner.lookup( interner.intern( "sym9999" ) ) ==
+                          "sym9999" );
+        const auto longName = std::string( 100000, 'x' );
+        TM42_TEST_ASSERT( ctx, interner.lookup( interner.intern( longName ) ) ==
+                          longName );
+    }
+    { // Threads interning overlapping names agree on ids.
+        auto interner = SymbolInterner();
+        constexpr int THREADS = 4;
+        constexpr int NAMES = 5000;
+        std::vector< std::vector< InternedSymbol > > ids(
+            THREADS, std::vector< InternedSymbol >( NAMES ) );
+        std::vector< std::thread > threads;
+        for ( int t = 0; t < THREADS; ++t ) {
+            threads.emplace_back( [ &, t ]() {
+                for ( int i = 0; i < NAMES; ++i ) {
+                    const int name = ( t % 2 ) ? NAMES - 1 - i : i;
+                    ids[ t ][ name ] = interner.intern( "n" + std::to_string( name ) );
+                }
+            } );
+        }
+        for ( auto & thread : threads ) {
+            thread.join();
+        }
+        bool agree = true;
+        for ( int i = 0; i < NAMES; ++i ) {
+            for ( int t = 1; t < THREADS; ++t ) {
+                agree = agree && ( ids[ t ][ i ] == ids[ 0 ][ i ] );
+            }
+            agree = agree &&
+                ( interner.lookup( ids[ 0 ][ i ] ) == "n" + std::to_string( i ) );
+        }
+        TM42_TEST_ASSERT( ctx, agree );
+        TM42_TEST_ASSERT( ctx, interner.size() == NAMES );
     }
 
     TM42_END_TEST();
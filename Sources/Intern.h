@@ -2,17 +2,89 @@
 
 #pragma once
 
-#include <string>
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
 #include <vector>
 
 using InternedSymbol = uint32_t;
 
+// Maps strings to small nonzero integer ids. Safe to use from many threads at once.
+//
+// The interner is split into shards, selected by the top bits of a string's hash.
+// Each shard is an open-addressing table with linear probing, where each slot
+// caches the hash of its string, so probes only touch string bytes on a likely
+// match.
+// - Lookups of strings that are already interned, and `lookup()`, take no locks:
+//   slots are published with a single atomic store, tables are never modified
+//   except by filling empty slots, and superseded tables are kept alive until the
+//   interner is destroyed.
+// - Inserting a new string takes the shard's lock.
+//
+// String bytes live in per-shard append-only arenas made of blocks that never move,
+// so `lookup()` views stay valid for the lifetime of the interner. Ids are stable
+// and encode their shard, so they can be shared freely between threads.
 class SymbolInterner {
 public:
-    InternedSymbol intern( const std::string & str );
+    SymbolInterner();
+    ~SymbolInterner();
+    SymbolInterner( const SymbolInterner & ) = delete;
+    SymbolInterner & operator=( const SymbolInterner & ) = delete;
+
+    // The process-wide interner. Lexers use it unless given another one, so that
+    // symbols are comparable across inputs.
+    static std::shared_ptr< SymbolInterner > global();
+
+    // If `inserted` is non-null, it is set to whether `str` was new.
+    InternedSymbol intern( std::string_view str, bool * inserted = nullptr );
+    // Reverse lookup, `id` must have been returned by `intern()`.
+    std::string_view lookup( InternedSymbol id ) const;
+    // Number of distinct symbols.
+    size_t size() const;
 
 private:
-    std::unordered_map< std::string, InternedSymbol > stringToId;
-    std::vector<std::string> idToString;
+    static constexpr unsigned SHARD_BITS = 6;
+    static constexpr unsigned SHARD_COUNT = 1u << SHARD_BITS;
+    // Entry segment k holds FIRST_SEGMENT_SIZE << k entries.
+    static constexpr unsigned FIRST_SEGMENT_BITS = 8;
+    static constexpr unsigned SEGMENT_COUNT = 32 - SHARD_BITS - FIRST_SEGMENT_BITS + 1;
+
+    struct Entry {
+        const char * data;
+        std::uint32_t length;
+    };
+    // Slots pack ( id << 32 | hash ), 0 marks an empty slot.
+    struct Table {
+        size_t mask;
+        std::unique_ptr< std::atomic< std::uint64_t >[] > slots;
+
+        explicit Table( size_t size );
+    };
+    struct Shard {
+        std::atomic< Table * > table;
+        std::atomic< Entry * > segments[ SEGMENT_COUNT ];
+        std::atomic< std::uint32_t > count;
+
+        // Everything below is only touched with `mutex` held.
+        std::mutex mutex;
+        std::vector< std::unique_ptr< Table > > tables;
+        std::vector< std::unique_ptr< char[] > > arenaBlocks;
+        size_t arenaBlockUsed = 0;
+        size_t arenaBlockSize = 0;
+    };
+
+    static std::uint32_t hash( std::string_view str );
+    static InternedSymbol probe( const Table & table, const Shard & shard,
+                                 std::uint32_t h, std::string_view str,
+                                 size_t * emptyIdx );
+    static const Entry & entry( const Shard & shard, std::uint32_t localIdx );
+
+    InternedSymbol insert( Shard & shard, std::uint32_t h, std::string_view str,
+                           bool * inserted );
+    const char * copyToArena( Shard & shard, std::string_view str );
+    void grow( Shard & shard );
+
+    std::unique_ptr< Shard[] > m_shards;
 };
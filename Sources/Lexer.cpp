@@ -1,14 +1,20 @@
 
+#include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <iterator>
 
 #ifdef MYL_TEST
 #include <cmath>
+#include <iostream>
+#include <sstream>
 #include <Test/Test.h>
 #endif
-#include <Tracing/Tracing.h>
 #include <Unicode/Unicode.h>
 
 #include "Lexer.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 extern struct TraceContext TC;
 
@@ -27,31 +33,240 @@ tokenKindStr( TokenKind tk ) {
         return "TokenKind::FLOAT64";
     case TokenKind::LABEL:
         return "TokenKind::LABEL";
+    case TokenKind::END:
+        return "TokenKind::END";
     default:
         return "TokenKind::???";
     }
 }
 
-Lexer::Lexer( const std::string & input ): m_input( input ) {
-    this->symbolInterner = std::make_shared< SymbolInterner >();
+void
+TokenBuffer::push( const Token & token ) {
+    const auto idx = static_cast< std::uint32_t >( this->m_kinds.size() );
+    this->m_kinds.push_back( token.kind );
+    const SourceOffset offset = token.loc.byteOffset();
+    const SourceOffset length = token.loc.byteLength();
+    this->m_offsets.push_back( static_cast< std::uint32_t >( offset ) );
+    const auto high = static_cast< std::uint32_t >( offset >> 32 );
+    const auto lastHigh =
+        this->m_offsetHighs.empty() ? 0 : this->m_offsetHighs.back().second;
+    if ( high != lastHigh ) {
+        this->m_offsetHighs.emplace_back( idx, high );
+    }
+
+    if ( length >= LONG_LENGTH ) {
+        this->m_lengths.push_back( LONG_LENGTH );
+        this->m_longLengths.emplace_back( idx, static_cast< std::uint32_t >( length ) );
+    } else {
+        this->m_lengths.push_back( static_cast< std::uint16_t >( length ) );
+    }
+
+    std::uint32_t payload = 0;
+    switch ( token.kind ) {
+    case TokenKind::IDENT:
+    case TokenKind::LABEL:
+        payload = std::get< InternedSymbol >( token.data );
+        break;
+    case TokenKind::INT32:
+        payload = static_cast< std::uint32_t >( std::get< I32 >( token.data ) );
+        break;
+    case TokenKind::FLOAT64:
+        payload = static_cast< std::uint32_t >( this->m_wides.size() );
+        this->m_wides.push_back( std::get< F64 >( token.data ) );
+        break;
+    default:
+        break;
+    }
+    this->m_payloads.push_back( payload );
 }
 
+void
+TokenBuffer::reserve( size_t count ) {
+    this->m_kinds.reserve( count );
+    this->m_offsets.reserve( count );
+    this->m_lengths.reserve( count );
+    this->m_payloads.reserve( count );
+}
+
+SourceCodeLocation
+TokenBuffer::loc( size_t idx ) const {
+    SourceOffset length = this->m_lengths[ idx ];
+    if ( length == LONG_LENGTH ) {
+        const auto it = std::lower_bound(
+            this->m_longLengths.begin(), this->m_longLengths.end(),
+            std::make_pair( static_cast< std::uint32_t >( idx ), std::uint32_t( 0 ) ) );
+        length = it->second;
+    }
+    SourceOffset high = 0;
+    if ( !this->m_offsetHighs.empty() ) {
+        // Set by the last change at or before `idx`.
+        const auto it = std::upper_bound(
+            this->m_offsetHighs.begin(), this->m_offsetHighs.end(),
+            std::make_pair( static_cast< std::uint32_t >( idx ), UINT32_MAX ) );
+        if ( it != this->m_offsetHighs.begin() ) {
+            high = std::prev( it )->second;
+        }
+    }
+    return { ( high << 32 ) | this->m_offsets[ idx ], length };
+}
+
+Token
+TokenBuffer::operator[]( size_t idx ) const {
+    Token token;
+    token.kind = this->kind( idx );
+    token.loc = this->loc( idx );
+    switch ( token.kind ) {
+    case TokenKind::IDENT:
+    case TokenKind::LABEL:
+        token.data = this->symbol( idx );
+        break;
+    case TokenKind::INT32:
+        token.data = this->int32( idx );
+        break;
+    case TokenKind::FLOAT64:
+        token.data = this->float64( idx );
+        break;
+    default:
+        break;
+    }
+    return token;
+}
+
+size_t
+TokenBuffer::bytesUsed() const {
+    return this->m_kinds.size() * ( sizeof( TokenKind ) + sizeof( std::uint32_t ) +
+                                    sizeof( std::uint16_t ) + sizeof( std::uint32_t ) ) +
+           this->m_wides.size() * sizeof( F64 ) +
+           this->m_longLengths.size() * sizeof( this->m_longLengths[ 0 ] ) +
+           this->m_offsetHighs.size() * sizeof( this->m_offsetHighs[ 0 ] );
+}
+
+#ifdef MYL_TEST
+void
+testTokenBuffer( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Token buffer" );
+
+    { // Round trip every kind of payload.
+        TokenBuffer buffer;
+        buffer.push( { TokenKind::LPAREN, {}, { 0, 1 } } );
+        buffer.push( { TokenKind::IDENT, InternedSymbol( 7 ), { 1, 3 } } );
+        buffer.push( { TokenKind::INT32, I32( -5 ), { 5, 2 } } );
+        buffer.push( { TokenKind::FLOAT64, F64( 2.5 ), { 8, 3 } } );
+        buffer.push( { TokenKind::LABEL, InternedSymbol( 9 ), { 12, 4 } } );
+        buffer.push( { TokenKind::IDENT, InternedSymbol( 1 ), { 16, 100000 } } );
+
+        TM42_TEST_ASSERT( ctx, buffer.size() == 6 );
+        TM42_TEST_ASSERT( ctx, buffer.kind( 0 ) == TokenKind::LPAREN );
+        TM42_TEST_ASSERT( ctx, buffer.symbol( 1 ) == 7 );
+        TM42_TEST_ASSERT( ctx, buffer.int32( 2 ) == -5 );
+        TM42_TEST_ASSERT( ctx, buffer.float64( 3 ) == 2.5 );
+        TM42_TEST_ASSERT( ctx, std::get< InternedSymbol >( buffer[ 4 ].data ) == 9 );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 4 ).byteOffset() == 12 );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 4 ).byteLength() == 4 );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 5 ).byteLength() == 100000 );
+    }
+    { // Offsets past 4GiB.
+        const SourceOffset far = ( SourceOffset( 5 ) << 32 ) + 3;
+        TokenBuffer buffer;
+        buffer.push( { TokenKind::LPAREN, {}, { 7, 1 } } );
+        buffer.push( { TokenKind::INT32, I32( 1 ), { far, 1 } } );
+        buffer.push( { TokenKind::INT32, I32( 2 ), { far + 2, 1 } } );
+        buffer.push( { TokenKind::RPAREN, {}, { SourceCodeLocation::MAX_OFFSET, 1 } } );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 0 ).byteOffset() == 7 );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 1 ).byteOffset() == far );
+        TM42_TEST_ASSERT( ctx, buffer.loc( 2 ).byteOffset() == far + 2 );
+        const auto last = buffer[ 3 ].loc;
+        TM42_TEST_ASSERT( ctx, last.byteOffset() == SourceCodeLocation::MAX_OFFSET );
+    }
+    { // At least 2.5x smaller than a vector of tokens.
+        TokenBuffer buffer;
+        for ( int i = 0; i < 1000; ++i ) {
+            buffer.push( { TokenKind::INT32, I32( i ), { i, 1 } } );
+        }
+        TM42_TEST_ASSERT( ctx, buffer.bytesUsed() * 5 <= 1000 * sizeof( Token ) * 2 );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
+
+Lexer::Lexer( std::string_view input )
+    : m_input( input ), symbolInterner( SymbolInterner::global() ) {}
+
+Lexer::Lexer( std::string_view input,
+              std::shared_ptr< SymbolInterner > symbolInterner )
+    : m_input( input ), symbolInterner( std::move( symbolInterner ) ) {}
+
+Lexer::Lexer( std::string_view input, SourceOffset beginByteOffset,
+              std::shared_ptr< SymbolInterner > symbolInterner )
+    : m_input( input ),
+      m_currentByteOffset( beginByteOffset ),
+      symbolInterner( std::move( symbolInterner ) ) {}
+
+Lexer::Lexer( const SourceManager & sources, SourceManager::FileId file,
+              std::shared_ptr< SymbolInterner > symbolInterner )
+    : m_input( sources.text( file ) ),
+      symbolInterner( std::move( symbolInterner ) ),
+      m_sources( &sources ),
+      m_baseOffset( sources.baseOffset( file ) ) {}
+
 std::string_view
 Lexer::getStringView( SourceCodeLocation loc ) {
-    return std::string_view( this->m_input ).substr(
-        loc.byteOffset, loc.byteLength );
+    return this->m_input.substr( loc.byteOffset(), loc.byteLength() );
+}
+
+const LineIndex &
+Lexer::lineIndex() {
+    if ( !this->m_lineIndex ) {
+        this->m_lineIndex.emplace( this->m_input );
+    }
+    return *this->m_lineIndex;
+}
+
+void
+Lexer::emitError( SourceCodeLocation loc, const std::string & msg ) {
+    if ( this->m_sources ) {
+        this->m_sources->emitError( loc.shifted( this->m_baseOffset ), msg );
+    } else {
+        emitSourceError( this->m_input, this->lineIndex(), loc, msg );
+    }
 }
 
 bool
 Lexer::endOfInput() {
-    return this->m_currentByteOffset >= this->m_input.size();
+    return this->m_currentByteOffset >=
+           static_cast< SourceOffset >( this->m_input.size() );
+}
+
+// The length of the UTF-8 sequence that `lead` begins, going by its high bits.
+static int
+utf8SequenceLength( unsigned char lead ) {
+    if ( lead < 0x80 ) {
+        return 1;
+    } else if ( ( lead & 0xE0 ) == 0xC0 ) {
+        return 2;
+    } else if ( ( lead & 0xF0 ) == 0xE0 ) {
+        return 3;
+    }
+    return 4;
 }
 
 void
 Lexer::readCodepoint() {
-    this->m_codepointSize = tm42::utf8::readCodepoint(
-        this->m_input.c_str() + ( this->m_currentByteOffset ),
-        &this->m_codepoint );
+    if ( this->endOfInput() ) {
+        this->m_codepoint = 0;
+        this->m_codepointSize = 0;
+        return;
+    }
+    const char * bytes = this->m_input.data() + this->m_currentByteOffset;
+    const SourceOffset remaining = this->m_input.size() - this->m_currentByteOffset;
+    // The decoder trusts the lead byte, and would read past the end.
+    if ( utf8SequenceLength( bytes[ 0 ] ) > remaining ) {
+        this->m_codepoint = TRUNCATED_CODEPOINT;
+        this->m_codepointSize = static_cast< int >( remaining );
+        return;
+    }
+    this->m_codepointSize = tm42::utf8::readCodepoint( bytes, &this->m_codepoint );
 }
 
 void
@@ -59,33 +274,101 @@ Lexer::advanceReadCodepoint() {
     this->m_currentByteOffset += this->m_codepointSize;
 }
 
+// The <cctype> classifiers are only defined for values of `unsigned char`, but
+// codepoints go well beyond that.
+static bool
+isAsciiSpace( int codepoint ) {
+    return codepoint < 0x80 && std::isspace( codepoint );
+}
+
+static bool
+isAsciiDigit( int codepoint ) {
+    return codepoint < 0x80 && std::isdigit( codepoint );
+}
+
 void
 Lexer::eatWhitespace() {
     if ( this->endOfInput() ) {
         return;
     }
     this->readCodepoint();
-    while ( !this->endOfInput() && std::isspace( m_codepoint ) ) {
+    while ( !this->endOfInput() && isAsciiSpace( m_codepoint ) ) {
         this->advanceReadCodepoint();
         this->readCodepoint();
     }
 }
 
+// Non-ASCII codepoints count as letters, so identifiers can be written in any
+// script, except for controls, whitespace, punctuation and codepoints that aren't
+// characters at all. These are the ranges of those.
+static bool
+isNonAsciiLetter( int codepoint ) {
+    struct Range {
+        int first;
+        int last;
+    };
+    static constexpr Range NOT_LETTERS[] = {
+        // C1 controls, NEL, NBSP, and Latin-1 punctuation and symbols, but for the
+        // letters ª, µ and º.
+        { 0x80, 0xA9 },
+        { 0xAB, 0xB4 },
+        { 0xB6, 0xB9 },
+        { 0xBB, 0xBF },
+        // × and ÷.
+        { 0xD7, 0xD7 },
+        { 0xF7, 0xF7 },
+        // Ogham space mark.
+        { 0x1680, 0x1680 },
+        // General punctuation: the Unicode spaces, zero-width characters, line and
+        // paragraph separators, dashes, quotes, ...
+        { 0x2000, 0x206F },
+        // Supplemental punctuation.
+        { 0x2E00, 0x2E7F },
+        // Ideographic space and punctuation, and CJK brackets.
+        { 0x3000, 0x3003 },
+        { 0x3008, 0x3011 },
+        { 0x3014, 0x301F },
+        // Surrogates.
+        { 0xD800, 0xDFFF },
+        // Vertical, compatibility and small form punctuation.
+        { 0xFE10, 0xFE1F },
+        { 0xFE30, 0xFE6F },
+        // Zero-width no-break space (BOM).
+        { 0xFEFF, 0xFEFF },
+        // Fullwidth punctuation.
+        { 0xFF01, 0xFF0F },
+        { 0xFF1A, 0xFF20 },
+        { 0xFF3B, 0xFF40 },
+        { 0xFF5B, 0xFF65 },
+        // Specials, including the replacement character.
+        { 0xFFF0, 0xFFFF },
+    };
+    if ( codepoint < 0x80 || codepoint > 0x10FFFF ) {
+        return false;
+    }
+    return std::none_of( std::begin( NOT_LETTERS ), std::end( NOT_LETTERS ),
+                         [ & ]( Range range ) {
+                             return range.first <= codepoint && codepoint <= range.last;
+                         } );
+}
+
 static bool
 isValidIdentStart( int codepoint ) {
-    return std::isalpha( codepoint );
+    return isNonAsciiLetter( codepoint ) ||
+           ( codepoint >= 0 && codepoint < 0x80 && std::isalpha( codepoint ) );
 }
 
 static bool
 isValidIdentContinuation( int codepoint ) {
-    return std::isalnum( codepoint );
+    return isNonAsciiLetter( codepoint ) ||
+           ( codepoint >= 0 && codepoint < 0x80 && std::isalnum( codepoint ) );
 }
 
 Token
 Lexer::eatIdent() {
-    t1( &TC, "" );
-    const int initialByteOffset = this->m_currentByteOffset;
-    t9( &TC, "initialByteOffset: %d", initialByteOffset );
+    const SourceOffset initialByteOffset = this->m_currentByteOffset;
+    MYL_T9( &TC, "initialByteOffset: %lld",
+            static_cast< long long >( initialByteOffset ) );
     this->readCodepoint();
     tassert( &TC, isValidIdentStart( this->m_codepoint ), "" );
     do {
@@ -95,12 +378,13 @@ Lexer::eatIdent() {
               isValidIdentContinuation( this->m_codepoint ) );
 
     const auto loc = SourceCodeLocation {
-        initialByteOffset,
-        this->m_currentByteOffset - initialByteOffset
+        initialByteOffset, this->m_currentByteOffset - initialByteOffset
     };
 
-    TokenData data = ( this->symbolInterner->intern(
-        std::string( this->getStringView( loc ) ) ) );
+    bool inserted;
+    TokenData data =
+        this->symbolInterner->intern( this->getStringView( loc ), &inserted );
+    ( inserted ? this->m_internMisses : this->m_internHits ) += 1;
 
     return { TokenKind::IDENT, data, loc };
 }
@@ -115,8 +399,31 @@ testLexEatIdent( Tm42_TestContext * ctx ) {
         const auto token = lexer.eatIdent();
         TM42_TEST_ASSERT( ctx, token.kind == TokenKind::IDENT );
         TM42_TEST_ASSERT( ctx, lexer.getStringView( token.loc ) == "foo" );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 3 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 3 );
+    }
+    { // Non-ASCII
+        auto lexer = Lexer( "h\xC3\xA9llo w\xC3\xB6rld" );
+        const auto token = lexer.eatIdent();
+        TM42_TEST_ASSERT( ctx, lexer.getStringView( token.loc ) == "h\xC3\xA9llo" );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 6 );
+    }
+    { // Unicode whitespace and punctuation end an identifier.
+        const char * const separators[] = {
+            "\xC2\xA0",     // NBSP
+            "\xE2\x80\xA8", // Line separator
+            "\xE3\x80\x80", // Ideographic space
+            "\xE2\x80\x9C", // Left double quotation mark
+            "\xC2\xAB",     // Left-pointing double angle quotation mark
+        };
+        bool allSeparate = true;
+        for ( const auto * separator : separators ) {
+            const auto text = std::string( "a" ) + separator + "b";
+            auto lexer = Lexer( text );
+            const auto token = lexer.eatIdent();
+            allSeparate = allSeparate && token.loc.byteLength() == 1;
+        }
+        TM42_TEST_ASSERT( ctx, allSeparate );
     }
 
     TM42_END_TEST();
@@ -130,13 +437,13 @@ testLexEatIdent( Tm42_TestContext * ctx ) {
 // FLOAT64 := (-)?[0-9]+(.[0-9]*)?
 Token
 Lexer::eatNumber() {
-    const int initialByteOffset = this->m_currentByteOffset;
+    const SourceOffset initialByteOffset = this->m_currentByteOffset;
     bool foundDigit = false;
     TokenKind tokenKind = TokenKind::INT32;
 
     // Parse non-decimal part.
     this->readCodepoint();
-    if ( std::isdigit( this->m_codepoint ) ) {
+    if ( isAsciiDigit( this->m_codepoint ) ) {
         foundDigit = true;
     }
     tassert( &TC, foundDigit || ( this->m_codepoint == '-' ),
@@ -146,7 +453,7 @@ Lexer::eatNumber() {
     do {
         this->advanceReadCodepoint();
         this->readCodepoint();
-        justReadADigit = std::isdigit( this->m_codepoint );
+        justReadADigit = isAsciiDigit( this->m_codepoint );
         foundDigit = foundDigit || justReadADigit;
     } while ( !this->endOfInput() && justReadADigit );
     tassert( &TC, foundDigit, "" );
@@ -157,20 +464,19 @@ Lexer::eatNumber() {
         do {
             this->advanceReadCodepoint();
             this->readCodepoint();
-        } while ( !this->endOfInput() && std::isdigit( this->m_codepoint ) );
+        } while ( !this->endOfInput() && isAsciiDigit( this->m_codepoint ) );
     }
 
     // Compute value, return token.
     TokenData tokenData;
-    int stringLen = this->m_currentByteOffset - initialByteOffset;
+    const SourceOffset stringLen = this->m_currentByteOffset - initialByteOffset;
+    const auto text = std::string( this->m_input.substr( initialByteOffset, stringLen ) );
     if ( tokenKind == TokenKind::FLOAT64 ) {
-        t9( &TC, "Parsing '%s' to a float", m_input.substr( initialByteOffset, stringLen ).c_str() );
-        tokenData = std::stof(
-            this->m_input.substr( initialByteOffset, stringLen ) );
+        MYL_T9( &TC, "Parsing '%s' to a float", text.c_str() );
+        tokenData = std::stof( text );
     } else {
-        t9( &TC, "Parsing '%s' to an int", m_input.substr( initialByteOffset, stringLen ).c_str() );
-        tokenData = std::stoi(
-            this->m_input.substr( initialByteOffset, stringLen ) );
+        MYL_T9( &TC, "Parsing '%s' to an int", text.c_str() );
+        tokenData = std::stoi( text );
     }
 
     return Token {
@@ -191,8 +497,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         const auto token = lexer.eatNumber();
         TM42_TEST_ASSERT( ctx, token.kind == TokenKind::INT32 );
         TM42_TEST_ASSERT( ctx, std::get< I32 >( token.data ) == 123 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 3 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 3 );
     }
 
     { // Negative integer.
@@ -200,8 +506,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         const auto token = lexer.eatNumber();
         TM42_TEST_ASSERT( ctx, token.kind == TokenKind::INT32 );
         TM42_TEST_ASSERT( ctx, std::get< I32 >( token.data ) == -123 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 4 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 4 );
     }
 
     { // Positive float, just decimal.
@@ -211,8 +517,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT(
             ctx,
             std::fabs( std::get< F64 >( token.data ) - 123.0 ) < EPSILON );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 4 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 4 );
     }
 
     { // Negative float, just decimal.
@@ -222,8 +528,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT(
             ctx,
             std::fabs( -123.0 - std::get< F64 >( token.data ) ) < EPSILON );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 5 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 5 );
     }
 
     { // Positive float, with digits after decimal.
@@ -233,8 +539,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT(
             ctx,
             std::fabs( std::get< F64 >( token.data ) - 123.56 ) < EPSILON );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 6 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 6 );
     }
 
     { // Negative float, with digits after decimal.
@@ -244,8 +550,8 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT(
             ctx,
             std::fabs( -123.56 - std::get< F64 >( token.data ) ) < EPSILON );
-        TM42_TEST_ASSERT( ctx, token.loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, token.loc.byteLength == 7 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, token.loc.byteLength() == 7 );
     }
 
     TM42_END_TEST();
@@ -255,7 +561,7 @@ testLexEatNumber( Tm42_TestContext * ctx ) {
 
 Token
 Lexer::eatToken() {
-    int initialByteOffset = this->m_currentByteOffset;
+    const SourceOffset initialByteOffset = this->m_currentByteOffset;
     Token token;
 
     this->readCodepoint();
@@ -274,8 +580,7 @@ Lexer::eatToken() {
         this->readCodepoint();
         if ( !isValidIdentStart( this->m_codepoint ) ) {
             this->error = true;
-            emitSourceError( this->m_input,
-                             { initialByteOffset, 1 },
+            this->emitError( { initialByteOffset, 1 },
                              "Expected valid identifier after label marker." );
         } else {
             token = this->eatIdent();
@@ -283,12 +588,15 @@ Lexer::eatToken() {
         }
     } else if ( isValidIdentStart( this->m_codepoint ) ) {
         token = this->eatIdent();
-    } else if ( std::isdigit( this->m_codepoint ) ||
+    } else if ( isAsciiDigit( this->m_codepoint ) ||
                 ( this->m_codepoint == '-' ) ) {
         token = this->eatNumber();
+    } else if ( this->m_codepoint == TRUNCATED_CODEPOINT ) {
+        token.loc = SourceCodeLocation { initialByteOffset, this->m_codepointSize };
+        this->emitError( token.loc, "Truncated UTF-8 sequence at end of input" );
+        this->error = true;
     } else {
-        emitSourceError( this->m_input,
-                         SourceCodeLocation { initialByteOffset, 1 },
+        this->emitError( SourceCodeLocation { initialByteOffset, 1 },
                          "Unexpected codepoint" );
         this->error = true;
     }
@@ -298,17 +606,41 @@ Lexer::eatToken() {
 
 Lexer::Result
 Lexer::lex() {
-    std::vector< Token > tokens;
+    const auto start = std::chrono::steady_clock::now();
+    const SourceOffset beginByteOffset = this->m_currentByteOffset;
+    Metrics::LocalHistogram tokenLengths;
+
+    TokenBuffer tokens;
     while ( !this->endOfInput() ) {
         this->eatWhitespace();
         if ( this->endOfInput() ) {
             break;
         }
-        tokens.push_back( this->eatToken() );
+        auto token = this->eatToken();
+        tokenLengths.record( token.loc.byteLength() );
+        token.loc = token.loc.shifted( this->m_baseOffset );
+        tokens.push( token );
         if ( this->error ) {
             break;
         }
     }
+
+    // Published once per call, so the loop above touches no shared state.
+    const auto nanos = std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now() - start ).count();
+    Metrics::add( Metrics::Counter::LEXED_BYTES,
+                  this->m_currentByteOffset - beginByteOffset );
+    Metrics::add( Metrics::Counter::TOKENS, tokens.size() );
+    Metrics::add( Metrics::Counter::TOKEN_BUFFER_BYTES, tokens.bytesUsed() );
+    Metrics::add( Metrics::Counter::LEX_ERRORS, this->error );
+    Metrics::add( Metrics::Counter::LEX_NANOS, nanos );
+    Metrics::add( Metrics::Counter::INTERN_HITS, this->m_internHits );
+    Metrics::add( Metrics::Counter::INTERN_MISSES, this->m_internMisses );
+    Metrics::merge( Metrics::Histogram::TOKEN_LENGTH, tokenLengths );
+    Metrics::record( Metrics::Histogram::LEX_CALL_NANOS, nanos );
+    this->m_internHits = 0;
+    this->m_internMisses = 0;
+
     return { std::move( tokens ), this->error };
 }
 
@@ -340,35 +672,62 @@ testLexLex( Tm42_TestContext * ctx ) {
         const auto tokens = lexResult.tokens;
 
         TM42_TEST_ASSERT( ctx, tokens[ 0 ].kind == TokenKind::LPAREN );
-        TM42_TEST_ASSERT( ctx, tokens[ 0 ].loc.byteOffset == 0 );
-        TM42_TEST_ASSERT( ctx, tokens[ 0 ].loc.byteLength == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 0 ].loc.byteOffset() == 0 );
+        TM42_TEST_ASSERT( ctx, tokens[ 0 ].loc.byteLength() == 1 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 1 ].kind == TokenKind::IDENT );
         TM42_TEST_ASSERT( ctx, lexer.getStringView( tokens[ 1 ].loc ) == "defun" );
-        TM42_TEST_ASSERT( ctx, tokens[ 1 ].loc.byteOffset == 1 );
-        TM42_TEST_ASSERT( ctx, tokens[ 1 ].loc.byteLength == 5 );
+        TM42_TEST_ASSERT( ctx, tokens[ 1 ].loc.byteOffset() == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 1 ].loc.byteLength() == 5 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 2 ].kind == TokenKind::IDENT );
         TM42_TEST_ASSERT( ctx, lexer.getStringView( tokens[ 2 ].loc ) == "foo" );
-        TM42_TEST_ASSERT( ctx, tokens[ 2 ].loc.byteOffset == 7 );
-        TM42_TEST_ASSERT( ctx, tokens[ 2 ].loc.byteLength == 3 );
+        TM42_TEST_ASSERT( ctx, tokens[ 2 ].loc.byteOffset() == 7 );
+        TM42_TEST_ASSERT( ctx, tokens[ 2 ].loc.byteLength() == 3 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 3 ].kind == TokenKind::LPAREN );
-        TM42_TEST_ASSERT( ctx, tokens[ 3 ].loc.byteOffset == 11 );
-        TM42_TEST_ASSERT( ctx, tokens[ 3 ].loc.byteLength == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 3 ].loc.byteOffset() == 11 );
+        TM42_TEST_ASSERT( ctx, tokens[ 3 ].loc.byteLength() == 1 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 4 ].kind == TokenKind::RPAREN );
-        TM42_TEST_ASSERT( ctx, tokens[ 4 ].loc.byteOffset == 12 );
-        TM42_TEST_ASSERT( ctx, tokens[ 4 ].loc.byteLength == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 4 ].loc.byteOffset() == 12 );
+        TM42_TEST_ASSERT( ctx, tokens[ 4 ].loc.byteLength() == 1 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 5 ].kind == TokenKind::INT32 );
         TM42_TEST_ASSERT( ctx, std::get< I32 >( tokens[ 5 ].data ) == 2 );
-        TM42_TEST_ASSERT( ctx, tokens[ 5 ].loc.byteOffset == 14 );
-        TM42_TEST_ASSERT( ctx, tokens[ 5 ].loc.byteLength == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 5 ].loc.byteOffset() == 14 );
+        TM42_TEST_ASSERT( ctx, tokens[ 5 ].loc.byteLength() == 1 );
 
         TM42_TEST_ASSERT( ctx, tokens[ 6 ].kind == TokenKind::RPAREN );
-        TM42_TEST_ASSERT( ctx, tokens[ 6 ].loc.byteOffset == 15 );
-        TM42_TEST_ASSERT( ctx, tokens[ 6 ].loc.byteLength == 1 );
+        TM42_TEST_ASSERT( ctx, tokens[ 6 ].loc.byteOffset() == 15 );
+        TM42_TEST_ASSERT( ctx, tokens[ 6 ].loc.byteLength() == 1 );
+    }
+    { // Letters in any script are identifiers, but Unicode whitespace is not
+      // whitespace to Myl.
+        auto lexer = Lexer( "(\xCE\xBB x\xE2\x82\x81 \xE5\xA4\x89\xE6\x95\xB0)" );
+        const auto lexResult = lexer.lex();
+        TM42_TEST_ASSERT( ctx, !lexResult.error );
+        TM42_TEST_ASSERT( ctx, lexResult.tokens.size() == 5 );
+
+        std::ostringstream errors;
+        auto * const oldCerr = std::cerr.rdbuf( errors.rdbuf() );
+        auto nbsp = Lexer( "(a\xC2\xA0" "b)" );
+        const auto nbspResult = nbsp.lex();
+        std::cerr.rdbuf( oldCerr );
+        TM42_TEST_ASSERT( ctx, nbspResult.error );
+        TM42_TEST_ASSERT( ctx, errors.str().find( "Unexpected codepoint" ) !=
+                                   std::string::npos );
+    }
+    { // A multi-byte sequence cut off by the end of the input is an error, and is
+      // not read past the end.
+        const char text[] = "(foo \xE6\xBC\xA2)";
+        auto lexer = Lexer( std::string_view( text, 7 ) );
+        const auto lexResult = lexer.lex();
+        TM42_TEST_ASSERT( ctx, lexResult.error );
+        TM42_TEST_ASSERT( ctx, lexer.m_currentByteOffset <= 7 );
+        TM42_TEST_ASSERT( ctx, lexResult.tokens.size() == 3 );
+        TM42_TEST_ASSERT( ctx, lexResult.tokens[ 2 ].loc.byteOffset() == 5 );
+        TM42_TEST_ASSERT( ctx, lexResult.tokens[ 2 ].loc.byteLength() == 2 );
     }
 
     TM42_END_TEST();
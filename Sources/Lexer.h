@@ -1,23 +1,30 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 #include "Error.h"
 #include "Intern.h"
+#include "LineIndex.h"
+#include "SourceManager.h"
 
 using I32 = std::int32_t;
 using F64 = double;
 
-enum class TokenKind {
+enum class TokenKind : std::uint8_t {
     LPAREN,
     RPAREN,
     IDENT,
     INT32,
     FLOAT64,
     LABEL,
+    // Not produced by the lexer; marks the end of the token stream for consumers.
+    END,
 };
 
 const char * tokenKindStr( TokenKind tk );
@@ -30,21 +37,81 @@ struct Token {
     SourceCodeLocation loc;
 };
 
+// Compact, structure-of-arrays storage for a token stream. A `Token` is 32 bytes
+// with padding; here each token costs 11 bytes:
+// - a 1-byte kind,
+// - a 4-byte start offset (the high bits of offsets past 4GiB go in a side table),
+// - a 2-byte length (longer tokens spill into a side table),
+// - a 4-byte payload: the interned symbol, the I32 value, or for FLOAT64 an index
+//   into a side table of 64-bit values.
+class TokenBuffer {
+public:
+    void push( const Token & token );
+    void reserve( size_t count );
+    size_t size() const { return m_kinds.size(); }
+
+    TokenKind kind( size_t idx ) const { return m_kinds[ idx ]; }
+    InternedSymbol symbol( size_t idx ) const { return m_payloads[ idx ]; }
+    I32 int32( size_t idx ) const { return static_cast< I32 >( m_payloads[ idx ] ); }
+    F64 float64( size_t idx ) const { return m_wides[ m_payloads[ idx ] ]; }
+    SourceCodeLocation loc( size_t idx ) const;
+
+    // Unpack a single token. Prefer the accessors above on hot paths.
+    Token operator[]( size_t idx ) const;
+
+    // Bytes of token storage in use (not counting spare capacity).
+    size_t bytesUsed() const;
+
+private:
+    static constexpr std::uint16_t LONG_LENGTH = 0xFFFF;
+
+    std::vector< TokenKind > m_kinds;
+    std::vector< std::uint32_t > m_offsets;
+    std::vector< std::uint16_t > m_lengths;
+    std::vector< std::uint32_t > m_payloads;
+    std::vector< F64 > m_wides;
+    // ( token index, length ) for tokens of length >= LONG_LENGTH, sorted by index.
+    std::vector< std::pair< std::uint32_t, std::uint32_t > > m_longLengths;
+    // ( token index, high 32 bits of its offset ) for each token whose high bits
+    // differ from the previous token's, sorted by index. Empty below 4GiB.
+    std::vector< std::pair< std::uint32_t, std::uint32_t > > m_offsetHighs;
+};
+
 class Lexer {
  public:
     struct Result {
-        std::vector< Token > tokens;
+        TokenBuffer tokens;
         bool error;
     };
 
-    Lexer( const std::string & input );
+    // Interns symbols into `SymbolInterner::global()`.
+    Lexer( std::string_view input );
+    // Lex with a caller-provided interner, e.g. to keep a symbol space private.
+    Lexer( std::string_view input, std::shared_ptr< SymbolInterner > symbolInterner );
+    // Lex only `input[ beginByteOffset: ]`. Locations are still relative to the start
+    // of `input`, so several lexers can share one source.
+    Lexer( std::string_view input, SourceOffset beginByteOffset,
+           std::shared_ptr< SymbolInterner > symbolInterner );
+    // Lex a file straight out of `sources`, without copying it. Locations in the
+    // result are global (see `SourceManager`), and diagnostics name the file.
+    Lexer( const SourceManager & sources, SourceManager::FileId file,
+           std::shared_ptr< SymbolInterner > symbolInterner =
+               SymbolInterner::global() );
     Result lex();
 
   std::string_view getStringView( SourceCodeLocation loc );
+  // Line index of the input, built on first use (normally the first error).
+  const LineIndex & lineIndex();
+  // `loc` is relative to `m_input`.
+  void emitError( SourceCodeLocation loc, const std::string & msg );
 
   // Detect if we are at the end of the input.
   bool endOfInput();
-  // Sets codepoint and codepointSize. Does not advance byte offset.
+  // Sets codepoint and codepointSize. Does not advance byte offset. At the end of
+  // the input both are set to 0, so we never read past the end of `m_input`. A
+  // multi-byte sequence cut off by the end of the input (e.g. of a chunk) is not
+  // decoded: the codepoint is `TRUNCATED_CODEPOINT`, and its size covers the bytes
+  // that are left.
   void readCodepoint();
   // Advance input to the next codepoint, based on the previous codepoint size
   // computed by `readCodepoint()`.
@@ -55,7 +122,8 @@ class Lexer {
   // Afterwards, currentByteOffset will point to just after the end of the
   // identifier.
   //
-  // TOKEN := [:al][:alnum]*
+  // TOKEN := [:al][:alnum]*, where non-ASCII codepoints other than controls,
+  // whitespace and punctuation count as [:al]
   Token eatIdent();
   // Assumes `currentByteOffset` points the the first byte of the number.
   // Leaves it pointing to right after the number
@@ -65,10 +133,18 @@ class Lexer {
   Token eatNumber();
   Token eatToken();
 
-  const std::string & m_input;
-  int m_currentByteOffset = 0;
+  std::string_view m_input;
+  SourceOffset m_currentByteOffset = 0;
+  static constexpr int TRUNCATED_CODEPOINT = -1;
   int m_codepoint = 0;
   int m_codepointSize = 0;
     bool error = false;
     std::shared_ptr< SymbolInterner > symbolInterner;
+    std::optional< LineIndex > m_lineIndex;
+    // Set when lexing out of a `SourceManager`.
+    const SourceManager * m_sources = nullptr;
+    SourceOffset m_baseOffset = 0;
+    // Interner lookups since the last `lex()` published its metrics.
+    size_t m_internHits = 0;
+    size_t m_internMisses = 0;
 };
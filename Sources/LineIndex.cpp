@@ -0,0 +1,166 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+#ifdef MYL_TEST
+#include <string>
+#include <Test/Test.h>
+#endif
+
+#include "LineIndex.h"
+
+// Append the offset after every '\n' in `source[ begin:end ]` to `lineStarts`.
+static void
+scanNewlinesScalar( std::string_view source, size_t begin, size_t end,
+                    std::vector< std::uint64_t > & lineStarts ) {
+    for ( size_t i = begin; i < end; ++i ) {
+        if ( source[ i ] == '\n' ) {
+            lineStarts.push_back( static_cast< std::uint64_t >( i + 1 ) );
+        }
+    }
+}
+
+static void
+scanNewlines( std::string_view source, std::vector< std::uint64_t > & lineStarts ) {
+    const char * data = source.data();
+    const size_t size = source.size();
+    size_t i = 0;
+
+#if defined( __SSE2__ )
+    const __m128i newline = _mm_set1_epi8( '\n' );
+    for ( ; i + 16 <= size; i += 16 ) {
+        const __m128i block =
+            _mm_loadu_si128( reinterpret_cast< const __m128i * >( data + i ) );
+        unsigned mask = _mm_movemask_epi8( _mm_cmpeq_epi8( block, newline ) );
+        while ( mask ) {
+            const unsigned bit = __builtin_ctz( mask );
+            lineStarts.push_back( static_cast< std::uint64_t >( i + bit + 1 ) );
+            mask &= mask - 1;
+        }
+    }
+#elif defined( __ARM_NEON )
+    const uint8x16_t newline = vdupq_n_u8( '\n' );
+    for ( ; i + 16 <= size; i += 16 ) {
+        const uint8x16_t block =
+            vld1q_u8( reinterpret_cast< const std::uint8_t * >( data + i ) );
+        const uint8x16_t matches = vceqq_u8( block, newline );
+        // Narrow to 4 bits per byte, since NEON has no movemask.
+        std::uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( matches ), 4 ) ),
+            0 );
+        while ( mask ) {
+            const unsigned bit = __builtin_ctzll( mask ) >> 2;
+            lineStarts.push_back( static_cast< std::uint64_t >( i + bit + 1 ) );
+            mask &= ~( std::uint64_t( 0xF ) << ( bit * 4 ) );
+        }
+    }
+#endif
+
+    scanNewlinesScalar( source, i, size, lineStarts );
+}
+
+LineIndex::LineIndex( std::string_view source, int tabWidth )
+    : m_source( source ), m_tabWidth( tabWidth > 0 ? tabWidth : 1 ) {
+    this->m_lineStarts.push_back( 0 );
+    scanNewlines( source, this->m_lineStarts );
+}
+
+int
+LineIndex::advanceColumn( size_t lineStart, size_t byteOffset, int column ) const {
+    byteOffset = std::min( byteOffset, this->m_source.size() );
+    for ( size_t i = lineStart; i < byteOffset; ++i ) {
+        const auto byte = static_cast< unsigned char >( this->m_source[ i ] );
+        if ( byte == '\t' ) {
+            column += this->m_tabWidth - ( column % this->m_tabWidth );
+        } else if ( ( byte & 0xC0 ) != 0x80 ) {
+            // Count lead bytes only, so each codepoint is one column.
+            column += 1;
+        }
+    }
+    return column;
+}
+
+LineIndex::Position
+LineIndex::position( size_t byteOffset ) const {
+    // Last line starting at or before `byteOffset`.
+    const auto it = std::upper_bound( this->m_lineStarts.begin(),
+                                      this->m_lineStarts.end(), byteOffset );
+    const size_t lineIdx = ( it - this->m_lineStarts.begin() ) - 1;
+    const size_t lineStart = this->m_lineStarts[ lineIdx ];
+    return { static_cast< int >( lineIdx + 1 ),
+             this->advanceColumn( lineStart, byteOffset ),
+             static_cast< int >( byteOffset - lineStart ) };
+}
+
+std::string_view
+LineIndex::lineText( int line ) const {
+    const size_t begin = this->m_lineStarts[ line - 1 ];
+    size_t end = ( line < this->lineCount() ) ? this->m_lineStarts[ line ] - 1
+                                              : this->m_source.size();
+    if ( end > begin && this->m_source[ end - 1 ] == '\r' ) {
+        end -= 1;
+    }
+    return this->m_source.substr( begin, end - begin );
+}
+
+#ifdef MYL_TEST
+void
+testLineIndex( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Line index" );
+
+    { // Lines and byte columns.
+        const std::string_view src = "ab\ncd\n\nefg";
+        const auto index = LineIndex( src );
+        TM42_TEST_ASSERT( ctx, index.lineCount() == 4 );
+        TM42_TEST_ASSERT( ctx, index.position( 0 ).line == 1 );
+        TM42_TEST_ASSERT( ctx, index.position( 2 ).column == 2 );
+        TM42_TEST_ASSERT( ctx, index.position( 3 ).line == 2 );
+        TM42_TEST_ASSERT( ctx, index.position( 3 ).column == 0 );
+        TM42_TEST_ASSERT( ctx, index.position( 6 ).line == 3 );
+        TM42_TEST_ASSERT( ctx, index.position( 9 ).line == 4 );
+        TM42_TEST_ASSERT( ctx, index.position( 9 ).column == 2 );
+        TM42_TEST_ASSERT( ctx, index.lineText( 2 ) == "cd" );
+        TM42_TEST_ASSERT( ctx, index.lineText( 3 ) == "" );
+        TM42_TEST_ASSERT( ctx, index.lineText( 4 ) == "efg" );
+    }
+    { // Codepoints and tabs.
+        const std::string_view src = "\xC3\xA9t\xE2\x82\xAC x\n\tab\tc";
+        const auto index = LineIndex( src, 4 );
+        // "é" is two bytes, "€" is three.
+        TM42_TEST_ASSERT( ctx, index.position( 7 ).column == 4 );
+        TM42_TEST_ASSERT( ctx, index.position( 7 ).byteColumn == 7 );
+        TM42_TEST_ASSERT( ctx, index.position( 10 ).column == 4 );
+        TM42_TEST_ASSERT( ctx, index.position( 13 ).column == 8 );
+    }
+    { // Newlines at every position in and across SIMD blocks.
+        std::string src;
+        for ( int i = 0; i < 1000; ++i ) {
+            src += std::string( i % 37, 'x' ) + "\n";
+        }
+        const auto index = LineIndex( src );
+        TM42_TEST_ASSERT( ctx, index.lineCount() == 1001 );
+        bool allMatch = true;
+        int line = 1;
+        int column = 0;
+        for ( size_t i = 0; i < src.size(); ++i ) {
+            const auto position = index.position( i );
+            allMatch = allMatch && position.line == line && position.column == column;
+            if ( src[ i ] == '\n' ) {
+                line += 1;
+                column = 0;
+            } else {
+                column += 1;
+            }
+        }
+        TM42_TEST_ASSERT( ctx, allMatch );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
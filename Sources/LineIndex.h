@@ -0,0 +1,42 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Maps byte offsets in a source to lines and columns. Line starts are found once, up
+// front (with SIMD where available), after which each lookup is a binary search
+// plus a scan of the bytes on that line before the offset.
+//
+// The index refers to, but does not own, the source.
+class LineIndex {
+public:
+    static constexpr int DEFAULT_TAB_WIDTH = 8;
+
+    struct Position {
+        // 1-based.
+        int line;
+        // 0-based display column: UTF-8 codepoints, with tabs advancing to the next
+        // multiple of the tab width.
+        int column;
+        // 0-based byte offset from the start of the line.
+        int byteColumn;
+    };
+
+    explicit LineIndex( std::string_view source, int tabWidth = DEFAULT_TAB_WIDTH );
+
+    Position position( size_t byteOffset ) const;
+    int lineCount() const { return static_cast< int >( m_lineStarts.size() ); }
+    // `line` is 1-based. Does not include the line terminator.
+    std::string_view lineText( int line ) const;
+    // Display width of `source[ lineStart: byteOffset ]`, given `column` so far.
+    int advanceColumn( size_t lineStart, size_t byteOffset, int column = 0 ) const;
+
+private:
+    std::string_view m_source;
+    int m_tabWidth;
+    // Byte offset at which each line begins; the first is always 0.
+    std::vector< std::uint64_t > m_lineStarts;
+};
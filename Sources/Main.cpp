@@ -1,7 +1,9 @@
 
 #include <Tracing/Tracing.h>
 
+#include "Batch.h"
 #include "Lexer.h"
+#include "Metrics.h"
 #include "Parser.h"
 #include "Repl.h"
 
@@ -12,6 +14,9 @@ struct TraceContext TC;
 #include <Test/Test.h>
 
 extern void testSymbolInterner( Tm42_TestContext * ctx );
+extern void testSourceCodeLocation( Tm42_TestContext * ctx );
+
+extern void testTokenBuffer( Tm42_TestContext * ctx );
 
 extern void testLexEatIdent( Tm42_TestContext * ctx );
 extern void testLexEatNumber( Tm42_TestContext * ctx );
@@ -20,6 +25,20 @@ extern void testLexLex( Tm42_TestContext * ctx );
 
 extern void testParseCons( Tm42_TestContext * ctx );
 extern void testParseProc( Tm42_TestContext * ctx );
+extern void testParseProcMode( Tm42_TestContext * ctx );
+extern void testParseEvents( Tm42_TestContext * ctx );
+extern void testParseTopLevel( Tm42_TestContext * ctx );
+extern void testParseDeepNesting( Tm42_TestContext * ctx );
+
+extern void testFormScanner( Tm42_TestContext * ctx );
+extern void testStreamParser( Tm42_TestContext * ctx );
+extern void testParallelParser( Tm42_TestContext * ctx );
+extern void testIncrementalReparse( Tm42_TestContext * ctx );
+extern void testLineIndex( Tm42_TestContext * ctx );
+extern void testSourceManager( Tm42_TestContext * ctx );
+extern void testBatch( Tm42_TestContext * ctx );
+extern void testAstCache( Tm42_TestContext * ctx );
+extern void testMetrics( Tm42_TestContext * ctx );
 
 int
 main() {
@@ -29,6 +48,9 @@ main() {
     Tm42_TestContext ctx;
 
     testSymbolInterner( &ctx );
+    testSourceCodeLocation( &ctx );
+
+    testTokenBuffer( &ctx );
 
     testLexEatIdent( &ctx );
     testLexEatNumber( &ctx );
@@ -37,14 +59,43 @@ main() {
 
     testParseCons( &ctx );
     testParseProc( &ctx );
+    testParseProcMode( &ctx );
+    testParseEvents( &ctx );
+    testParseTopLevel( &ctx );
+    testParseDeepNesting( &ctx );
+
+    testFormScanner( &ctx );
+    testStreamParser( &ctx );
+    testParallelParser( &ctx );
+    testIncrementalReparse( &ctx );
+    testLineIndex( &ctx );
+    testSourceManager( &ctx );
+    testBatch( &ctx );
+    testAstCache( &ctx );
+    testMetrics( &ctx );
 }
 
 #else // MYL_TEST
 
 int
-main() {
+main( int argc, char ** argv ) {
   init_tracing( &TC, stdout, "Main" );
   t0( &TC, "Tracing initialized." );
+  Metrics::dumpAtExitIfRequested();
+
+  bool usageError;
+  const auto batchOptions = parseBatchArgs( argc, argv, &usageError );
+  if ( usageError ) {
+      std::cerr << "usage: " << argv[ 0 ] << " [--stats] [--cache DIR] file...\n";
+      deinit_tracing( &TC );
+      return 2;
+  }
+  if ( batchOptions ) {
+      std::ios::sync_with_stdio( false );
+      const int status = runBatch( *batchOptions, std::cout, std::cerr );
+      deinit_tracing( &TC );
+      return status;
+  }
 
   while ( true ) {
       auto input = getInputBasicRepl();
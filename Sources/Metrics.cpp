@@ -0,0 +1,239 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <atomic>
+#include <cstdlib>
+
+#ifdef MYL_TEST
+#include <sstream>
+#include <Test/Test.h>
+
+#include "Parser.h"
+#endif
+
+#include "Metrics.h"
+
+namespace Metrics {
+
+namespace {
+
+constexpr int COUNTER_COUNT = static_cast< int >( Counter::COUNT );
+constexpr int HISTOGRAM_COUNT = static_cast< int >( Histogram::COUNT );
+
+// Own cache line each, so threads bumping different counters don't contend.
+struct alignas( 64 ) AtomicCounter {
+    std::atomic< std::uint64_t > value{ 0 };
+};
+
+struct alignas( 64 ) AtomicHistogram {
+    std::atomic< std::uint64_t > count{ 0 };
+    std::atomic< std::uint64_t > sum{ 0 };
+    std::atomic< std::uint64_t > max{ 0 };
+    std::atomic< std::uint64_t > buckets[ BUCKET_COUNT ] = {};
+};
+
+AtomicCounter COUNTERS[ COUNTER_COUNT ];
+AtomicHistogram HISTOGRAMS[ HISTOGRAM_COUNT ];
+
+const char * const COUNTER_NAMES[ COUNTER_COUNT ] = {
+    "lex.bytes",          "lex.tokens",         "lex.token_buffer_bytes",
+    "lex.errors",         "lex.nanos",          "intern.hits",
+    "intern.misses",      "intern.arena_bytes", "parse.forms",
+    "parse.nodes",        "parse.ast_bytes",    "parse.errors",
+    "parse.nanos",
+};
+
+const char * const HISTOGRAM_NAMES[ HISTOGRAM_COUNT ] = {
+    "lex.token_length",
+    "parse.form_nodes",
+    "lex.call_nanos",
+    "parse.call_nanos",
+};
+
+void
+raiseMax( std::atomic< std::uint64_t > & max, std::uint64_t value ) {
+    std::uint64_t current = max.load( std::memory_order_relaxed );
+    while ( value > current &&
+            !max.compare_exchange_weak( current, value, std::memory_order_relaxed ) ) {
+    }
+}
+
+void
+dumpAtExit() {
+    dump( std::cerr );
+}
+
+} // namespace
+
+std::uint64_t
+HistogramSnapshot::percentile( double p ) const {
+    if ( this->count == 0 ) {
+        return 0;
+    }
+    const auto rank = static_cast< std::uint64_t >( p * ( this->count - 1 ) );
+    std::uint64_t seen = 0;
+    for ( int i = 0; i < BUCKET_COUNT; ++i ) {
+        seen += this->buckets[ i ];
+        if ( seen > rank ) {
+            const std::uint64_t upper = i == 0 ? 0
+                : i == 64 ? UINT64_MAX
+                          : ( std::uint64_t( 1 ) << i ) - 1;
+            return upper < this->max ? upper : this->max;
+        }
+    }
+    return this->max;
+}
+
+void
+add( Counter counter, std::uint64_t n ) {
+    COUNTERS[ static_cast< int >( counter ) ].value.fetch_add(
+        n, std::memory_order_relaxed );
+}
+
+void
+record( Histogram histogram, std::uint64_t value ) {
+    LocalHistogram local;
+    local.record( value );
+    merge( histogram, local );
+}
+
+void
+merge( Histogram histogram, const LocalHistogram & local ) {
+    if ( local.count == 0 ) {
+        return;
+    }
+    auto & h = HISTOGRAMS[ static_cast< int >( histogram ) ];
+    h.count.fetch_add( local.count, std::memory_order_relaxed );
+    h.sum.fetch_add( local.sum, std::memory_order_relaxed );
+    raiseMax( h.max, local.max );
+    for ( int i = 0; i < BUCKET_COUNT; ++i ) {
+        if ( local.buckets[ i ] ) {
+            h.buckets[ i ].fetch_add( local.buckets[ i ], std::memory_order_relaxed );
+        }
+    }
+}
+
+std::uint64_t
+read( Counter counter ) {
+    return COUNTERS[ static_cast< int >( counter ) ].value.load(
+        std::memory_order_relaxed );
+}
+
+HistogramSnapshot
+read( Histogram histogram ) {
+    const auto & h = HISTOGRAMS[ static_cast< int >( histogram ) ];
+    HistogramSnapshot snapshot;
+    snapshot.count = h.count.load( std::memory_order_relaxed );
+    snapshot.sum = h.sum.load( std::memory_order_relaxed );
+    snapshot.max = h.max.load( std::memory_order_relaxed );
+    for ( int i = 0; i < BUCKET_COUNT; ++i ) {
+        snapshot.buckets[ i ] = h.buckets[ i ].load( std::memory_order_relaxed );
+    }
+    return snapshot;
+}
+
+const char *
+name( Counter counter ) {
+    return COUNTER_NAMES[ static_cast< int >( counter ) ];
+}
+
+const char *
+name( Histogram histogram ) {
+    return HISTOGRAM_NAMES[ static_cast< int >( histogram ) ];
+}
+
+void
+reset() {
+    for ( auto & counter : COUNTERS ) {
+        counter.value.store( 0, std::memory_order_relaxed );
+    }
+    for ( auto & h : HISTOGRAMS ) {
+        h.count.store( 0, std::memory_order_relaxed );
+        h.sum.store( 0, std::memory_order_relaxed );
+        h.max.store( 0, std::memory_order_relaxed );
+        for ( auto & bucket : h.buckets ) {
+            bucket.store( 0, std::memory_order_relaxed );
+        }
+    }
+}
+
+void
+dump( std::ostream & os ) {
+    for ( int i = 0; i < COUNTER_COUNT; ++i ) {
+        os << COUNTER_NAMES[ i ] << " " << read( static_cast< Counter >( i ) ) << "\n";
+    }
+    for ( int i = 0; i < HISTOGRAM_COUNT; ++i ) {
+        const auto h = read( static_cast< Histogram >( i ) );
+        os << HISTOGRAM_NAMES[ i ] << " count " << h.count << " mean "
+           << ( h.count ? h.sum / h.count : 0 ) << " p50 " << h.percentile( 0.5 )
+           << " p99 " << h.percentile( 0.99 ) << " max " << h.max << "\n";
+    }
+}
+
+void
+dumpAtExitIfRequested() {
+    if ( std::getenv( "MYL_METRICS" ) ) {
+        std::atexit( dumpAtExit );
+    }
+}
+
+} // namespace Metrics
+
+#ifdef MYL_TEST
+void
+testMetrics( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Metrics" );
+
+    Metrics::reset();
+    { // Counters.
+        Metrics::add( Metrics::Counter::TOKENS );
+        Metrics::add( Metrics::Counter::TOKENS, 41 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::TOKENS ) == 42 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::LEXED_BYTES ) == 0 );
+    }
+    { // Histograms.
+        Metrics::LocalHistogram local;
+        for ( std::uint64_t v = 0; v < 100; ++v ) {
+            local.record( v );
+        }
+        Metrics::merge( Metrics::Histogram::TOKEN_LENGTH, local );
+        Metrics::record( Metrics::Histogram::TOKEN_LENGTH, 1000 );
+        const auto h = Metrics::read( Metrics::Histogram::TOKEN_LENGTH );
+        TM42_TEST_ASSERT( ctx, h.count == 101 );
+        TM42_TEST_ASSERT( ctx, h.sum == 4950 + 1000 );
+        TM42_TEST_ASSERT( ctx, h.max == 1000 );
+        TM42_TEST_ASSERT( ctx, h.buckets[ 0 ] == 1 );
+        TM42_TEST_ASSERT( ctx, h.buckets[ 1 ] == 1 );
+        TM42_TEST_ASSERT( ctx, h.buckets[ 7 ] == 36 );
+        // 49 is in the 32-63 bucket.
+        TM42_TEST_ASSERT( ctx, h.percentile( 0.5 ) == 63 );
+        TM42_TEST_ASSERT( ctx, h.percentile( 1.0 ) == 1000 );
+    }
+    { // Dump and reset.
+        std::ostringstream os;
+        Metrics::dump( os );
+        TM42_TEST_ASSERT( ctx, os.str().find( "lex.tokens 42\n" ) != std::string::npos );
+        Metrics::reset();
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::TOKENS ) == 0 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Histogram::TOKEN_LENGTH ).count == 0 );
+    }
+    { // The front end reports what it did.
+        const std::string_view src = "(a a bb) 7";
+        auto lexer = Lexer( src, std::make_shared< SymbolInterner >() );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        parser.parse();
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::LEXED_BYTES ) == src.size() );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::TOKENS ) == 6 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::INTERN_HITS ) == 1 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::INTERN_MISSES ) == 2 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::PARSED_FORMS ) == 2 );
+        // Three conses and three symbols, then an int.
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Counter::PARSED_NODES ) == 7 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Histogram::FORM_NODES ).max == 6 );
+        TM42_TEST_ASSERT( ctx, Metrics::read( Metrics::Histogram::TOKEN_LENGTH ).max == 2 );
+        Metrics::reset();
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
@@ -0,0 +1,83 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+// Process-wide counters and histograms for the front end.
+//
+// Every update is a relaxed atomic add, so metrics are cheap to keep on and safe
+// from any thread, but a snapshot taken while work is in flight may be torn across
+// metrics. Hot loops should accumulate locally (e.g. in a `LocalHistogram`) and
+// publish once per call.
+namespace Metrics {
+
+enum class Counter : int {
+    LEXED_BYTES,
+    TOKENS,
+    TOKEN_BUFFER_BYTES,
+    LEX_ERRORS,
+    LEX_NANOS,
+    INTERN_HITS,
+    INTERN_MISSES,
+    INTERN_ARENA_BYTES,
+    PARSED_FORMS,
+    PARSED_NODES,
+    AST_BYTES,
+    PARSE_ERRORS,
+    PARSE_NANOS,
+    COUNT,
+};
+
+enum class Histogram : int {
+    // Bytes per token.
+    TOKEN_LENGTH,
+    // Nodes per top-level form.
+    FORM_NODES,
+    // Duration of each `Lexer::lex()` / `Parser::parse()` call.
+    LEX_CALL_NANOS,
+    PARSE_CALL_NANOS,
+    COUNT,
+};
+
+// Bucket i counts values of bit width i: 0, 1, 2-3, 4-7, ...
+constexpr int BUCKET_COUNT = 65;
+
+struct HistogramSnapshot {
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+    std::uint64_t buckets[ BUCKET_COUNT ] = {};
+
+    // Upper bound of the bucket holding the `p`th percentile, `p` in [ 0, 1 ].
+    std::uint64_t percentile( double p ) const;
+};
+
+// Not atomic: for accumulating on one thread, then `merge()`ing.
+struct LocalHistogram : HistogramSnapshot {
+    void
+    record( std::uint64_t value ) {
+        this->count += 1;
+        this->sum += value;
+        this->max = value > this->max ? value : this->max;
+        this->buckets[ value ? 64 - __builtin_clzll( value ) : 0 ] += 1;
+    }
+};
+
+void add( Counter counter, std::uint64_t n = 1 );
+void record( Histogram histogram, std::uint64_t value );
+void merge( Histogram histogram, const LocalHistogram & local );
+
+std::uint64_t read( Counter counter );
+HistogramSnapshot read( Histogram histogram );
+const char * name( Counter counter );
+const char * name( Histogram histogram );
+
+void reset();
+// One metric per line, histograms with count, mean, p50, p99 and max.
+void dump( std::ostream & os );
+// If the MYL_METRICS environment variable is set, dump to stderr at exit.
+void dumpAtExitIfRequested();
+
+} // namespace Metrics
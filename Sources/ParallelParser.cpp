@@ -0,0 +1,238 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <thread>
+
+#ifdef MYL_TEST
+#include <sstream>
+#include <Test/Test.h>
+#endif
+#include <Tracing/Tracing.h>
+
+#include "Lexer.h"
+#include "ParallelParser.h"
+
+extern TraceContext TC;
+
+// Run `work( i )` for every i in [ 0, count ) on up to `threadCount` threads.
+template < typename Work >
+static void
+parallelFor( size_t count, unsigned threadCount, Work work ) {
+    const unsigned workerCount =
+        static_cast< unsigned >( std::min< size_t >( threadCount, count ) );
+    if ( workerCount <= 1 ) {
+        for ( size_t i = 0; i < count; ++i ) {
+            work( i );
+        }
+        return;
+    }
+
+    std::atomic< size_t > next( 0 );
+    std::vector< std::thread > workers;
+    workers.reserve( workerCount );
+    for ( unsigned w = 0; w < workerCount; ++w ) {
+        workers.emplace_back( [ & ]() {
+            for ( size_t i = next++; i < count; i = next++ ) {
+                work( i );
+            }
+        } );
+    }
+    for ( auto & worker : workers ) {
+        worker.join();
+    }
+}
+
+ParallelParser::ParallelParser( std::string_view source, unsigned threadCount,
+                                size_t minChunkSize )
+    : ParallelParser( source, threadCount, minChunkSize, SymbolInterner::global() ) {}
+
+ParallelParser::ParallelParser( std::string_view source, unsigned threadCount,
+                                size_t minChunkSize,
+                                std::shared_ptr< SymbolInterner > symbolInterner )
+    : m_source( source ),
+      m_threadCount( threadCount ? threadCount
+                                 : std::max( 1u, std::thread::hardware_concurrency() ) ),
+      m_minChunkSize( std::max< size_t >( 1, minChunkSize ) ),
+      m_symbolInterner( std::move( symbolInterner ) ) {}
+
+std::vector< size_t >
+ParallelParser::chunkBoundaries() const {
+    const std::string_view src = this->m_source;
+    const size_t size = src.size();
+    // Oversplit a bit, so one slow chunk doesn't hold everyone up.
+    const size_t rangeCount = std::min< size_t >( this->m_threadCount * 4,
+                                                  size / this->m_minChunkSize );
+    if ( rangeCount <= 1 ) {
+        return { 0 };
+    }
+    const auto rangeBegin = [ & ]( size_t r ) { return r * size / rangeCount; };
+
+    // Net paren depth of each range.
+    std::vector< long > depthDeltas( rangeCount );
+    parallelFor( rangeCount, this->m_threadCount, [ & ]( size_t r ) {
+        long delta = 0;
+        for ( size_t i = rangeBegin( r ); i < rangeBegin( r + 1 ); ++i ) {
+            delta += ( src[ i ] == '(' ) - ( src[ i ] == ')' );
+        }
+        depthDeltas[ r ] = delta;
+    } );
+
+    std::vector< long > startDepths( rangeCount, 0 );
+    for ( size_t r = 1; r < rangeCount; ++r ) {
+        startDepths[ r ] = startDepths[ r - 1 ] + depthDeltas[ r - 1 ];
+    }
+
+    // First top-level boundary at or after the start of each range: depth zero, and
+    // not in the middle of an atom. Each scan stops at the end of its range, so one
+    // huge form costs a pass over the source, not one per range; a range with no
+    // boundary keeps `size`, and the next range finds the cut it would have.
+    std::vector< size_t > cuts( rangeCount, size );
+    parallelFor( rangeCount - 1, this->m_threadCount, [ & ]( size_t r ) {
+        r += 1;
+        long depth = startDepths[ r ];
+        for ( size_t i = rangeBegin( r ); i < rangeBegin( r + 1 ); ++i ) {
+            const auto previous = static_cast< unsigned char >( src[ i - 1 ] );
+            if ( depth == 0 && ( previous == ')' || std::isspace( previous ) ) ) {
+                cuts[ r ] = i;
+                return;
+            }
+            depth += ( src[ i ] == '(' ) - ( src[ i ] == ')' );
+        }
+    } );
+
+    std::vector< size_t > boundaries = { 0 };
+    for ( size_t r = 1; r < rangeCount; ++r ) {
+        if ( cuts[ r ] < size && cuts[ r ] > boundaries.back() ) {
+            boundaries.push_back( cuts[ r ] );
+        }
+    }
+    return boundaries;
+}
+
+Parser::Result
+ParallelParser::parse() {
+    const auto boundaries = this->chunkBoundaries();
+    t1( &TC, "Parsing %zu bytes in %zu chunks", this->m_source.size(),
+        boundaries.size() );
+
+    std::vector< Parser::Result > results( boundaries.size() );
+    parallelFor( boundaries.size(), this->m_threadCount, [ & ]( size_t c ) {
+        const size_t end = ( c + 1 < boundaries.size() ) ? boundaries[ c + 1 ]
+                                                         : this->m_source.size();
+        // Lex over a prefix of the source, so locations come out absolute.
+        const auto prefix = this->m_source.substr( 0, end );
+        auto lexer = Lexer( prefix, static_cast< SourceOffset >( boundaries[ c ] ),
+                            this->m_symbolInterner );
+        const auto lexResult = lexer.lex();
+        if ( lexResult.error ) {
+            results[ c ].error = true;
+            return;
+        }
+        auto parser = Parser( prefix, lexResult.tokens );
+        results[ c ] = parser.parse();
+    } );
+
+    size_t total = 0;
+    for ( const auto & result : results ) {
+        total += result.sexprs.size();
+    }
+    Parser::Result merged;
+    merged.sexprs.reserve( total );
+    merged.locs.reserve( total );
+    merged.error = false;
+    for ( auto & result : results ) {
+        for ( auto & sexpr : result.sexprs ) {
+            merged.sexprs.push_back( std::move( sexpr ) );
+        }
+        merged.locs.insert( merged.locs.end(), result.locs.begin(), result.locs.end() );
+        // Like a serial parse, stop at the first error.
+        if ( result.error ) {
+            merged.error = true;
+            break;
+        }
+    }
+    return merged;
+}
+
+#ifdef MYL_TEST
+void
+testParallelParser( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Parallel parsing" );
+
+    std::string src;
+    for ( int i = 0; i < 300; ++i ) {
+        src += "(def f" + std::to_string( i ) + " (add @x " + std::to_string( i ) +
+               " (mul 2.5 y)))\n";
+        if ( i % 7 == 0 ) {
+            src += "atom" + std::to_string( i ) + " ";
+        }
+    }
+
+    const auto print = []( const Parser::Result & result ) {
+        std::ostringstream os;
+        for ( const auto & sexpr : result.sexprs ) {
+            os << *sexpr << "\n";
+        }
+        return os.str();
+    };
+
+    auto lexer = Lexer( src );
+    const auto lexResult = lexer.lex();
+    auto parser = Parser( src, lexResult.tokens );
+    const auto serial = parser.parse();
+    TM42_TEST_ASSERT( ctx, !serial.error );
+
+    { // Many chunks.
+        auto parallel = ParallelParser( src, 4, 64 );
+        const auto boundaries = parallel.chunkBoundaries();
+        TM42_TEST_ASSERT( ctx, boundaries.size() > 1 );
+        bool allAtTopLevel = true;
+        for ( const auto boundary : boundaries ) {
+            allAtTopLevel = allAtTopLevel &&
+                ( boundary == 0 || src[ boundary - 1 ] == '\n' ||
+                  src[ boundary - 1 ] == ' ' || src[ boundary - 1 ] == ')' );
+        }
+        TM42_TEST_ASSERT( ctx, allAtTopLevel );
+
+        const auto result = parallel.parse();
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == serial.sexprs.size() );
+        TM42_TEST_ASSERT( ctx, print( result ) == print( serial ) );
+    }
+    { // Small input stays in one chunk.
+        auto parallel = ParallelParser( src, 4 );
+        TM42_TEST_ASSERT( ctx, parallel.chunkBoundaries().size() == 1 );
+        TM42_TEST_ASSERT( ctx, print( parallel.parse() ) == print( serial ) );
+    }
+    { // One huge form has no cuts inside it; the ranges after it still find theirs.
+        const std::string huge = "(" + src + ")\n(x) (y)";
+        auto parallel = ParallelParser( huge, 4, 64 );
+        const auto boundaries = parallel.chunkBoundaries();
+        TM42_TEST_ASSERT( ctx, boundaries.size() == 2 );
+        TM42_TEST_ASSERT( ctx, boundaries[ 1 ] == src.size() + 2 );
+        const auto result = parallel.parse();
+        TM42_TEST_ASSERT( ctx, !result.error && result.sexprs.size() == 3 );
+    }
+    { // Errors are reported.
+        const std::string bad = src + "(oops";
+        auto parallel = ParallelParser( bad, 4, 64 );
+        TM42_TEST_ASSERT( ctx, parallel.parse().error );
+    }
+    { // And end the result, as in a serial parse.
+        const std::string bad = "(a) )( " + src;
+        auto badLexer = Lexer( bad );
+        const auto badTokens = badLexer.lex().tokens;
+        auto badParser = Parser( bad, badTokens );
+        const auto badSerial = badParser.parse();
+        const auto result = ParallelParser( bad, 4, 64 ).parse();
+        TM42_TEST_ASSERT( ctx, result.error );
+        TM42_TEST_ASSERT( ctx, badSerial.sexprs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, result.locs.size() == result.sexprs.size() );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
@@ -0,0 +1,44 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "Intern.h"
+#include "Parser.h"
+
+// Lexes and parses one large source on several threads.
+//
+// The source is cut into chunks at top-level form boundaries (paren depth zero),
+// found in parallel: each thread first counts the net paren depth of a byte range,
+// a prefix sum gives the depth at the start of each range, and each thread then
+// scans its range for the first boundary. Chunks are lexed and parsed
+// independently over the whole source, so source locations need no fixing up, and
+// the results are concatenated in source order.
+//
+// The result is the same as `Parser::parse()` on the whole source, except that when
+// there are errors, every failing chunk reports its first error.
+class ParallelParser {
+public:
+    // Chunks smaller than this aren't worth a thread.
+    static constexpr size_t DEFAULT_MIN_CHUNK_SIZE = 256 * 1024;
+
+    // `threadCount` 0 means one per hardware thread.
+    ParallelParser( std::string_view source, unsigned threadCount = 0,
+                    size_t minChunkSize = DEFAULT_MIN_CHUNK_SIZE );
+    ParallelParser( std::string_view source, unsigned threadCount, size_t minChunkSize,
+                    std::shared_ptr< SymbolInterner > symbolInterner );
+
+    Parser::Result parse();
+
+    // Byte offsets at which chunks begin; the first is always 0. Exposed for testing.
+    std::vector< size_t > chunkBoundaries() const;
+
+private:
+    std::string_view m_source;
+    unsigned m_threadCount;
+    size_t m_minChunkSize;
+    std::shared_ptr< SymbolInterner > m_symbolInterner;
+};
@@ -1,12 +1,16 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
 
 #ifdef MYL_TEST
+#include <sstream>
 #include <Test/Test.h>
 #endif // MYL_TEST
 #include <Tracing/Tracing.h>
 
+#include "Metrics.h"
 #include "Parser.h"
 
 extern TraceContext TC;
@@ -43,34 +47,126 @@ Label::print( std::ostream & os ) const {
     os << "LABEL<" << this->value << ">";
 }
 
+namespace {
+
+// Prints the tree rooted at `root`. Nested conses and procs are expanded here, with
+// an explicit stack, rather than through their own `print()`. Each entry is a node
+// to print, a parameter label, or (if neither) a string.
 void
-Cons::print( std::ostream & os ) const {
-    os << "(";
-    if ( this->car ) {
-        os << *this->car;
-    } else {
-        os << "NIL";
+printTree( std::ostream & os, const Base & root ) {
+    struct Item {
+        const Base * node;
+        const char * text;
+        const InternedSymbol * label = nullptr;
+    };
+    std::vector< Item > pending = { { &root, nullptr } };
+    const auto pushChild = [ & ]( const std::unique_ptr< Base > & child ) {
+        pending.push_back( child ? Item{ child.get(), nullptr } : Item{ nullptr, "NIL" } );
+    };
+    while ( !pending.empty() ) {
+        const Item item = pending.back();
+        pending.pop_back();
+        if ( item.label ) {
+            os << "@SYM<" << *item.label << "> ";
+        } else if ( !item.node ) {
+            os << item.text;
+        } else if ( const auto * cons = dynamic_cast< const Cons * >( item.node ) ) {
+            os << "(";
+            pending.push_back( { nullptr, ")" } );
+            pushChild( cons->cdr );
+            pending.push_back( { nullptr, " " } );
+            pushChild( cons->car );
+        } else if ( const auto * proc = dynamic_cast< const Proc * >( item.node ) ) {
+            os << "(PROC<" << proc->procSymbol << ">";
+            pending.push_back( { nullptr, ")" } );
+            // Pushed back to front, so they come off the stack in order.
+            for ( auto it = proc->parameters.rbegin(); it != proc->parameters.rend();
+                  ++it ) {
+                pushChild( it->value );
+                if ( it->label ) {
+                    pending.push_back( { nullptr, nullptr, &*it->label } );
+                }
+                pending.push_back( { nullptr, " " } );
+            }
+        } else {
+            os << *item.node;
+        }
     }
-    os << " ";
-    if ( this->cdr ) {
-        os << *this->cdr;
-    } else {
-        os << "NIL";
+}
+
+// Whether `node` still owns other nodes, whose destruction would recurse.
+bool
+hasChildren( const std::unique_ptr< Base > & node ) {
+    if ( const auto * cons = dynamic_cast< const Cons * >( node.get() ) ) {
+        return cons->car || cons->cdr;
+    }
+    if ( const auto * proc = dynamic_cast< const Proc * >( node.get() ) ) {
+        return std::any_of(
+            proc->parameters.begin(), proc->parameters.end(),
+            []( const Proc::Parameter & parameter ) { return bool( parameter.value ); } );
     }
-    os << ")";
+    return false;
 }
 
+// Destroys the nodes in `pending` and everything below them. Every descendant's
+// children are detached before it is destroyed, so each destructor returns early
+// instead of recursing.
 void
-Proc::print( std::ostream & os ) const {
-    os << "(PROC<" << this->procSymbol << ">";
-    for ( const auto & parameter : this->parameters ) {
-        os << " ";
-        if ( parameter.label ) {
-            os << "@SYM<" << *parameter.label << "> ";
+destroyTrees( std::vector< std::unique_ptr< Base > > pending ) {
+    while ( !pending.empty() ) {
+        auto node = std::move( pending.back() );
+        pending.pop_back();
+        if ( auto * cons = dynamic_cast< Cons * >( node.get() ) ) {
+            if ( cons->car ) {
+                pending.push_back( std::move( cons->car ) );
+            }
+            if ( cons->cdr ) {
+                pending.push_back( std::move( cons->cdr ) );
+            }
+        } else if ( auto * proc = dynamic_cast< Proc * >( node.get() ) ) {
+            for ( auto & parameter : proc->parameters ) {
+                if ( parameter.value ) {
+                    pending.push_back( std::move( parameter.value ) );
+                }
+            }
         }
-        os << *parameter.value;
     }
-    os << ")";
+}
+
+} // namespace
+
+void
+Cons::print( std::ostream & os ) const {
+    printTree( os, *this );
+}
+
+Cons::~Cons() {
+    if ( !hasChildren( this->car ) && !hasChildren( this->cdr ) ) {
+        return;
+    }
+    std::vector< std::unique_ptr< Base > > pending;
+    pending.push_back( std::move( this->car ) );
+    pending.push_back( std::move( this->cdr ) );
+    destroyTrees( std::move( pending ) );
+}
+
+void
+Proc::print( std::ostream & os ) const {
+    printTree( os, *this );
+}
+
+Proc::~Proc() {
+    if ( std::none_of( this->parameters.begin(), this->parameters.end(),
+                       [ & ]( const Parameter & parameter ) {
+                           return hasChildren( parameter.value );
+                       } ) ) {
+        return;
+    }
+    std::vector< std::unique_ptr< Base > > pending;
+    for ( auto & parameter : this->parameters ) {
+        pending.push_back( std::move( parameter.value ) );
+    }
+    destroyTrees( std::move( pending ) );
 }
 
 std::ostream &
@@ -79,73 +175,189 @@ operator<<( std::ostream & os, const Base & obj ) {
     return os;
 }
 
+size_t
+countNodes( const Base & root ) {
+    size_t count = 0;
+    std::vector< const Base * > pending = { &root };
+    while ( !pending.empty() ) {
+        const auto * node = pending.back();
+        pending.pop_back();
+        count += 1;
+        if ( const auto * cons = dynamic_cast< const Cons * >( node ) ) {
+            if ( cons->car ) {
+                pending.push_back( cons->car.get() );
+            }
+            if ( cons->cdr ) {
+                pending.push_back( cons->cdr.get() );
+            }
+        } else if ( const auto * proc = dynamic_cast< const Proc * >( node ) ) {
+            for ( const auto & parameter : proc->parameters ) {
+                pending.push_back( parameter.value.get() );
+            }
+        }
+    }
+    return count;
+}
+
 } // namespace SExpr
 
 void
 Parser::expectToken( TokenKind e ) {
-    tassert( &TC, this->m_currentToken.kind == e,
+    tassert( &TC, this->m_currentKind == e,
              "Expected token %s, got %s",
-             tokenKindStr( e ), tokenKindStr( this->m_currentToken.kind ) );
+             tokenKindStr( e ), tokenKindStr( this->m_currentKind ) );
+}
+
+SourceCodeLocation
+Parser::currentLoc() const {
+    if ( this->m_currentKind == TokenKind::END ) {
+        return { this->m_baseOffset + static_cast< SourceOffset >( this->source.size() ),
+                 0 };
+    }
+    return this->m_tokens.loc( this->m_currentTokenIdx );
+}
+
+const LineIndex &
+Parser::lineIndex() {
+    if ( !this->m_lineIndex ) {
+        this->m_lineIndex.emplace( this->source );
+    }
+    return *this->m_lineIndex;
 }
 
-Token *
+void
+Parser::emitError( SourceCodeLocation loc, const std::string & msg ) {
+    if ( this->m_sources ) {
+        this->m_sources->emitError( loc, msg );
+    } else {
+        emitSourceError( this->source, this->lineIndex(), loc, msg );
+    }
+}
+
+bool
 Parser::eatToken() {
     if ( this->m_nextTokenIdx >= this->m_tokens.size() ) {
-        return nullptr;
+        this->m_currentKind = TokenKind::END;
+        return false;
     }
-    this->m_currentToken = this->m_tokens[ this->m_nextTokenIdx ];
+    this->m_currentTokenIdx = this->m_nextTokenIdx;
+    this->m_currentKind = this->m_tokens.kind( this->m_currentTokenIdx );
     this->m_nextTokenIdx += 1;
-    return &this->m_currentToken;
+    return true;
 }
 
 SExpr::Cons
 Parser::parseCons() {
-    this->expectToken( TokenKind::LPAREN );
-    this->eatToken();
-
-    SExpr::Cons cons;
+    const bool procMode = this->m_procMode;
+    this->m_procMode = false;
+    auto list = this->parseList();
+    this->m_procMode = procMode;
+    return std::move( *static_cast< SExpr::Cons * >( list.get() ) );
+}
 
-    if ( this->m_currentToken.kind == TokenKind::RPAREN ) {
-        // Empty list.
-        return cons;
+void
+Parser::countParameters() {
+    // For each '(', the number of elements of its list that are not labels.
+    this->m_elementCounts.assign( this->m_tokens.size(), 0 );
+    std::vector< size_t > open;
+    for ( size_t i = 0; i < this->m_tokens.size(); ++i ) {
+        const auto kind = this->m_tokens.kind( i );
+        if ( kind == TokenKind::RPAREN ) {
+            if ( !open.empty() ) {
+                open.pop_back();
+            }
+            continue;
+        }
+        if ( !open.empty() && kind != TokenKind::LABEL ) {
+            this->m_elementCounts[ open.back() ] += 1;
+        }
+        if ( kind == TokenKind::LPAREN ) {
+            open.push_back( i );
+        }
     }
+}
 
-    auto sExpr = this->parseSExpr();
-    if ( this->error ) {
-        return cons;
-    }
-    cons.car = std::move( sExpr );
+std::unique_ptr< SExpr::Base >
+Parser::parseList() {
+    this->expectToken( TokenKind::LPAREN );
 
-    if ( this->m_currentToken.kind == TokenKind::RPAREN ) {
-        // Nil CDR.
+    // One entry per list currently open. A list is built as a `Proc` if it is
+    // one, otherwise as conses, in which case `last` is its last cell (null while
+    // the list is still empty).
+    struct OpenList {
+        std::unique_ptr< SExpr::Base > node;
+        SExpr::Cons * last;
+        SExpr::Proc * proc;
+        std::optional< InternedSymbol > label;
+    };
+    std::vector< OpenList > open;
+    const auto append = [ & ]( std::unique_ptr< SExpr::Base > element ) {
+        auto & top = open.back();
+        if ( top.proc ) {
+            top.proc->parameters.push_back( { top.label, std::move( element ) } );
+            top.label.reset();
+        } else if ( !top.last ) {
+            top.last = static_cast< SExpr::Cons * >( top.node.get() );
+            top.last->car = std::move( element );
+        } else {
+            top.last->cdr = this->makeNode< SExpr::Cons >( std::move( element ) );
+            top.last = static_cast< SExpr::Cons * >( top.last->cdr.get() );
+        }
+    };
+    const auto openList = [ & ]() {
+        const size_t parenIdx = this->m_currentTokenIdx;
         this->eatToken();
-        return std::move( cons );
-    }
-
-    sExpr = this->parseSExpr();
-    if ( this->error ) {
-        return cons;
-    }
-    cons.cdr = std::make_unique< SExpr::Cons >( std::move( sExpr ) );
+        if ( !this->m_procMode || this->m_currentKind != TokenKind::IDENT ) {
+            open.push_back( { this->makeNode< SExpr::Cons >(), nullptr, nullptr, {} } );
+            return;
+        }
+        if ( this->m_elementCounts.empty() ) {
+            this->countParameters();
+        }
+        auto proc = this->makeNode< SExpr::Proc >(
+            SExpr::Symbol( this->m_tokens.symbol( this->m_currentTokenIdx ) ),
+            std::vector< SExpr::Proc::Parameter >() );
+        proc->parameters.reserve( this->m_elementCounts[ parenIdx ] - 1 );
+        this->eatToken();
+        auto * const procPtr = proc.get();
+        open.push_back( { std::move( proc ), nullptr, procPtr, {} } );
+    };
 
-    auto * workingCdr = dynamic_cast< SExpr::Cons * >( cons.cdr.get() );
     while ( true ) {
-        if ( this->m_currentToken.kind == TokenKind::RPAREN ) {
+        if ( this->m_currentKind == TokenKind::LPAREN ) {
+            openList();
+            continue;
+        }
+        if ( this->m_currentKind == TokenKind::RPAREN ) {
+            if ( open.back().label ) {
+                this->emitError( this->currentLoc(), "Expected a value after label." );
+                this->error = true;
+                return std::move( open.front().node );
+            }
             this->eatToken();
-            break;
+            auto done = std::move( open.back().node );
+            open.pop_back();
+            if ( open.empty() ) {
+                return done;
+            }
+            append( std::move( done ) );
+            continue;
+        }
+        if ( this->m_currentKind == TokenKind::LABEL && open.back().proc &&
+             !open.back().label ) {
+            open.back().label = this->m_tokens.symbol( this->m_currentTokenIdx );
+            this->eatToken();
+            continue;
         }
 
-        sExpr = this->parseSExpr();
+        auto atom = this->parseAtom();
         if ( this->error ) {
-            return cons;
+            // Like the outermost list, as far as it got. Lists still open inside it
+            // are dropped.
+            return std::move( open.front().node );
         }
-
-        auto newCons = std::make_unique< SExpr::Cons >( std::move( sExpr ) );
-        workingCdr->cdr = std::move( newCons );
-        workingCdr = dynamic_cast< SExpr::Cons * >( workingCdr->cdr.get() );
+        append( std::move( atom ) );
     }
-
-    return cons;
 }
 
 #ifdef MYL_TEST
@@ -220,6 +432,130 @@ testParseCons( Tm42_TestContext * ctx ) {
         TM42_TEST_ASSERT( ctx, cdrCdr->cdr == nullptr );
     }
 
+    { // Case: nested empty list
+        const auto src = "(() 1)";
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        parser.eatToken();
+        const auto cons = parser.parseCons();
+        TM42_TEST_ASSERT( ctx, dynamic_cast< SExpr::Cons * >( cons.car.get() ) );
+        const auto cdr = dynamic_cast< SExpr::Cons * >( cons.cdr.get() );
+        TM42_TEST_ASSERT( ctx, cdr );
+        TM42_TEST_ASSERT( ctx, dynamic_cast< SExpr::Int32 * >( cdr->car.get() ) );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testParseTopLevel( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Parse top-level forms." );
+
+    { // Case: several forms
+        const auto src = "1 (a b) () foo";
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        const auto result = parser.parse();
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 4 );
+        TM42_TEST_ASSERT(
+            ctx, dynamic_cast< SExpr::Symbol * >( result.sexprs[ 3 ].get() ) );
+    }
+    { // Case: unterminated list
+        const auto src = "(a) (1 2";
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        const auto result = parser.parse();
+        TM42_TEST_ASSERT( ctx, result.error );
+        // Only the forms before the error, each with its location.
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, result.locs.size() == 1 );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testParseDeepNesting( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Parse deep nesting." );
+
+    { // Case: far deeper than recursion could go
+        constexpr int DEPTH = 1000000;
+        const std::string src = std::string( DEPTH, '(' ) + "x" + std::string( DEPTH, ')' );
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        const auto result = parser.parse();
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, SExpr::countNodes( *result.sexprs[ 0 ] ) == DEPTH + 1 );
+        std::ostringstream os;
+        os << *result.sexprs[ 0 ];
+        // "(" and " NIL)" per level, around the symbol.
+        const auto symbol =
+            "SYM<" + std::to_string( lexer.symbolInterner->intern( "x" ) ) + ">";
+        TM42_TEST_ASSERT( ctx, os.str().size() == 6 * size_t( DEPTH ) + symbol.size() );
+    }
+    { // Case: procedures nested far deeper than recursion could go
+        constexpr int DEPTH = 1000000;
+        std::string src;
+        for ( int i = 0; i < DEPTH; ++i ) {
+            src += "(f ";
+        }
+        src += "1" + std::string( DEPTH, ')' );
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        parser.setProcMode( true );
+        auto result = parser.parse();
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, dynamic_cast< SExpr::Proc * >( result.sexprs[ 0 ].get() ) );
+        TM42_TEST_ASSERT( ctx, SExpr::countNodes( *result.sexprs[ 0 ] ) == DEPTH + 1 );
+        std::ostringstream os;
+        os << *result.sexprs[ 0 ];
+        // "(PROC<" symbol "> " and ")" per level, around "I32<1>".
+        const auto symbol =
+            "SYM<" + std::to_string( lexer.symbolInterner->intern( "f" ) ) + ">";
+        TM42_TEST_ASSERT( ctx, os.str().size() ==
+                                   ( 9 + symbol.size() ) * size_t( DEPTH ) + 6 );
+        TM42_TEST_ASSERT( ctx, os.str().compare( 0, 7 + symbol.size(),
+                                                 "(PROC<" + symbol + ">" ) == 0 );
+        // Destroyed here, rather than with the rest of the test's locals.
+        result.sexprs.clear();
+    }
+    { // Case: long list, nested lists in the middle
+        const auto src = "(a (b (c)) () d)";
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        const auto result = parser.parse();
+        const auto intern = [ & ]( const char * s ) {
+            return std::to_string( lexer.symbolInterner->intern( s ) );
+        };
+        std::ostringstream os;
+        os << *result.sexprs[ 0 ];
+        TM42_TEST_ASSERT(
+            ctx, os.str() == "(SYM<" + intern( "a" ) + "> ((SYM<" + intern( "b" ) +
+                                 "> ((SYM<" + intern( "c" ) + "> NIL) NIL)) ((NIL NIL) (SYM<" +
+                                 intern( "d" ) + "> NIL))))" );
+    }
+    { // Case: error deep inside keeps the outer list so far
+        const std::string src = std::string( 1000, '(' ) + "1";
+        auto lexer = Lexer( src );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( src, lexResult.tokens );
+        std::ostringstream errors;
+        auto * const oldCerr = std::cerr.rdbuf( errors.rdbuf() );
+        const auto result = parser.parse();
+        std::cerr.rdbuf( oldCerr );
+        TM42_TEST_ASSERT( ctx, result.error );
+        TM42_TEST_ASSERT( ctx, result.locs.empty() );
+    }
+
     TM42_END_TEST();
 }
 #endif // MYL_TEST
@@ -325,50 +661,223 @@ testParseProc( Tm42_TestContext * ctx ) {
     TM42_END_TEST();
 }
 
+void
+testParseProcMode( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Parse procedures in one pass" );
+
+    const auto parse = []( const char * input ) {
+        auto lexer = Lexer( input );
+        const auto lexResult = lexer.lex();
+        assert( !lexResult.error );
+        auto parser = Parser( input, lexResult.tokens );
+        parser.setProcMode( true );
+        return parser.parse();
+    };
+    const auto toString = []( const SExpr::Base & sexpr ) {
+        std::ostringstream os;
+        os << sexpr;
+        return os.str();
+    };
+
+    { // Same procedure as building conses, then `parseProc()`.
+        const char * input = "(foo 1 @p2 3 4 @p5 6 7)";
+        const auto result = parse( input );
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 1 );
+        const auto * proc = dynamic_cast< SExpr::Proc * >( result.sexprs[ 0 ].get() );
+        TM42_TEST_ASSERT( ctx, proc );
+        TM42_TEST_ASSERT( ctx, proc->parameters.size() == 5 );
+        TM42_TEST_ASSERT( ctx, proc->parameters.capacity() == 5 );
+
+        auto twoPass = parseProcTestHelper( input );
+        const auto expected = twoPass.parser.parseProc( std::move( twoPass.cons ) );
+        TM42_TEST_ASSERT( ctx, toString( *proc ) == toString( expected ) );
+    }
+    { // Nested procedures; lists not starting with a symbol stay conses.
+        const auto result = parse( "(foo) (1 2) ((bar @x (baz (1) @y ())) 2)" );
+        TM42_TEST_ASSERT( ctx, !result.error );
+        TM42_TEST_ASSERT( ctx, result.sexprs.size() == 3 );
+        const auto * foo = dynamic_cast< SExpr::Proc * >( result.sexprs[ 0 ].get() );
+        TM42_TEST_ASSERT( ctx, foo && foo->parameters.empty() );
+        TM42_TEST_ASSERT(
+            ctx, dynamic_cast< SExpr::Cons * >( result.sexprs[ 1 ].get() ) );
+
+        const auto * outer = dynamic_cast< SExpr::Cons * >( result.sexprs[ 2 ].get() );
+        TM42_TEST_ASSERT( ctx, outer );
+        const auto * bar = dynamic_cast< SExpr::Proc * >( outer->car.get() );
+        TM42_TEST_ASSERT( ctx, bar && bar->parameters.size() == 1 );
+        TM42_TEST_ASSERT( ctx, bar->parameters[ 0 ].label );
+        const auto * baz = dynamic_cast< SExpr::Proc * >(
+            bar->parameters[ 0 ].value.get() );
+        TM42_TEST_ASSERT( ctx, baz && baz->parameters.size() == 2 );
+        TM42_TEST_ASSERT( ctx, !baz->parameters[ 0 ].label );
+        TM42_TEST_ASSERT( ctx, dynamic_cast< SExpr::Cons * >(
+                                   baz->parameters[ 0 ].value.get() ) );
+        TM42_TEST_ASSERT( ctx, baz->parameters[ 1 ].label );
+        TM42_TEST_ASSERT( ctx, SExpr::countNodes( *result.sexprs[ 2 ] ) == 8 );
+    }
+    { // A label needs a value.
+        const auto result = parse( "(foo 1 @p)" );
+        TM42_TEST_ASSERT( ctx, result.error );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testParseEvents( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Parse events" );
+
+    // Writes events back out as text, plus some running totals.
+    struct Recorder : ParseEventHandler {
+        std::ostringstream os;
+        I32 intSum = 0;
+        std::vector< SourceOffset > listOffsets;
+
+        void onListBegin( SourceCodeLocation loc ) {
+            os << "( ";
+            listOffsets.push_back( loc.byteOffset() );
+        }
+        void onListEnd( SourceCodeLocation ) { os << ") "; }
+        void onInt32( I32 value, SourceCodeLocation ) {
+            os << value << " ";
+            intSum += value;
+        }
+        void onFloat64( F64 value, SourceCodeLocation ) { os << value << " "; }
+        void onSymbol( InternedSymbol, SourceCodeLocation ) { os << "sym "; }
+        void onLabel( InternedSymbol, SourceCodeLocation ) { os << "@ "; }
+    };
+    const auto run = []( const char * input, Recorder & recorder ) {
+        auto lexer = Lexer( input );
+        const auto lexResult = lexer.lex();
+        assert( !lexResult.error );
+        auto parser = Parser( input, lexResult.tokens );
+        return parser.parseEvents( recorder );
+    };
+
+    { // Every token becomes one event.
+        Recorder recorder;
+        TM42_TEST_ASSERT( ctx, run( "(foo 1 @bar (2.5 ()) -3) baz 4", recorder ) );
+        TM42_TEST_ASSERT(
+            ctx, recorder.os.str() == "( sym 1 @ ( 2.5 ( ) ) -3 ) sym 4 " );
+        TM42_TEST_ASSERT( ctx, recorder.intSum == 2 );
+        TM42_TEST_ASSERT( ctx, recorder.listOffsets ==
+                                   std::vector< SourceOffset >( { 0, 12, 17 } ) );
+    }
+    { // Handlers only need the events they use.
+        struct Counter : ParseEventHandler {
+            int lists = 0;
+            void onListBegin( SourceCodeLocation ) { lists += 1; }
+        } counter;
+        const char * input = "((a) (b (c)))";
+        auto lexer = Lexer( input );
+        const auto lexResult = lexer.lex();
+        auto parser = Parser( input, lexResult.tokens );
+        TM42_TEST_ASSERT( ctx, parser.parseEvents( counter ) );
+        TM42_TEST_ASSERT( ctx, counter.lists == 4 );
+    }
+    { // Unbalanced parentheses are errors, after the events before them.
+        Recorder unclosed;
+        TM42_TEST_ASSERT( ctx, !run( "(a (b)", unclosed ) );
+        TM42_TEST_ASSERT( ctx, unclosed.os.str() == "( sym ( sym ) " );
+        Recorder unopened;
+        TM42_TEST_ASSERT( ctx, !run( "1 ) 2", unopened ) );
+        TM42_TEST_ASSERT( ctx, unopened.os.str() == "1 " );
+    }
+
+    TM42_END_TEST();
+}
+
 #endif // MYL_TEST
 
 std::unique_ptr< SExpr::Base >
 Parser::parseSExpr() {
-    switch ( this->m_currentToken.kind ) {
-    case TokenKind::LPAREN:
-        return std::make_unique< SExpr::Cons >( this->parseCons() );
+    if ( this->m_currentKind == TokenKind::LPAREN ) {
+        return this->parseList();
+    }
+    return this->parseAtom();
+}
+
+std::unique_ptr< SExpr::Base >
+Parser::parseAtom() {
+    switch ( this->m_currentKind ) {
     case TokenKind::INT32: {
-        const auto data = std::get< I32 >( this->m_currentToken.data );
+        const auto data = this->m_tokens.int32( this->m_currentTokenIdx );
         this->eatToken();
-        return std::make_unique< SExpr::Int32 >( data );
+        return this->makeNode< SExpr::Int32 >( data );
     }
     case TokenKind::FLOAT64: {
-        const auto data = std::get< F64 >( this->m_currentToken.data );
+        const auto data = this->m_tokens.float64( this->m_currentTokenIdx );
         this->eatToken();
-        return std::make_unique< SExpr::Float64 >( data );
+        return this->makeNode< SExpr::Float64 >( data );
     }
     case TokenKind::IDENT: {
-        const auto data = std::get< InternedSymbol >( this->m_currentToken.data );
+        const auto data = this->m_tokens.symbol( this->m_currentTokenIdx );
         this->eatToken();
-        return std::make_unique< SExpr::Symbol >( data );
+        return this->makeNode< SExpr::Symbol >( data );
     }
     case TokenKind::LABEL: {
-        const auto data = std::get< InternedSymbol >( this->m_currentToken.data );
+        const auto data = this->m_tokens.symbol( this->m_currentTokenIdx );
         this->eatToken();
-        return std::make_unique< SExpr::Label >( data );
+        return this->makeNode< SExpr::Label >( data );
     }
     default: {
-        emitSourceError( this->source, this->m_currentToken.loc,
-                         "Could not parse SExpr starting here." );
+        this->emitError( this->currentLoc(), "Could not parse SExpr starting here." );
         this->error = true;
-        return std::make_unique< SExpr::Base >();
+        return this->makeNode< SExpr::Base >();
     }
     };
 }
 
+void
+Parser::finishEvents( std::chrono::steady_clock::time_point start, size_t formCount ) {
+    const auto nanos = std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now() - start ).count();
+    Metrics::add( Metrics::Counter::PARSED_FORMS, formCount );
+    Metrics::add( Metrics::Counter::PARSE_ERRORS, this->error );
+    Metrics::add( Metrics::Counter::PARSE_NANOS, nanos );
+    Metrics::record( Metrics::Histogram::PARSE_CALL_NANOS, nanos );
+}
+
 Parser::Result
 Parser::parse() {
+    const auto start = std::chrono::steady_clock::now();
+    const size_t nodeCountBefore = this->m_nodeCount;
+    const size_t astBytesBefore = this->m_astBytes;
+    Metrics::LocalHistogram formNodes;
+
     std::vector< std::unique_ptr< SExpr::Base > > toReturn;
-    while ( this->eatToken() ) {
-        toReturn.push_back( this->parseSExpr() );
+    std::vector< SourceCodeLocation > locs;
+    this->eatToken();
+    while ( this->m_currentKind != TokenKind::END ) {
+        const SourceOffset begin =
+            this->m_tokens.loc( this->m_currentTokenIdx ).byteOffset();
+        const size_t formNodeCountBefore = this->m_nodeCount;
+        auto sexpr = this->parseSExpr();
         if ( this->error ) {
+            // Only whole forms are returned, so each has a location.
             break;
         }
+        toReturn.push_back( std::move( sexpr ) );
+        formNodes.record( this->m_nodeCount - formNodeCountBefore );
+        // Tokens are consumed in order, so the form ends with the token before the
+        // current one.
+        const size_t lastIdx = ( this->m_currentKind == TokenKind::END )
+            ? this->m_tokens.size() - 1
+            : this->m_currentTokenIdx - 1;
+        const auto last = this->m_tokens.loc( lastIdx );
+        locs.push_back( { begin, last.byteOffset() + last.byteLength() - begin } );
     }
-    return { std::move( toReturn ), this->error };
+
+    const auto nanos = std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now() - start ).count();
+    Metrics::add( Metrics::Counter::PARSED_FORMS, locs.size() );
+    Metrics::add( Metrics::Counter::PARSED_NODES, this->m_nodeCount - nodeCountBefore );
+    Metrics::add( Metrics::Counter::AST_BYTES, this->m_astBytes - astBytesBefore );
+    Metrics::add( Metrics::Counter::PARSE_ERRORS, this->error );
+    Metrics::add( Metrics::Counter::PARSE_NANOS, nanos );
+    Metrics::merge( Metrics::Histogram::FORM_NODES, formNodes );
+    Metrics::record( Metrics::Histogram::PARSE_CALL_NANOS, nanos );
+
+    return { std::move( toReturn ), this->error, std::move( locs ) };
 }
@@ -2,8 +2,12 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -67,12 +71,21 @@ public:
     Cons( std::unique_ptr< Base > car ): car( std::move( car ) ) {}
     Cons( std::unique_ptr< Base > car, std::unique_ptr< Base > cdr )
         : car( std::move( car ) ), cdr( std::move( cdr ) ) {}
+    Cons( Cons && ) = default;
+    Cons & operator=( Cons && ) = default;
+    // Tears the tree down with an explicit stack, since lists can be nested (and
+    // chained through `cdr`) far deeper than the C++ stack allows.
+    ~Cons() override;
 
     virtual void print( std::ostream & os ) const override;
 };
 
 std::ostream & operator<<( std::ostream & os, const Base & obj );
 
+// Number of nodes in the tree rooted at `root`, including it. Does not recurse, so
+// it is safe on arbitrarily deep trees.
+size_t countNodes( const Base & root );
+
 class Proc: public Base {
 public:
     struct Parameter {
@@ -85,30 +98,70 @@ public:
 
     Proc( Symbol procSymbol, std::vector< Parameter > parameters )
         : procSymbol( procSymbol ), parameters( std::move( parameters ) ) {}
+    Proc( Proc && ) = default;
+    Proc & operator=( Proc && ) = default;
+    // Like `Cons`, procs can nest (through their parameters) deeper than recursion
+    // could go.
+    ~Proc() override;
 
     virtual void print( std::ostream & os ) const override;
 };
 
 } // namespace SExpr
 
+// Receives a parse as a stream of events rather than as a tree; see
+// `Parser::parseEvents()`. Each event carries the location of its token.
+//
+// Handlers are plain types, called directly (not virtually), so that calls can be
+// inlined. Deriving from this one is optional, and supplies no-ops for the events a
+// handler doesn't care about.
+struct ParseEventHandler {
+    void onListBegin( SourceCodeLocation ) {}
+    void onListEnd( SourceCodeLocation ) {}
+    void onInt32( I32, SourceCodeLocation ) {}
+    void onFloat64( F64, SourceCodeLocation ) {}
+    void onSymbol( InternedSymbol, SourceCodeLocation ) {}
+    void onLabel( InternedSymbol, SourceCodeLocation ) {}
+};
+
 class Parser {
 public:
     struct Result {
+        // On an error, the forms before the one that failed.
         std::vector< std::unique_ptr< SExpr::Base > > sexprs;
         bool error;
+        // Source extent of each of `sexprs`, from its first byte to the end of its
+        // last token.
+        std::vector< SourceCodeLocation > locs;
     };
 
-    Parser( const std::string & source, const std::vector< Token > & tokens )
+    Parser( std::string_view source, const TokenBuffer & tokens )
         : source( source ), m_tokens{ tokens } {}
+    // `tokens` must come from a `Lexer` over the same file of `sources`, so their
+    // locations are global.
+    Parser( const SourceManager & sources, SourceManager::FileId file,
+            const TokenBuffer & tokens )
+        : source( sources.text( file ) ), m_tokens{ tokens }, m_sources( &sources ),
+          m_baseOffset( sources.baseOffset( file ) ) {}
     Result parse();
+    // Like `parse()`, but rather than building a tree, calls `handler` for every
+    // list boundary and atom, straight from the tokens, and allocates nothing. A
+    // list's events are bracketed by `onListBegin()`/`onListEnd()`; procedures are
+    // not recognized. Returns false after reporting a syntax error, by which point
+    // the events before it have been delivered.
+    template < typename Handler >
+    bool parseEvents( Handler & handler );
 
     // --- begin parse functions ----------------------------------------------------
     // These functions generally assume that the first token of the thing they are
-    // parsing is stored in `m_currentToken`. The caller may assume that, right after
+    // parsing is the current token (`m_currentTokenIdx`). The caller may assume that, right after
     // returning from a parse function, `eatToken` will yield the token after the
     // thing we just parsed, if any.
 
     // cons := '(' SExpr SExpr? ')'
+    //
+    // Lists are parsed with an explicit stack rather than by recursion, so nesting
+    // depth is bounded only by memory.
     SExpr::Cons parseCons();
     // Proc := '(' Symbol Parameters ')'
     // Parameters := Cons< Parameter, Parameters > | Nil
@@ -118,17 +171,111 @@ public:
     // We have to return a pointer or else we'll lose RTTI... ):
     std::unique_ptr< SExpr::Base > parseSExpr();
 
+    // In proc mode, `parse()` and `parseSExpr()` build every list that starts with
+    // a symbol, i.e. `(symbol [@label] value ...)`, directly as an `SExpr::Proc`
+    // rather than as conses for `parseProc()` to take apart. Other lists are still
+    // conses. Off by default.
+    void setProcMode( bool procMode ) { this->m_procMode = procMode; }
+
     // --- end parse functions ------------------------------------------------------
 
-    // Returns a pointer to the token just eaten if it just ate one, null otherwise.
-    Token * eatToken();
+    // Advances to the next token. Returns false if there are no more tokens, in
+    // which case the current kind becomes `TokenKind::END`.
+    bool eatToken();
+
+    // Line index of the source, built on first use (normally the first error).
+    const LineIndex & lineIndex();
 
 private:
     void expectToken( TokenKind e );
-
-    const std::string & source;
-    const std::vector< Token > & m_tokens;
-    int m_nextTokenIdx = 0;
-    Token m_currentToken;
+    SourceCodeLocation currentLoc() const;
+    void emitError( SourceCodeLocation loc, const std::string & msg );
+    // Current token is the '(' of the outermost list. Returns a `Cons`, or in proc
+    // mode possibly a `Proc`.
+    std::unique_ptr< SExpr::Base > parseList();
+    // Publishes metrics for a `parseEvents()` call.
+    void finishEvents( std::chrono::steady_clock::time_point start, size_t formCount );
+    // Fills `m_elementCounts`.
+    void countParameters();
+    // Current token is anything but a parenthesis.
+    std::unique_ptr< SExpr::Base > parseAtom();
+    // `std::make_unique`, plus node accounting for metrics.
+    template < typename T, typename... Args >
+    std::unique_ptr< T >
+    makeNode( Args &&... args ) {
+        this->m_nodeCount += 1;
+        this->m_astBytes += sizeof( T );
+        return std::make_unique< T >( std::forward< Args >( args )... );
+    }
+
+    std::string_view source;
+    const TokenBuffer & m_tokens;
+    size_t m_nextTokenIdx = 0;
+    size_t m_currentTokenIdx = 0;
+    TokenKind m_currentKind = TokenKind::END;
     bool error = false;
+    std::optional< LineIndex > m_lineIndex;
+    // Set when parsing a file of a `SourceManager`.
+    const SourceManager * m_sources = nullptr;
+    SourceOffset m_baseOffset = 0;
+    bool m_procMode = false;
+    // Indexed by token; for each '(', how many elements of its list are not labels.
+    // Computed on first use, in one pass, so sizing a `Proc`'s parameters doesn't
+    // mean scanning ahead over its whole subtree.
+    std::vector< std::uint32_t > m_elementCounts;
+    // Nodes made so far, for metrics.
+    size_t m_nodeCount = 0;
+    size_t m_astBytes = 0;
 };
+
+template < typename Handler >
+bool
+Parser::parseEvents( Handler & handler ) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t formCount = 0;
+    size_t depth = 0;
+    this->eatToken();
+    while ( this->m_currentKind != TokenKind::END ) {
+        const size_t idx = this->m_currentTokenIdx;
+        const auto loc = this->m_tokens.loc( idx );
+        switch ( this->m_currentKind ) {
+        case TokenKind::LPAREN:
+            depth += 1;
+            handler.onListBegin( loc );
+            break;
+        case TokenKind::RPAREN:
+            if ( depth == 0 ) {
+                this->emitError( loc, "Could not parse SExpr starting here." );
+                this->error = true;
+                this->finishEvents( start, formCount );
+                return false;
+            }
+            depth -= 1;
+            handler.onListEnd( loc );
+            break;
+        case TokenKind::INT32:
+            handler.onInt32( this->m_tokens.int32( idx ), loc );
+            break;
+        case TokenKind::FLOAT64:
+            handler.onFloat64( this->m_tokens.float64( idx ), loc );
+            break;
+        case TokenKind::IDENT:
+            handler.onSymbol( this->m_tokens.symbol( idx ), loc );
+            break;
+        case TokenKind::LABEL:
+            handler.onLabel( this->m_tokens.symbol( idx ), loc );
+            break;
+        case TokenKind::END:
+            break;
+        }
+        formCount += depth == 0;
+        this->eatToken();
+    }
+    if ( depth > 0 ) {
+        // Same as `parse()`, which runs out of tokens looking for an element.
+        this->emitError( this->currentLoc(), "Could not parse SExpr starting here." );
+        this->error = true;
+    }
+    this->finishEvents( start, formCount );
+    return !this->error;
+}
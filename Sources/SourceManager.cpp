@@ -0,0 +1,247 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MYL_TEST
+#include <cstdio>
+#include <sstream>
+#include <Test/Test.h>
+
+#include "Parser.h"
+#endif
+#include <Tracing/Tracing.h>
+
+#include "SourceManager.h"
+
+extern TraceContext TC;
+
+SourceManager::~SourceManager() {
+    for ( const auto & file : this->m_files ) {
+        if ( file->mapping ) {
+            munmap( file->mapping, file->mappingSize );
+        }
+    }
+}
+
+SourceManager::FileId
+SourceManager::addEntry( std::unique_ptr< File > file ) {
+    const auto size = static_cast< SourceOffset >( file->text.size() );
+    if ( size > SourceCodeLocation::MAX_OFFSET - this->m_nextOffset ) {
+        std::cerr << "error: " << file->name
+                  << ": too large; the sources may total at most 1TiB\n";
+        if ( file->mapping ) {
+            munmap( file->mapping, file->mappingSize );
+        }
+        return INVALID_FILE;
+    }
+    file->baseOffset = this->m_nextOffset;
+    // Leave room for the end-of-file location.
+    this->m_nextOffset += size + 1;
+    t1( &TC, "Added source %s: %zu bytes at offset %lld", file->name.c_str(),
+        file->text.size(), static_cast< long long >( file->baseOffset ) );
+    this->m_files.push_back( std::move( file ) );
+    return static_cast< FileId >( this->m_files.size() - 1 );
+}
+
+SourceManager::FileId
+SourceManager::addFile( const std::string & path ) {
+    const int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        std::cerr << "error: " << path << ": " << std::strerror( errno ) << "\n";
+        return INVALID_FILE;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        std::cerr << "error: " << path << ": " << std::strerror( errno ) << "\n";
+        close( fd );
+        return INVALID_FILE;
+    }
+
+    auto file = std::make_unique< File >();
+    file->name = path;
+    const size_t size = static_cast< size_t >( st.st_size );
+    // mmap rejects empty mappings; an empty file is just an empty view.
+    if ( size > 0 ) {
+        void * mapping = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( mapping == MAP_FAILED ) {
+            std::cerr << "error: " << path << ": " << std::strerror( errno ) << "\n";
+            close( fd );
+            return INVALID_FILE;
+        }
+        // The lexer reads front to back.
+        madvise( mapping, size, MADV_SEQUENTIAL );
+        file->mapping = mapping;
+        file->mappingSize = size;
+        file->text = std::string_view( static_cast< const char * >( mapping ), size );
+    }
+    // The mapping keeps the file referenced.
+    close( fd );
+    return this->addEntry( std::move( file ) );
+}
+
+SourceManager::FileId
+SourceManager::addBuffer( std::string name, std::string text ) {
+    auto file = std::make_unique< File >();
+    file->name = std::move( name );
+    file->ownedText = std::move( text );
+    file->text = file->ownedText;
+    return this->addEntry( std::move( file ) );
+}
+
+std::string_view
+SourceManager::text( FileId file ) const {
+    return this->m_files[ file ]->text;
+}
+
+const std::string &
+SourceManager::name( FileId file ) const {
+    return this->m_files[ file ]->name;
+}
+
+SourceOffset
+SourceManager::baseOffset( FileId file ) const {
+    return this->m_files[ file ]->baseOffset;
+}
+
+const LineIndex &
+SourceManager::lineIndex( FileId file ) const {
+    const auto & entry = *this->m_files[ file ];
+    if ( !entry.lineIndex ) {
+        entry.lineIndex.emplace( entry.text );
+    }
+    return *entry.lineIndex;
+}
+
+SourceManager::FileId
+SourceManager::fileOf( SourceOffset globalOffset ) const {
+    if ( globalOffset < 0 || globalOffset >= this->m_nextOffset ) {
+        return INVALID_FILE;
+    }
+    // Last file starting at or before `globalOffset`.
+    const auto it = std::upper_bound(
+        this->m_files.begin(), this->m_files.end(), globalOffset,
+        []( SourceOffset offset, const std::unique_ptr< File > & file ) {
+            return offset < file->baseOffset;
+        } );
+    return static_cast< FileId >( it - this->m_files.begin() ) - 1;
+}
+
+SourceCodeLocation
+SourceManager::toLocal( SourceCodeLocation loc ) const {
+    const FileId file = this->fileOf( loc.byteOffset() );
+    tassert( &TC, file != INVALID_FILE, "Location %lld is in no source",
+             static_cast< long long >( loc.byteOffset() ) );
+    return { loc.byteOffset() - this->baseOffset( file ), loc.byteLength() };
+}
+
+void
+SourceManager::emitError( SourceCodeLocation loc, const std::string & msg ) const {
+    const FileId file = this->fileOf( loc.byteOffset() );
+    tassert( &TC, file != INVALID_FILE, "Location %lld is in no source",
+             static_cast< long long >( loc.byteOffset() ) );
+    emitSourceError( this->text( file ), this->lineIndex( file ), this->toLocal( loc ),
+                     msg, this->name( file ) );
+}
+
+#ifdef MYL_TEST
+void
+testSourceManager( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Source manager" );
+
+    char path[] = "/tmp/myl_source_manager_XXXXXX";
+    const int fd = mkstemp( path );
+    const std::string contents = "(a 1)\n(b 2)\n";
+    TM42_TEST_ASSERT( ctx, write( fd, contents.data(), contents.size() ) ==
+                               static_cast< ssize_t >( contents.size() ) );
+    close( fd );
+
+    {
+        SourceManager sources;
+        const auto buffer = sources.addBuffer( "<repl>", "foo" );
+        const auto file = sources.addFile( path );
+        const auto missing = sources.addFile( "/nonexistent/myl/file" );
+        TM42_TEST_ASSERT( ctx, missing == SourceManager::INVALID_FILE );
+        TM42_TEST_ASSERT( ctx, sources.fileCount() == 2 );
+
+        TM42_TEST_ASSERT( ctx, sources.text( buffer ) == "foo" );
+        TM42_TEST_ASSERT( ctx, sources.text( file ) == contents );
+        TM42_TEST_ASSERT( ctx, sources.name( file ) == path );
+        TM42_TEST_ASSERT( ctx, sources.baseOffset( buffer ) == 0 );
+        TM42_TEST_ASSERT( ctx, sources.baseOffset( file ) == 4 );
+
+        // End of file belongs to the file, not the next one.
+        TM42_TEST_ASSERT( ctx, sources.fileOf( 0 ) == buffer );
+        TM42_TEST_ASSERT( ctx, sources.fileOf( 3 ) == buffer );
+        TM42_TEST_ASSERT( ctx, sources.fileOf( 4 ) == file );
+        TM42_TEST_ASSERT( ctx, sources.fileOf( 4 + 12 ) == file );
+        TM42_TEST_ASSERT( ctx, sources.fileOf( 4 + 13 ) == SourceManager::INVALID_FILE );
+        TM42_TEST_ASSERT( ctx, sources.toLocal( { 10, 5 } ).byteOffset() == 6 );
+        TM42_TEST_ASSERT( ctx, sources.lineIndex( file ).position( 6 ).line == 2 );
+    }
+    { // Empty files map to empty views.
+        const int emptyFd = open( path, O_WRONLY | O_TRUNC );
+        close( emptyFd );
+        SourceManager sources;
+        const auto file = sources.addFile( path );
+        TM42_TEST_ASSERT( ctx, file == 0 );
+        TM42_TEST_ASSERT( ctx, sources.text( file ).empty() );
+    }
+
+    { // Offsets run past 2GiB. The file is sparse, so this takes no real memory.
+        const int bigFd = open( path, O_WRONLY | O_TRUNC );
+        const off_t bigSize = off_t( 3 ) << 30;
+        TM42_TEST_ASSERT( ctx, ftruncate( bigFd, bigSize ) == 0 );
+        close( bigFd );
+        SourceManager sources;
+        const auto big = sources.addFile( path );
+        const auto after = sources.addBuffer( "after.myl", "(a)\n  (b" );
+        TM42_TEST_ASSERT( ctx, big != SourceManager::INVALID_FILE );
+        TM42_TEST_ASSERT( ctx, sources.baseOffset( after ) == bigSize + 1 );
+        TM42_TEST_ASSERT( ctx, sources.fileOf( bigSize + 3 ) == after );
+
+        auto lexer = Lexer( sources, after );
+        const auto lexResult = lexer.lex();
+        TM42_TEST_ASSERT( ctx, lexResult.tokens.loc( 4 ).byteOffset() == bigSize + 8 );
+        std::ostringstream errors;
+        auto * const oldCerr = std::cerr.rdbuf( errors.rdbuf() );
+        auto parser = Parser( sources, after, lexResult.tokens );
+        const auto result = parser.parse();
+        std::cerr.rdbuf( oldCerr );
+        TM42_TEST_ASSERT( ctx, result.error );
+        TM42_TEST_ASSERT( ctx, errors.str().find( "after.myl:2:" ) != std::string::npos );
+    }
+
+    { // Lexing and parsing out of the manager gives global locations.
+        SourceManager sources;
+        sources.addBuffer( "first.myl", "(x)" );
+        const auto second = sources.addBuffer( "second.myl", "(a @b 2)\n(c" );
+        auto lexer = Lexer( sources, second );
+        const auto lexResult = lexer.lex();
+        TM42_TEST_ASSERT( ctx, !lexResult.error );
+        TM42_TEST_ASSERT( ctx, lexResult.tokens.loc( 0 ).byteOffset() == 4 );
+        TM42_TEST_ASSERT( ctx, lexer.getStringView(
+                                   sources.toLocal( lexResult.tokens.loc( 1 ) ) ) == "a" );
+
+        std::ostringstream errors;
+        auto * const oldCerr = std::cerr.rdbuf( errors.rdbuf() );
+        auto parser = Parser( sources, second, lexResult.tokens );
+        const auto result = parser.parse();
+        std::cerr.rdbuf( oldCerr );
+        TM42_TEST_ASSERT( ctx, result.error );
+        TM42_TEST_ASSERT( ctx, result.locs.size() == 1 );
+        TM42_TEST_ASSERT( ctx, result.locs[ 0 ].byteOffset() == 4 );
+        TM42_TEST_ASSERT( ctx, result.locs[ 0 ].byteLength() == 8 );
+        TM42_TEST_ASSERT( ctx, errors.str().find( "second.myl:2:" ) != std::string::npos );
+    }
+
+    unlink( path );
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
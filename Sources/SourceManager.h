@@ -0,0 +1,74 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Error.h"
+#include "LineIndex.h"
+
+// Owns every source the front end reads: files are `mmap`ed read-only, and other
+// text (e.g. REPL input) is copied in. Each source gets a `FileId`, and a contiguous
+// range in one global, 64-bit offset space: a `SourceCodeLocation` whose
+// `byteOffset` is in that space identifies both the file and the position in it, at
+// no extra size.
+//
+// The first source starts at offset 0, so a lone source's global offsets are the
+// same as its local ones. Each range is one byte longer than its source, so an
+// end-of-file location never aliases the next source.
+//
+// Not thread-safe to add to. Lookups may happen concurrently, except for the first
+// `lineIndex()` of a given file.
+class SourceManager {
+public:
+    using FileId = int;
+    static constexpr FileId INVALID_FILE = -1;
+
+    SourceManager() = default;
+    SourceManager( const SourceManager & ) = delete;
+    SourceManager & operator=( const SourceManager & ) = delete;
+    ~SourceManager();
+
+    // Both return `INVALID_FILE` after printing why, if the file can't be mapped or
+    // the sources would no longer fit in `SourceCodeLocation::MAX_OFFSET`.
+    FileId addFile( const std::string & path );
+    // `name` is only used in diagnostics.
+    FileId addBuffer( std::string name, std::string text );
+
+    std::string_view text( FileId file ) const;
+    const std::string & name( FileId file ) const;
+    // Global offset of the first byte of `file`.
+    SourceOffset baseOffset( FileId file ) const;
+    // Built on first use.
+    const LineIndex & lineIndex( FileId file ) const;
+    size_t fileCount() const { return this->m_files.size(); }
+
+    // File containing a global offset, or `INVALID_FILE`.
+    FileId fileOf( SourceOffset globalOffset ) const;
+    // Converts a global location to one relative to its file.
+    SourceCodeLocation toLocal( SourceCodeLocation loc ) const;
+    // Prints a diagnostic for a global location, with the real file name.
+    void emitError( SourceCodeLocation loc, const std::string & msg ) const;
+
+private:
+    struct File {
+        std::string name;
+        std::string_view text;
+        // Set for mapped files; otherwise `text` points into `ownedText`.
+        void * mapping = nullptr;
+        size_t mappingSize = 0;
+        std::string ownedText;
+        SourceOffset baseOffset = 0;
+        mutable std::optional< LineIndex > lineIndex;
+    };
+
+    FileId addEntry( std::unique_ptr< File > file );
+
+    // Stable addresses, since views into `ownedText` are handed out.
+    std::vector< std::unique_ptr< File > > m_files;
+    SourceOffset m_nextOffset = 0;
+};
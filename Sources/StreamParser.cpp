@@ -0,0 +1,169 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#ifdef MYL_TEST
+#include <Test/Test.h>
+#endif
+#include <Tracing/Tracing.h>
+
+#include "Lexer.h"
+#include "StreamParser.h"
+
+extern TraceContext TC;
+
+StreamParser::StreamParser( int fd, size_t chunkSize )
+    : StreamParser( fd, chunkSize, SymbolInterner::global() ) {}
+
+StreamParser::StreamParser( int fd, size_t chunkSize,
+                            std::shared_ptr< SymbolInterner > symbolInterner )
+    : symbolInterner( std::move( symbolInterner ) ),
+      m_fd( fd ),
+      m_chunkSize( chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE ) {}
+
+bool
+StreamParser::readChunk() {
+    if ( this->m_endOfInput ) {
+        return false;
+    }
+
+    const size_t oldSize = this->m_buffer.size();
+    this->m_buffer.resize( oldSize + this->m_chunkSize );
+    ssize_t bytesRead;
+    do {
+        bytesRead = ::read( this->m_fd, this->m_buffer.data() + oldSize,
+                            this->m_chunkSize );
+    } while ( bytesRead < 0 && errno == EINTR );
+
+    if ( bytesRead < 0 ) {
+        std::cerr << "error reading input: " << std::strerror( errno ) << "\n";
+        this->m_error = true;
+        bytesRead = 0;
+    }
+    this->m_buffer.resize( oldSize + bytesRead );
+    if ( bytesRead == 0 ) {
+        this->m_endOfInput = true;
+        return false;
+    }
+    return true;
+}
+
+void
+StreamParser::compact() {
+    // Only move bytes once the parsed prefix dominates the buffer, so that many small
+    // forms in one chunk don't each pay for a memmove of the rest of the chunk.
+    const size_t parsed = this->m_scanner.inForm() ? this->m_scanner.formBegin()
+                                                   : this->m_scanner.position();
+    if ( parsed == 0 || parsed < this->m_buffer.size() / 2 ) {
+        return;
+    }
+    this->m_buffer.erase( 0, parsed );
+    this->m_scanner.shift( parsed );
+    this->m_bytesDropped += parsed;
+}
+
+std::unique_ptr< SExpr::Base >
+StreamParser::next() {
+    if ( this->m_error ) {
+        return nullptr;
+    }
+
+    while ( !this->m_scanner.next( this->m_buffer, this->m_endOfInput ) ) {
+        this->compact();
+        if ( !this->readChunk() ) {
+            if ( this->m_error ) {
+                return nullptr;
+            }
+            if ( this->m_scanner.next( this->m_buffer, true ) ) {
+                break;
+            }
+            if ( this->m_scanner.inForm() ) {
+                std::cerr << "error: unterminated form at end of input (byte "
+                          << this->m_bytesDropped + this->m_scanner.formBegin()
+                          << ")\n";
+                this->m_error = true;
+            }
+            return nullptr;
+        }
+    }
+
+    const auto formText = std::string_view( this->m_buffer ).substr(
+        this->m_scanner.formBegin(),
+        this->m_scanner.formEnd() - this->m_scanner.formBegin() );
+    t9( &TC, "Streaming form of %zu bytes", formText.size() );
+
+    auto lexer = Lexer( formText, this->symbolInterner );
+    const auto lexResult = lexer.lex();
+    if ( lexResult.error ) {
+        this->m_error = true;
+        return nullptr;
+    }
+
+    auto parser = Parser( formText, lexResult.tokens );
+    auto parseResult = parser.parse();
+    if ( parseResult.error || parseResult.sexprs.size() != 1 ) {
+        this->m_error = true;
+        return nullptr;
+    }
+    return std::move( parseResult.sexprs[ 0 ] );
+}
+
+#ifdef MYL_TEST
+void
+testStreamParser( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Stream top-level forms" );
+
+    { // Chunks much smaller than the forms.
+        int fds[ 2 ];
+        TM42_TEST_ASSERT( ctx, pipe( fds ) == 0 );
+        const std::string src = "(foo 1 (bar 2.5))\n  foo\n(@lbl foo) 42";
+        TM42_TEST_ASSERT( ctx, write( fds[ 1 ], src.data(), src.size() ) ==
+                          ssize_t( src.size() ) );
+        close( fds[ 1 ] );
+
+        auto stream = StreamParser( fds[ 0 ], 3 );
+        const auto foo = stream.symbolInterner->intern( "foo" );
+
+        const auto first = stream.next();
+        const auto firstCons = dynamic_cast< SExpr::Cons * >( first.get() );
+        TM42_TEST_ASSERT( ctx, firstCons );
+        const auto firstCar = dynamic_cast< SExpr::Symbol * >( firstCons->car.get() );
+        TM42_TEST_ASSERT( ctx, firstCar && firstCar->value == foo );
+
+        const auto second = stream.next();
+        const auto secondSym = dynamic_cast< SExpr::Symbol * >( second.get() );
+        TM42_TEST_ASSERT( ctx, secondSym && secondSym->value == foo );
+
+        const auto third = stream.next();
+        TM42_TEST_ASSERT( ctx, dynamic_cast< SExpr::Cons * >( third.get() ) );
+
+        const auto fourth = stream.next();
+        const auto fourthInt = dynamic_cast< SExpr::Int32 * >( fourth.get() );
+        TM42_TEST_ASSERT( ctx, fourthInt && fourthInt->value == 42 );
+
+        TM42_TEST_ASSERT( ctx, stream.next() == nullptr );
+        TM42_TEST_ASSERT( ctx, !stream.error() );
+        TM42_TEST_ASSERT( ctx, stream.bytesConsumed() == src.size() );
+        close( fds[ 0 ] );
+    }
+    { // Unterminated form.
+        int fds[ 2 ];
+        TM42_TEST_ASSERT( ctx, pipe( fds ) == 0 );
+        const std::string src = "(a) (b";
+        TM42_TEST_ASSERT( ctx, write( fds[ 1 ], src.data(), src.size() ) ==
+                          ssize_t( src.size() ) );
+        close( fds[ 1 ] );
+
+        auto stream = StreamParser( fds[ 0 ], 4 );
+        TM42_TEST_ASSERT( ctx, stream.next() != nullptr );
+        TM42_TEST_ASSERT( ctx, stream.next() == nullptr );
+        TM42_TEST_ASSERT( ctx, stream.error() );
+        close( fds[ 0 ] );
+    }
+
+    TM42_END_TEST();
+}
+#endif // MYL_TEST
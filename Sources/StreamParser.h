@@ -0,0 +1,52 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "FormScanner.h"
+#include "Intern.h"
+#include "Parser.h"
+
+// Parses an unbounded input one top-level form at a time. Input is pulled from a
+// file descriptor in fixed-size chunks, and only the bytes of the form currently
+// being parsed (plus at most one chunk of lookahead) are kept in memory. Each form
+// is lexed and parsed on its own, so the token buffer is bounded by the largest
+// form rather than the whole input.
+//
+// All forms share one symbol interner (the global one unless another is given), so
+// symbols are comparable across forms.
+// Source locations reported in errors are relative to the start of the form.
+class StreamParser {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    StreamParser( int fd, size_t chunkSize = DEFAULT_CHUNK_SIZE );
+    StreamParser( int fd, size_t chunkSize,
+                  std::shared_ptr< SymbolInterner > symbolInterner );
+
+    // Parse the next top-level form. Returns null at the end of the input, or if
+    // an error occurred (check `error()` to distinguish the two).
+    std::unique_ptr< SExpr::Base > next();
+
+    bool error() const { return m_error; }
+    // Number of bytes of input consumed so far.
+    size_t bytesConsumed() const { return m_bytesDropped + m_scanner.position(); }
+
+    std::shared_ptr< SymbolInterner > symbolInterner;
+
+private:
+    // Read another chunk into the buffer. Returns false at end of input.
+    bool readChunk();
+    // Drop already-parsed bytes from the front of the buffer, if it is worth it.
+    void compact();
+
+    int m_fd;
+    size_t m_chunkSize;
+    std::string m_buffer;
+    size_t m_bytesDropped = 0;
+    FormScanner m_scanner;
+    bool m_endOfInput = false;
+    bool m_error = false;
+};
@@ -0,0 +1,34 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <Tracing/Tracing.h>
+
+// Compile-time trace levels, for trace calls in hot code.
+//
+// `MYL_TN( ... )` is `tN( ... )` when `MYL_TRACE_LEVEL >= N`. Otherwise it compiles
+// to nothing: the arguments are not evaluated, and no format string is built. Cold
+// code can keep calling `t0`/`t1`/`t9` directly and rely on runtime filtering.
+//
+// -1 removes every hot-path trace.
+#ifndef MYL_TRACE_LEVEL
+#define MYL_TRACE_LEVEL 1
+#endif
+
+#if MYL_TRACE_LEVEL >= 0
+#define MYL_T0( ... ) t0( __VA_ARGS__ )
+#else
+#define MYL_T0( ... ) ( (void)0 )
+#endif
+
+#if MYL_TRACE_LEVEL >= 1
+#define MYL_T1( ... ) t1( __VA_ARGS__ )
+#else
+#define MYL_T1( ... ) ( (void)0 )
+#endif
+
+#if MYL_TRACE_LEVEL >= 9
+#define MYL_T9( ... ) t9( __VA_ARGS__ )
+#else
+#define MYL_T9( ... ) ( (void)0 )
+#endif
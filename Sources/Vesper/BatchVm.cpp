@@ -0,0 +1,231 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+#include "BatchVm.h"
+
+BatchVm::BatchVm( const Vm & vm ) {
+    this->m_scalar.m_code = vm.codeWithoutBreakpoints();
+    this->m_scalar.functionTable = vm.functionTable;
+    this->m_scalar.functionFrameSizeTable = vm.functionFrameSizeTable;
+    this->m_scalar.functionCostTable = vm.functionCostTable;
+    this->m_scalar.labels = vm.labels;
+    this->m_scalar.nativeTable = vm.nativeTable;
+    this->m_scalar.nativeLabels = vm.nativeLabels;
+}
+
+const I32 *
+BatchVm::slot( size_t slot ) const {
+    assert( slot < this->m_topIdx );
+    return this->m_slots.data() + slot * this->m_laneCount;
+}
+
+void
+BatchVm::reserve( size_t amount ) {
+    const size_t slots = this->m_topIdx + amount;
+    if ( this->m_slots.size() < slots * this->m_laneCount ) {
+        this->m_slots.resize( slots * this->m_laneCount, 0 );
+    }
+}
+
+void
+BatchVm::expand( size_t amount ) {
+    this->reserve( amount );
+    this->m_topIdx += amount;
+}
+
+void
+BatchVm::run( size_t functionIdx, size_t laneCount,
+              const std::vector< std::vector< I32 > > & arguments ) {
+    const auto & code = this->m_scalar.m_code;
+    this->m_laneCount = laneCount;
+    this->m_slots.assign( arguments.size() * laneCount, 0 );
+    for ( size_t i = 0; i < arguments.size(); ++i ) {
+        assert( arguments[ i ].size() == laneCount );
+        std::copy( arguments[ i ].begin(), arguments[ i ].end(), this->column( i ) );
+    }
+    this->m_accumulator.assign( laneCount, static_cast< I32 >( arguments.size() ) );
+    this->m_fellBack = false;
+
+    // As if the arguments had been pushed and the function called, returning to
+    // just past the end of the code.
+    this->m_callStack = CallStack();
+    this->m_callStack.push( { code.size(), 0, 0 } );
+    this->m_baseIdx = 0;
+    this->m_topIdx = arguments.size();
+    this->expand( this->m_scalar.functionFrameSizeTable[ functionIdx ] );
+    size_t ip = this->m_scalar.functionTable[ functionIdx ];
+
+    I32 * const acc = this->m_accumulator.data();
+    const size_t n = laneCount;
+    // Wrapping arithmetic, done unsigned so that it is defined.
+    const auto wrapAdd = []( I32 a, I32 b ) {
+        return static_cast< I32 >( static_cast< U32 >( a ) + static_cast< U32 >( b ) );
+    };
+
+    while ( ip < code.size() ) {
+        const auto instruction = code[ ip ];
+        switch ( instruction.op ) {
+        case Opcode::ADD: {
+            const I32 * src = this->column( this->m_baseIdx + instruction.arg );
+            for ( size_t l = 0; l < n; ++l ) {
+                acc[ l ] = wrapAdd( acc[ l ], src[ l ] );
+            }
+            break;
+        }
+        case Opcode::ADD_IMM:
+            for ( size_t l = 0; l < n; ++l ) {
+                acc[ l ] = wrapAdd( acc[ l ], instruction.arg );
+            }
+            break;
+        case Opcode::LOAD:
+            std::memcpy( acc, this->column( this->m_baseIdx + instruction.arg ),
+                         n * sizeof( I32 ) );
+            break;
+        case Opcode::STORE:
+            std::memcpy( this->column( this->m_baseIdx + instruction.arg ), acc,
+                         n * sizeof( I32 ) );
+            break;
+        case Opcode::ZERO_ACC:
+            std::fill( acc, acc + n, 0 );
+            break;
+        case Opcode::EQ:
+        case Opcode::LT:
+        case Opcode::LE: {
+            const I32 * rhs = this->column( this->m_baseIdx + instruction.arg );
+            if ( instruction.op == Opcode::EQ ) {
+                for ( size_t l = 0; l < n; ++l ) {
+                    acc[ l ] = acc[ l ] == rhs[ l ];
+                }
+            } else if ( instruction.op == Opcode::LT ) {
+                for ( size_t l = 0; l < n; ++l ) {
+                    acc[ l ] = acc[ l ] < rhs[ l ];
+                }
+            } else {
+                for ( size_t l = 0; l < n; ++l ) {
+                    acc[ l ] = acc[ l ] <= rhs[ l ];
+                }
+            }
+            break;
+        }
+        case Opcode::JMP:
+            ip += 1 + branchOffset( instruction );
+            continue;
+        case Opcode::JZ:
+        case Opcode::JNZ: {
+            const auto taken = [ & ]( I32 value ) {
+                return ( value == 0 ) == ( instruction.op == Opcode::JZ );
+            };
+            // Lanes that disagree go their own ways.
+            const bool first = n && taken( acc[ 0 ] );
+            if ( std::any_of( acc, acc + n,
+                              [ & ]( I32 value ) { return taken( value ) != first; } ) ) {
+                this->runLanes( ip );
+                return;
+            }
+            ip += 1 + ( first ? branchOffset( instruction ) : 0 );
+            continue;
+        }
+        case Opcode::LOOP: {
+            I32 * counter = this->column( this->m_baseIdx + instruction.arg );
+            // Checked before decrementing, so a divergent LOOP can be rerun per lane.
+            const bool first = n && counter[ 0 ] > 1;
+            if ( std::any_of( counter, counter + n,
+                              [ & ]( I32 count ) { return ( count > 1 ) != first; } ) ) {
+                this->runLanes( ip );
+                return;
+            }
+            for ( size_t l = 0; l < n; ++l ) {
+                counter[ l ] -= 1;
+            }
+            ip += 1 + ( first ? branchOffset( instruction ) : 0 );
+            continue;
+        }
+        case Opcode::ARG:
+        case Opcode::ARG_IMM: {
+            this->expand( 1 );
+            I32 * dst = this->column( this->m_topIdx - 1 );
+            if ( instruction.op == Opcode::ARG ) {
+                std::memcpy( dst, this->column( this->m_baseIdx + instruction.arg ),
+                             n * sizeof( I32 ) );
+            } else {
+                std::fill( dst, dst + n, instruction.arg );
+            }
+            for ( size_t l = 0; l < n; ++l ) {
+                acc[ l ] = wrapAdd( acc[ l ], 1 );
+            }
+            break;
+        }
+        case Opcode::POP:
+            this->m_topIdx -= instruction.arg;
+            break;
+        case Opcode::CALL: {
+            // The argument count decides the frame layout, which all lanes share.
+            const I32 argumentCount = n ? acc[ 0 ] : 0;
+            if ( std::any_of( acc, acc + n,
+                              [ & ]( I32 count ) { return count != argumentCount; } ) ) {
+                this->runLanes( ip );
+                return;
+            }
+            const size_t frameBase = this->m_topIdx - argumentCount;
+            this->m_callStack.push( { ip + 1, this->m_baseIdx, frameBase } );
+            this->m_baseIdx = frameBase;
+            this->expand( this->m_scalar.functionFrameSizeTable[ instruction.arg ] );
+            ip = this->m_scalar.functionTable[ instruction.arg ];
+            continue;
+        }
+        case Opcode::RET: {
+            const auto frame = this->m_callStack.pop();
+            this->m_baseIdx = frame.sbp;
+            this->m_topIdx = frame.sp + instruction.arg;
+            ip = frame.ip;
+            continue;
+        }
+        default:
+            this->runLanes( ip );
+            return;
+        }
+        ip += 1;
+    }
+}
+
+void
+BatchVm::runLanes( size_t ip ) {
+    this->m_fellBack = true;
+    auto & vm = this->m_scalar;
+    const size_t slotCount =
+        this->m_slots.size() / std::max< size_t >( this->m_laneCount, 1 );
+    size_t finalTop = 0;
+    for ( size_t l = 0; l < this->m_laneCount; ++l ) {
+        vm.m_stack.m_stack.assign( slotCount, 0 );
+        vm.m_stack.m_isRef.assign( slotCount, false );
+        for ( size_t s = 0; s < slotCount; ++s ) {
+            vm.m_stack.m_stack[ s ] = this->m_slots[ s * this->m_laneCount + l ];
+        }
+        vm.m_stack.m_baseIdx = this->m_baseIdx;
+        vm.m_stack.m_topIdx = this->m_topIdx;
+        vm.setAccumulator( this->m_accumulator[ l ] );
+        vm.callStack = this->m_callStack;
+        vm.m_nextInstructionIdx = ip;
+        // `m_scalar` has no limits and unlimited fuel, so never stops early.
+        while ( vm.m_nextInstructionIdx < vm.m_code.size() ) {
+            vm.executeNextInstruction();
+        }
+
+        // Every lane returns from the same outermost frame, so ends with the same
+        // number of slots.
+        finalTop = vm.m_stack.m_topIdx;
+        const size_t needed = finalTop * this->m_laneCount;
+        if ( this->m_slots.size() < needed ) {
+            this->m_slots.resize( needed, 0 );
+        }
+        for ( size_t s = 0; s < finalTop; ++s ) {
+            this->m_slots[ s * this->m_laneCount + l ] = vm.m_stack.m_stack[ s ].i32;
+        }
+        this->m_accumulator[ l ] = vm.accumulatorValue().i32;
+    }
+    this->m_baseIdx = 0;
+    this->m_topIdx = finalTop;
+}
@@ -0,0 +1,67 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <vector>
+
+#include "Vm.h"
+
+// Runs one function of a `Vm` over many independent argument tuples ("lanes") at
+// once.
+//
+// Lanes are stored column-wise: each stack slot, and the accumulator, is an array
+// with one value per lane. Each instruction is executed for every lane before the
+// next one is dispatched, so dispatch is paid once per batch rather than once per
+// lane, and the per-opcode loops (`LOAD`, `STORE`, `ADD`, ...) are simple enough to
+// vectorize.
+//
+// This only works while every lane takes the same path through the code. When they
+// would diverge (e.g. a `JZ` taken by only some lanes, or `CALL` with a different
+// argument count per lane), or at an opcode with no lane-parallel form (heap and
+// vector opcodes), the batch falls back to running the rest of each lane on its own,
+// with an ordinary `Vm`.
+//
+// Lanes don't share a heap with the `Vm`, nor keep theirs past the call, so results
+// must be integers.
+class BatchVm {
+public:
+    // Code and function tables are copied out of `vm`, without its breakpoints.
+    explicit BatchVm( const Vm & vm );
+
+    // Calls function `functionIdx` once per lane, `arguments[ i ][ lane ]` being
+    // argument i of `lane`. Each argument column must have `laneCount` values.
+    void run( size_t functionIdx, size_t laneCount,
+              const std::vector< std::vector< I32 > > & arguments );
+
+    // Results of the last `run()`, one value per lane: the accumulator, and each
+    // of the slots left on the stack (e.g. the return value, with `RET 1`).
+    const I32 * accumulator() const { return m_accumulator.data(); }
+    const I32 * slot( size_t slot ) const;
+    size_t slotCount() const { return m_topIdx; }
+
+    // Whether the last `run()` had to finish lane by lane.
+    bool fellBack() const { return m_fellBack; }
+
+private:
+    I32 *
+    column( size_t absoluteSlot ) {
+        return this->m_slots.data() + absoluteSlot * this->m_laneCount;
+    }
+    // Make room for `amount` slots above the top / grow the top by `amount`, like
+    // `DataStack`.
+    void reserve( size_t amount );
+    void expand( size_t amount );
+    // Finishes the call for each lane on its own, starting at instruction `ip`.
+    void runLanes( size_t ip );
+
+    Vm m_scalar;
+    size_t m_laneCount = 0;
+    // Slot s of lane l is `m_slots[ s * m_laneCount + l ]`.
+    std::vector< I32 > m_slots;
+    std::vector< I32 > m_accumulator;
+    size_t m_baseIdx = 0;
+    size_t m_topIdx = 0;
+    // The same for every lane.
+    CallStack m_callStack;
+    bool m_fellBack = false;
+};
@@ -1,5 +1,6 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
 #include <assert.h>
 
 #include "Bytecode.h"
@@ -17,12 +18,46 @@ operator<<( std::ostream & os, Opcode op ) {
         return os << "STORE";
     case Opcode::ZERO_ACC:
         return os << "ZERO_ACC";
+    case Opcode::CONS:
+        return os << "CONS";
+    case Opcode::CAR:
+        return os << "CAR";
+    case Opcode::CDR:
+        return os << "CDR";
+    case Opcode::VADD:
+        return os << "VADD";
+    case Opcode::VMUL:
+        return os << "VMUL";
+    case Opcode::VSUM:
+        return os << "VSUM";
+    case Opcode::VDOT:
+        return os << "VDOT";
+    case Opcode::EQ:
+        return os << "EQ";
+    case Opcode::LT:
+        return os << "LT";
+    case Opcode::LE:
+        return os << "LE";
+    case Opcode::JMP:
+        return os << "JMP";
+    case Opcode::JZ:
+        return os << "JZ";
+    case Opcode::JNZ:
+        return os << "JNZ";
+    case Opcode::LOOP:
+        return os << "LOOP";
     case Opcode::ARG:
         return os << "ARG";
     case Opcode::ARG_IMM:
         return os << "ARG_IMM";
+    case Opcode::POP:
+        return os << "POP";
+    case Opcode::BREAK:
+        return os << "BREAK";
     case Opcode::CALL:
         return os << "CALL";
+    case Opcode::CALL_NATIVE:
+        return os << "CALL_NATIVE";
     case Opcode::RET:
         return os << "RET";
     default:
@@ -30,7 +65,69 @@ operator<<( std::ostream & os, Opcode op ) {
     };
 }
 
+bool
+isBranch( Opcode op ) {
+    switch ( op ) {
+    case Opcode::JMP:
+    case Opcode::JZ:
+    case Opcode::JNZ:
+    case Opcode::LOOP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::vector< size_t >
+reachableFrom( const std::vector< Bytecode > & code, size_t entry ) {
+    if ( entry >= code.size() ) {
+        return {};
+    }
+    std::vector< bool > seen( code.size(), false );
+    std::vector< size_t > worklist = { entry };
+    seen[ entry ] = true;
+    std::vector< size_t > body;
+    while ( !worklist.empty() ) {
+        const size_t idx = worklist.back();
+        worklist.pop_back();
+        body.push_back( idx );
+        const Opcode op = code[ idx ].op;
+        size_t successors[ 2 ];
+        size_t successorCount = 0;
+        if ( op != Opcode::RET && op != Opcode::JMP ) {
+            successors[ successorCount++ ] = idx + 1;
+        }
+        if ( isBranch( op ) ) {
+            successors[ successorCount++ ] = branchTarget( idx, code[ idx ] );
+        }
+        for ( size_t i = 0; i < successorCount; ++i ) {
+            if ( successors[ i ] >= code.size() ) {
+                return {};
+            }
+            if ( !seen[ successors[ i ] ] ) {
+                seen[ successors[ i ] ] = true;
+                worklist.push_back( successors[ i ] );
+            }
+        }
+    }
+    std::sort( body.begin(), body.end() );
+    return body;
+}
+
 std::ostream &
 operator<<( std::ostream & os, Bytecode bytecode ) {
-    return os << bytecode.op << " " << int( bytecode.arg );
+    os << bytecode.op << " " << int( bytecode.arg );
+    switch ( bytecode.op ) {
+    case Opcode::VADD:
+    case Opcode::VMUL:
+    case Opcode::VDOT:
+        return os << " " << bytecode.arg2;
+    case Opcode::JMP:
+    case Opcode::JZ:
+    case Opcode::JNZ:
+    case Opcode::LOOP:
+        return os << " " << std::showpos << branchOffset( bytecode ) << std::noshowpos;
+    default:
+        return os;
+    }
 }
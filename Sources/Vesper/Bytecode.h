@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <vector>
 
 using U8 = std::uint8_t;
+using U16 = std::uint16_t;
+using I16 = std::int16_t;
 
 enum class Opcode : U8 {
     ADD,
@@ -14,10 +17,53 @@ enum class Opcode : U8 {
     LOAD,
     STORE,
     ZERO_ACC,
+    // --- begin heap ---------------------------------------------------------------
+    // ACC = a new cons cell, with the slot as its car and ACC as its cdr.
+    CONS,
+    // ACC = the car/cdr of the cons cell in ACC.
+    CAR,
+    CDR,
+    // --- end heap -----------------------------------------------------------------
+    // --- begin vector -------------------------------------------------------------
+    // Each operates on slices of ACC slots, starting at `arg` (and `arg2`). The
+    // slices of VADD and VMUL must be the same or not overlap. ACC is unchanged
+    // unless it is the result.
+    // slots[ arg + i ] += slots[ arg2 + i ]
+    VADD,
+    // slots[ arg + i ] *= slots[ arg2 + i ]
+    VMUL,
+    // ACC = sum of slots[ arg + i ]
+    VSUM,
+    // ACC = sum of slots[ arg + i ] * slots[ arg2 + i ]
+    VDOT,
+    // --- end vector ---------------------------------------------------------------
+    // --- begin compare ------------------------------------------------------------
+    // ACC = 1 if the comparison of ACC with the slot holds, else 0.
+    EQ,
+    LT,
+    LE,
+    // --- end compare --------------------------------------------------------------
     // --- begin control flow -------------------------------------------------------
+    // Branches go `branchOffset()` instructions from the one after the branch, and
+    // stay within the current function.
+    JMP,
+    // Branch if ACC is zero/nonzero.
+    JZ,
+    JNZ,
+    // Decrement the slot, and branch if it is still positive. A counted loop puts
+    // its body right before the LOOP, branching back to the start of it.
+    LOOP,
     ARG,
     ARG_IMM,
+    // Drop the top `arg` slots, e.g. the arguments of an inlined call.
+    POP,
+    // Stands in for the instruction at a breakpoint; see `Vm::setBreakpoint()`.
+    BREAK,
     CALL,
+    // Like CALL, but of the native function `arg` (see `Vm::registerNative()`),
+    // which gets the arguments in place and returns in ACC. The arguments are
+    // popped.
+    CALL_NATIVE,
     RET
     // --- end control flow ---------------------------------------------------------
 };
@@ -27,6 +73,31 @@ std::ostream & operator<<( std::ostream & os, Opcode op );
 struct Bytecode {
     Opcode op;
     U8 arg;
+    // Only used by opcodes with two operands.
+    U16 arg2 = 0;
 };
 
+inline bool
+operator==( Bytecode a, Bytecode b ) {
+    return a.op == b.op && a.arg == b.arg && a.arg2 == b.arg2;
+}
+
+bool isBranch( Opcode op );
+// Branches keep their offset in `arg2`.
+inline I16
+branchOffset( Bytecode bytecode ) {
+    return static_cast< I16 >( bytecode.arg2 );
+}
+// Where the branch at `idx` goes.
+inline size_t
+branchTarget( size_t idx, Bytecode bytecode ) {
+    return static_cast< size_t >( static_cast< std::ptrdiff_t >( idx ) + 1 +
+                                  branchOffset( bytecode ) );
+}
+
+// The instructions reachable from `entry` without returning, in code order: a
+// function's body, when `entry` is its start. Empty if control could run off either
+// end of the code.
+std::vector< size_t > reachableFrom( const std::vector< Bytecode > & code, size_t entry );
+
 std::ostream & operator<<( std::ostream & os, Bytecode bytecode );
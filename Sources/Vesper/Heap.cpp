@@ -0,0 +1,229 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+
+#include "Heap.h"
+
+Heap::Heap(): Heap( Config() ) {}
+
+Heap::Heap( Config config )
+    : m_config( config ),
+      // Any object fits in an empty nursery, so everything is allocated there.
+      m_nursery( std::max< size_t >( config.nurseryBytes / sizeof( U32 ),
+                                     2 + MAX_FIELDS ) ),
+      m_tenured( 1 ),
+      m_majorThresholdWords( config.majorThresholdBytes / sizeof( U32 ) ) {}
+
+const U32 *
+Heap::object( Register ref ) const {
+    assert( ref.ref != 0 );
+    return ( ref.ref & TENURED_BIT ) ? &this->m_tenured[ ref.ref & ~TENURED_BIT ]
+                                     : &this->m_nursery[ ref.ref ];
+}
+
+U32 *
+Heap::object( Register ref ) {
+    return const_cast< U32 * >( static_cast< const Heap * >( this )->object( ref ) );
+}
+
+Register
+Heap::allocate( U32 fieldCount, const HeapRoots & roots ) {
+    assert( fieldCount <= MAX_FIELDS );
+    // A forwarded object keeps its new address in its first word after the header.
+    const size_t words = 1 + std::max< U32 >( fieldCount, 1 );
+    this->m_stats.bytesAllocated += words * sizeof( U32 );
+
+    if ( this->m_nurseryTop + words > this->m_nursery.size() ) {
+        this->collect( roots, false );
+    }
+    Register ref( 0 );
+    ref.ref = static_cast< U32 >( this->m_nurseryTop );
+    this->m_nurseryTop += words;
+    U32 * obj = &this->m_nursery[ ref.ref ];
+    obj[ 0 ] = header( fieldCount, 0 );
+    std::fill( obj + 1, obj + words, 0 );
+    return ref;
+}
+
+void
+Heap::setField( Register ref, U32 field, Register value, bool isRef ) {
+    U32 * obj = this->object( ref );
+    assert( field < headerFieldCount( obj[ 0 ] ) );
+    const U32 refMask = ( headerRefMask( obj[ 0 ] ) & ~( 1u << field ) ) |
+        ( U32( isRef ) << field );
+    obj[ 0 ] = header( headerFieldCount( obj[ 0 ] ), refMask );
+    obj[ 1 + field ] = value.ref;
+}
+
+Register
+Heap::field( Register ref, U32 field ) const {
+    const U32 * obj = this->object( ref );
+    assert( field < headerFieldCount( obj[ 0 ] ) );
+    Register value( 0 );
+    value.ref = obj[ 1 + field ];
+    return value;
+}
+
+bool
+Heap::fieldIsRef( Register ref, U32 field ) const {
+    return ( headerRefMask( this->object( ref )[ 0 ] ) >> field ) & 1;
+}
+
+U32
+Heap::fieldCount( Register ref ) const {
+    return headerFieldCount( this->object( ref )[ 0 ] );
+}
+
+U32
+Heap::evacuate( U32 ref, std::vector< U32 > & to, bool fromTenured ) {
+    if ( ( ref & TENURED_BIT ) && !fromTenured ) {
+        return ref;
+    }
+    Register from( 0 );
+    from.ref = ref;
+    U32 * obj = this->object( from );
+    if ( obj[ 0 ] & FORWARDED ) {
+        return obj[ 1 ];
+    }
+    const size_t words = 1 + std::max< U32 >( headerFieldCount( obj[ 0 ] ), 1 );
+    const U32 newRef = static_cast< U32 >( to.size() ) | TENURED_BIT;
+    to.insert( to.end(), obj, obj + words );
+    obj[ 0 ] = FORWARDED;
+    obj[ 1 ] = newRef;
+    return newRef;
+}
+
+void
+Heap::evacuateRoots( const HeapRoots & roots, std::vector< U32 > & to,
+                     bool fromTenured ) {
+    for ( size_t i = 0; i < roots.slotCount; ++i ) {
+        if ( roots.slotIsRef[ i ] ) {
+            roots.slots[ i ].ref =
+                this->evacuate( roots.slots[ i ].ref, to, fromTenured );
+        }
+    }
+    if ( roots.accumulatorIsRef ) {
+        roots.accumulator->ref =
+            this->evacuate( roots.accumulator->ref, to, fromTenured );
+    }
+}
+
+void
+Heap::scan( std::vector< U32 > & to, size_t scan, bool fromTenured ) {
+    // `to` may grow (and move) while we scan it, so no pointers into it are kept.
+    while ( scan < to.size() ) {
+        const U32 objHeader = to[ scan ];
+        const U32 fieldCount = headerFieldCount( objHeader );
+        for ( U32 mask = headerRefMask( objHeader ); mask; mask &= mask - 1 ) {
+            const size_t fieldIdx = scan + 1 + __builtin_ctz( mask );
+            const U32 newRef = this->evacuate( to[ fieldIdx ], to, fromTenured );
+            to[ fieldIdx ] = newRef;
+        }
+        scan += 1 + std::max< U32 >( fieldCount, 1 );
+    }
+}
+
+void
+Heap::minor( const HeapRoots & roots ) {
+    const size_t tenuredBefore = this->m_tenured.size();
+    this->evacuateRoots( roots, this->m_tenured, false );
+    // Objects that were already tenured can't point into the nursery, so only the
+    // newly promoted ones need scanning.
+    this->scan( this->m_tenured, tenuredBefore, false );
+    this->m_nurseryTop = 1;
+    this->m_stats.minorCollections += 1;
+    this->m_stats.bytesPromoted +=
+        ( this->m_tenured.size() - tenuredBefore ) * sizeof( U32 );
+}
+
+void
+Heap::major( const HeapRoots & roots ) {
+    // The nursery is empty, so everything live is tenured.
+    std::vector< U32 > to;
+    to.reserve( this->m_tenured.size() );
+    to.push_back( 0 );
+    this->evacuateRoots( roots, to, true );
+    this->scan( to, 1, true );
+    this->m_tenured = std::move( to );
+    this->m_majorThresholdWords =
+        std::max( this->m_config.majorThresholdBytes / sizeof( U32 ),
+                  2 * this->m_tenured.size() );
+    this->m_stats.majorCollections += 1;
+    this->m_stats.bytesSurvivedMajor += this->tenuredBytesUsed();
+}
+
+void
+Heap::collect( const HeapRoots & roots, bool major ) {
+    const auto start = std::chrono::steady_clock::now();
+    this->minor( roots );
+    if ( major || this->m_tenured.size() > this->m_majorThresholdWords ) {
+        this->major( roots );
+    }
+    this->recordPause( std::chrono::duration_cast< std::chrono::nanoseconds >(
+                           std::chrono::steady_clock::now() - start ).count() );
+}
+
+void
+Heap::restoreTenured( const U32 * words, size_t wordCount ) {
+    assert( wordCount >= 1 );
+    this->m_tenured.assign( words, words + wordCount );
+    this->m_nurseryTop = 1;
+    this->m_majorThresholdWords =
+        std::max( this->m_config.majorThresholdBytes / sizeof( U32 ),
+                  2 * this->m_tenured.size() );
+}
+
+bool
+Heap::isValidTenured( const U32 * words, size_t wordCount,
+                       const std::vector< U32 > & roots ) {
+    if ( wordCount == 0 ) {
+        return false;
+    }
+    std::vector< bool > isStart( wordCount, false );
+    size_t idx = 1;
+    while ( idx < wordCount ) {
+        const U32 objHeader = words[ idx ];
+        const U32 fieldCount = headerFieldCount( objHeader );
+        if ( ( objHeader & FORWARDED ) || fieldCount > MAX_FIELDS ||
+             headerRefMask( objHeader ) >> fieldCount ) {
+            return false;
+        }
+        const size_t size = 1 + std::max< U32 >( fieldCount, 1 );
+        if ( size > wordCount - idx ) {
+            return false;
+        }
+        isStart[ idx ] = true;
+        idx += size;
+    }
+
+    const auto isObject = [ & ]( U32 ref ) {
+        return ( ref & TENURED_BIT ) && ( ref & ~TENURED_BIT ) < wordCount &&
+               isStart[ ref & ~TENURED_BIT ];
+    };
+    for ( const auto ref : roots ) {
+        if ( !isObject( ref ) ) {
+            return false;
+        }
+    }
+    for ( idx = 1; idx < wordCount; ++idx ) {
+        if ( !isStart[ idx ] ) {
+            continue;
+        }
+        for ( U32 mask = headerRefMask( words[ idx ] ); mask; mask &= mask - 1 ) {
+            if ( !isObject( words[ idx + 1 + __builtin_ctz( mask ) ] ) ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+Heap::recordPause( U64 nanos ) {
+    this->m_stats.totalPauseNanos += nanos;
+    this->m_stats.maxPauseNanos = std::max( this->m_stats.maxPauseNanos, nanos );
+    const int bucket = nanos ? 64 - __builtin_clzll( nanos ) : 0;
+    this->m_stats.pauseHistogram[ std::min( bucket, PAUSE_BUCKET_COUNT - 1 ) ] += 1;
+}
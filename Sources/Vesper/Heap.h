@@ -0,0 +1,127 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <vector>
+
+#include "Value.h"
+
+// Everything a collection has to find and update: the data stack, with a parallel
+// array saying which slots hold references, and the accumulator. Call frames only
+// hold stack indices, so the stack covers them.
+struct HeapRoots {
+    Register * slots;
+    const std::uint8_t * slotIsRef;
+    size_t slotCount;
+    Register * accumulator;
+    bool accumulatorIsRef;
+};
+
+// Garbage-collected storage for heap objects, such as cons cells.
+//
+// There are two generations. New objects are bump-allocated in a fixed-size
+// nursery; when it fills up, a minor collection copies the objects reachable from
+// the roots into the tenured space (so an object is promoted the first time it
+// survives), and empties the nursery. When the tenured space has grown past a
+// threshold, a major collection copies its live objects into a fresh space. Both
+// are Cheney-style copying collections, and a minor pause is bounded by the
+// nursery's live data, not by the size of the heap.
+//
+// Objects are immutable once initialized, so a tenured object never points into
+// the nursery and no write barrier or remembered set is needed.
+//
+// An object is a header word followed by up to `MAX_FIELDS` 32-bit fields; the
+// header holds the field count and which fields are references. A reference is
+// the object's word index in its space, with the top bit set for the tenured space.
+// Word 0 of each space is never used, so no reference is 0.
+class Heap {
+public:
+    struct Config {
+        size_t nurseryBytes = 256 * 1024;
+        // Minimum tenured size that triggers a major collection. After each one,
+        // the threshold becomes twice what survived, if that is larger.
+        size_t majorThresholdBytes = 4 * 1024 * 1024;
+    };
+
+    static constexpr int PAUSE_BUCKET_COUNT = 64;
+    struct Stats {
+        U64 minorCollections = 0;
+        U64 majorCollections = 0;
+        U64 bytesAllocated = 0;
+        // Copied from the nursery into the tenured space.
+        U64 bytesPromoted = 0;
+        // Copied by major collections.
+        U64 bytesSurvivedMajor = 0;
+        U64 totalPauseNanos = 0;
+        U64 maxPauseNanos = 0;
+        // Bucket i counts pauses of bit width i, in nanoseconds: 0, 1, 2-3, 4-7, ...
+        U64 pauseHistogram[ PAUSE_BUCKET_COUNT ] = {};
+    };
+
+    static constexpr U32 TENURED_BIT = 0x80000000u;
+    static constexpr U32 MAX_FIELDS = 15;
+    static constexpr U32 CONS_FIELDS = 2;
+
+    Heap();
+    explicit Heap( Config config );
+
+    // Returns a new object with `fieldCount` integer zero fields, collecting first
+    // if the nursery is full. References in `roots` may change; references held
+    // anywhere else are invalid afterwards.
+    Register allocate( U32 fieldCount, const HeapRoots & roots );
+    // Only for initializing a fresh object (see above).
+    void setField( Register ref, U32 field, Register value, bool isRef );
+
+    Register field( Register ref, U32 field ) const;
+    bool fieldIsRef( Register ref, U32 field ) const;
+    U32 fieldCount( Register ref ) const;
+
+    void collect( const HeapRoots & roots, bool major );
+
+    const Stats & stats() const { return m_stats; }
+    size_t nurseryBytesUsed() const { return ( m_nurseryTop - 1 ) * sizeof( U32 ); }
+    size_t tenuredBytesUsed() const { return ( m_tenured.size() - 1 ) * sizeof( U32 ); }
+
+    // For VM images. After a major collection everything live is in the tenured
+    // space, and that is all an image needs to hold.
+    const std::vector< U32 > & tenuredWords() const { return m_tenured; }
+    // Replaces the whole heap with an empty nursery and the given tenured space.
+    void restoreTenured( const U32 * words, size_t wordCount );
+    // Whether `words` could be from `tenuredWords()`: whole objects after word 0,
+    // with well-formed headers, whose reference fields and `roots` all point to
+    // the start of one of them.
+    static bool isValidTenured( const U32 * words, size_t wordCount,
+                                const std::vector< U32 > & roots );
+
+private:
+    static constexpr U32 FORWARDED = 1;
+
+    static U32
+    header( U32 fieldCount, U32 refMask ) {
+        return fieldCount << 16 | refMask << 1;
+    }
+    static U32 headerFieldCount( U32 header ) { return header >> 16; }
+    static U32 headerRefMask( U32 header ) { return ( header >> 1 ) & 0x7fff; }
+
+    const U32 * object( Register ref ) const;
+    U32 * object( Register ref );
+    // Copies the object `ref` refers to into `to` (tenured) unless it was already
+    // copied, and returns its new reference. Only objects in a space being
+    // evacuated are copied; `fromTenured` says whether that includes tenured ones.
+    U32 evacuate( U32 ref, std::vector< U32 > & to, bool fromTenured );
+    void evacuateRoots( const HeapRoots & roots, std::vector< U32 > & to,
+                        bool fromTenured );
+    // Evacuates the referents of every object in `to` from `scan` on, including
+    // those evacuated along the way.
+    void scan( std::vector< U32 > & to, size_t scan, bool fromTenured );
+    void minor( const HeapRoots & roots );
+    void major( const HeapRoots & roots );
+    void recordPause( U64 nanos );
+
+    Config m_config;
+    std::vector< U32 > m_nursery;
+    size_t m_nurseryTop = 1;
+    std::vector< U32 > m_tenured;
+    size_t m_majorThresholdWords;
+    Stats m_stats;
+};
@@ -0,0 +1,511 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <algorithm>
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Inliner.h"
+
+namespace {
+
+constexpr size_t UNKNOWN = SIZE_MAX;
+// Operands are one byte.
+constexpr size_t MAX_OPERAND = 255;
+
+bool
+usesSlot( Opcode op ) {
+    switch ( op ) {
+    case Opcode::ADD:
+    case Opcode::LOAD:
+    case Opcode::STORE:
+    case Opcode::CONS:
+    case Opcode::EQ:
+    case Opcode::LT:
+    case Opcode::LE:
+    case Opcode::LOOP:
+    case Opcode::ARG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool
+isVector( Opcode op ) {
+    switch ( op ) {
+    case Opcode::VADD:
+    case Opcode::VMUL:
+    case Opcode::VSUM:
+    case Opcode::VDOT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// What is known about a function's stack before each of its instructions.
+struct Flow {
+    // Slots above the frame base.
+    std::unordered_map< size_t, size_t > depth;
+    // The argument count in ACC, or UNKNOWN.
+    std::unordered_map< size_t, size_t > argumentCount;
+};
+
+// Follows a function from `entry`, where `entryDepth` slots are in use.
+// `returnCounts[ f ]` is how many slots function f leaves on the stack, if known.
+// Fails if some depth can't be known: after a `CALL` with an unknown argument count,
+// or where two paths meet at different depths.
+std::optional< Flow >
+follow( const std::vector< Bytecode > & code, size_t entry, size_t entryDepth,
+        const std::vector< size_t > & returnCounts ) {
+    Flow flow;
+    std::vector< size_t > worklist;
+    // Returns false on a conflicting depth.
+    const auto reach = [ & ]( size_t idx, size_t depth, size_t argumentCount ) {
+        const auto found = flow.depth.find( idx );
+        if ( found == flow.depth.end() ) {
+            flow.depth[ idx ] = depth;
+            flow.argumentCount[ idx ] = argumentCount;
+            worklist.push_back( idx );
+            return true;
+        }
+        if ( found->second != depth ) {
+            return false;
+        }
+        auto & known = flow.argumentCount[ idx ];
+        if ( known != argumentCount && known != UNKNOWN ) {
+            known = UNKNOWN;
+            worklist.push_back( idx );
+        }
+        return true;
+    };
+
+    reach( entry, entryDepth, UNKNOWN );
+    while ( !worklist.empty() ) {
+        const size_t idx = worklist.back();
+        worklist.pop_back();
+        const auto instruction = code[ idx ];
+        size_t depth = flow.depth[ idx ];
+        size_t argumentCount = flow.argumentCount[ idx ];
+        switch ( instruction.op ) {
+        case Opcode::ZERO_ACC:
+            argumentCount = 0;
+            break;
+        case Opcode::ARG:
+        case Opcode::ARG_IMM:
+            depth += 1;
+            if ( argumentCount != UNKNOWN ) {
+                argumentCount += 1;
+            }
+            break;
+        case Opcode::STORE:
+        case Opcode::VADD:
+        case Opcode::VMUL:
+        case Opcode::JMP:
+        case Opcode::JZ:
+        case Opcode::JNZ:
+        case Opcode::LOOP:
+            break;
+        case Opcode::POP:
+            if ( depth < instruction.arg ) {
+                return std::nullopt;
+            }
+            depth -= instruction.arg;
+            break;
+        case Opcode::CALL:
+            if ( argumentCount == UNKNOWN || depth < argumentCount ||
+                 instruction.arg >= returnCounts.size() ||
+                 returnCounts[ instruction.arg ] == UNKNOWN ) {
+                return std::nullopt;
+            }
+            depth = depth - argumentCount + returnCounts[ instruction.arg ];
+            argumentCount = UNKNOWN;
+            break;
+        case Opcode::CALL_NATIVE:
+            if ( argumentCount == UNKNOWN || depth < argumentCount ) {
+                return std::nullopt;
+            }
+            depth -= argumentCount;
+            argumentCount = UNKNOWN;
+            break;
+        case Opcode::RET:
+            continue;
+        default:
+            argumentCount = UNKNOWN;
+            break;
+        }
+        bool ok = true;
+        if ( instruction.op != Opcode::JMP ) {
+            ok = ok && idx + 1 < code.size() && reach( idx + 1, depth, argumentCount );
+        }
+        if ( isBranch( instruction.op ) ) {
+            const size_t target = branchTarget( idx, code[ idx ] );
+            ok = ok && target < code.size() && reach( target, depth, argumentCount );
+        }
+        if ( !ok ) {
+            return std::nullopt;
+        }
+    }
+    return flow;
+}
+
+struct Callee {
+    size_t functionIdx;
+    // Of the call site.
+    size_t argumentCount;
+    Flow flow;
+};
+
+struct Site {
+    size_t callIdx;
+    // Where, relative to the caller's frame base, the callee's frame would start.
+    size_t calleeBase;
+    const Callee * callee;
+};
+
+struct Caller {
+    // Slots below this are the caller's arguments and locals; those above were
+    // pushed, and move up by `extraFrame`.
+    size_t pushedFrom = 0;
+    size_t extraFrame = 0;
+    std::vector< Site > sites;
+};
+
+} // namespace
+
+Inliner::Inliner(): Inliner( Config() ) {}
+
+Inliner::Inliner( Config config ): m_config( std::move( config ) ) {}
+
+Inliner::Stats
+Inliner::run( Vm & vm ) const {
+    assert( vm.callStack.frames.empty() && vm.breakpointCount() == 0 );
+    const auto & code = vm.m_code;
+    const size_t functionCount = vm.functionTable.size();
+    Stats stats;
+    stats.instructionsBefore = code.size();
+
+    std::vector< std::vector< size_t > > bodies( functionCount );
+    std::vector< size_t > returnCounts( functionCount, UNKNOWN );
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        bodies[ f ] = reachableFrom( code, vm.functionTable[ f ] );
+        for ( const size_t idx : bodies[ f ] ) {
+            if ( code[ idx ].op != Opcode::RET ) {
+                continue;
+            }
+            if ( returnCounts[ f ] == UNKNOWN ) {
+                returnCounts[ f ] = code[ idx ].arg;
+            } else if ( returnCounts[ f ] != code[ idx ].arg ) {
+                returnCounts[ f ] = UNKNOWN;
+                break;
+            }
+        }
+    }
+
+    // A caller's code is rewritten in place, so it must not share any with another
+    // function.
+    std::vector< size_t > owner( code.size(), UNKNOWN );
+    std::vector< bool > exclusive( functionCount, true );
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        for ( const size_t idx : bodies[ f ] ) {
+            if ( owner[ idx ] != UNKNOWN ) {
+                exclusive[ f ] = false;
+                exclusive[ owner[ idx ] ] = false;
+            }
+            owner[ idx ] = f;
+        }
+    }
+
+    // Arities, from the argument counts at each function's call sites. Only ACC
+    // matters for those, so any entry depth will do.
+    std::vector< size_t > arities( functionCount, UNKNOWN );
+    std::vector< bool > arityKnown( functionCount, true );
+    const auto noteCall = [ & ]( size_t callee, size_t argumentCount ) {
+        if ( callee >= functionCount ) {
+            return;
+        }
+        if ( argumentCount == UNKNOWN ||
+             ( arities[ callee ] != UNKNOWN && arities[ callee ] != argumentCount ) ) {
+            arityKnown[ callee ] = false;
+        }
+        arities[ callee ] = argumentCount;
+    };
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        const auto flow =
+            follow( code, vm.functionTable[ f ], MAX_OPERAND + 1, returnCounts );
+        for ( const size_t idx : bodies[ f ] ) {
+            if ( code[ idx ].op == Opcode::CALL ) {
+                noteCall( code[ idx ].arg,
+                          flow ? flow->argumentCount.at( idx ) : UNKNOWN );
+            }
+        }
+    }
+    // Calls from code outside any function, e.g. at the top level.
+    for ( size_t idx = 0; idx < code.size(); ++idx ) {
+        if ( owner[ idx ] == UNKNOWN && code[ idx ].op == Opcode::CALL ) {
+            noteCall( code[ idx ].arg, UNKNOWN );
+        }
+    }
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        if ( !arityKnown[ f ] ) {
+            arities[ f ] = UNKNOWN;
+        }
+    }
+    for ( const auto & [ label, arity ] : this->m_config.entryArities ) {
+        const auto found = vm.labels.find( label );
+        if ( found != vm.labels.end() && found->second < functionCount ) {
+            arities[ found->second ] = arity;
+        }
+    }
+
+    // Which callees could be inlined anywhere: small, not recursive, and without
+    // vector opcodes (whose slices would straddle the remapped slots).
+    std::vector< std::vector< size_t > > calls( functionCount );
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        for ( const size_t idx : bodies[ f ] ) {
+            if ( code[ idx ].op == Opcode::CALL && code[ idx ].arg < functionCount ) {
+                calls[ f ].push_back( code[ idx ].arg );
+            }
+        }
+    }
+    const auto isRecursive = [ & ]( size_t g ) {
+        std::vector< bool > seen( functionCount, false );
+        std::vector< size_t > worklist = calls[ g ];
+        while ( !worklist.empty() ) {
+            const size_t f = worklist.back();
+            worklist.pop_back();
+            if ( f == g ) {
+                return true;
+            }
+            if ( !seen[ f ] ) {
+                seen[ f ] = true;
+                worklist.insert( worklist.end(), calls[ f ].begin(), calls[ f ].end() );
+            }
+        }
+        return false;
+    };
+    std::vector< bool > inlinable( functionCount, false );
+    for ( size_t g = 0; g < functionCount; ++g ) {
+        inlinable[ g ] = !bodies[ g ].empty() &&
+            bodies[ g ].size() <= this->m_config.maxCalleeInstructions &&
+            returnCounts[ g ] != UNKNOWN &&
+            std::none_of( bodies[ g ].begin(), bodies[ g ].end(),
+                          [ & ]( size_t idx ) { return isVector( code[ idx ].op ); } ) &&
+            !isRecursive( g );
+    }
+
+    // Each callee is followed once per argument count it is called with.
+    std::map< std::pair< size_t, size_t >, std::optional< Callee > > callees;
+    const auto calleeFor = [ & ]( size_t g, size_t argumentCount ) -> const Callee * {
+        auto [ it, inserted ] = callees.try_emplace( { g, argumentCount } );
+        if ( inserted ) {
+            auto flow = follow( code, vm.functionTable[ g ],
+                                argumentCount + vm.functionFrameSizeTable[ g ],
+                                returnCounts );
+            if ( flow ) {
+                it->second = Callee{ g, argumentCount, std::move( *flow ) };
+            }
+        }
+        return it->second ? &*it->second : nullptr;
+    };
+    // What each `RET` of an inlined callee pops, so as to leave only its return
+    // values; UNKNOWN if it would have to push instead, or if it returns any of
+    // the callee's locals, which are remapped out of where its return values go.
+    const auto popCount = [ & ]( const Callee & callee, size_t retIdx ) {
+        const size_t depth = callee.flow.depth.at( retIdx );
+        const size_t frameSize = vm.functionFrameSizeTable[ callee.functionIdx ];
+        const size_t kept = frameSize + code[ retIdx ].arg;
+        if ( frameSize > 0 && code[ retIdx ].arg > callee.argumentCount ) {
+            return UNKNOWN;
+        }
+        return depth >= kept ? depth - kept : UNKNOWN;
+    };
+    const auto inlinedSize = [ & ]( const Callee & callee ) {
+        const auto & body = bodies[ callee.functionIdx ];
+        size_t size = 0;
+        for ( const size_t idx : body ) {
+            if ( code[ idx ].op == Opcode::RET ) {
+                size += ( popCount( callee, idx ) > 0 ) + ( idx != body.back() );
+            } else {
+                size += 1;
+            }
+        }
+        return size;
+    };
+    // Where slot `slot` of an inlined callee ends up in its caller's frame.
+    const auto remap = [ & ]( const Caller & caller, const Site & site, size_t slot ) {
+        const size_t argumentCount = site.callee->argumentCount;
+        const size_t frameSize = vm.functionFrameSizeTable[ site.callee->functionIdx ];
+        const size_t base = site.calleeBase + caller.extraFrame;
+        if ( slot < argumentCount ) {
+            return base + slot;
+        }
+        if ( slot < argumentCount + frameSize ) {
+            return caller.pushedFrom + slot - argumentCount;
+        }
+        return base + slot - frameSize;
+    };
+
+    // Pick the call sites.
+    std::vector< Caller > callers( functionCount );
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        const auto & body = bodies[ f ];
+        if ( arities[ f ] == UNKNOWN || !exclusive[ f ] || body.empty() ||
+             std::any_of( body.begin(), body.end(),
+                          [ & ]( size_t idx ) { return isVector( code[ idx ].op ); } ) ) {
+            continue;
+        }
+        Caller & caller = callers[ f ];
+        caller.pushedFrom = arities[ f ] + vm.functionFrameSizeTable[ f ];
+        const auto flow = follow( code, vm.functionTable[ f ], caller.pushedFrom,
+                                  returnCounts );
+        if ( !flow ) {
+            continue;
+        }
+        size_t size = body.size();
+        for ( const size_t idx : body ) {
+            const size_t g = code[ idx ].arg;
+            if ( code[ idx ].op != Opcode::CALL || g >= functionCount ||
+                 !inlinable[ g ] || g == f ) {
+                continue;
+            }
+            const size_t argumentCount = flow->argumentCount.at( idx );
+            const size_t depth = flow->depth.at( idx );
+            const Callee * callee = calleeFor( g, argumentCount );
+            if ( !callee || depth - argumentCount < caller.pushedFrom ) {
+                continue;
+            }
+            bool ok = true;
+            for ( const size_t calleeIdx : bodies[ g ] ) {
+                if ( code[ calleeIdx ].op == Opcode::RET ) {
+                    ok = ok && popCount( *callee, calleeIdx ) <= MAX_OPERAND;
+                }
+            }
+            const size_t grownSize = size + inlinedSize( *callee ) - 1;
+            if ( !ok || grownSize > this->m_config.maxCallerInstructions ) {
+                continue;
+            }
+            size = grownSize;
+            caller.sites.push_back( { idx, depth - argumentCount, callee } );
+            caller.extraFrame =
+                std::max( caller.extraFrame, vm.functionFrameSizeTable[ g ] );
+        }
+
+        // Every operand must still fit, or the caller is left alone.
+        bool fits = true;
+        for ( const size_t idx : body ) {
+            if ( usesSlot( code[ idx ].op ) && code[ idx ].arg >= caller.pushedFrom ) {
+                fits = fits && code[ idx ].arg + caller.extraFrame <= MAX_OPERAND;
+            }
+        }
+        for ( const auto & site : caller.sites ) {
+            for ( const size_t calleeIdx : bodies[ site.callee->functionIdx ] ) {
+                if ( usesSlot( code[ calleeIdx ].op ) ) {
+                    fits = fits &&
+                        remap( caller, site, code[ calleeIdx ].arg ) <= MAX_OPERAND;
+                }
+            }
+        }
+        if ( !fits ) {
+            caller = Caller();
+        }
+    }
+
+    std::vector< const Site * > siteAt( code.size(), nullptr );
+    for ( const auto & caller : callers ) {
+        for ( const auto & site : caller.sites ) {
+            siteAt[ site.callIdx ] = &site;
+        }
+    }
+
+    // Rebuild the code. Branch targets are resolved once everything has its final
+    // index: those of the original code through `newIdx`, those of inlined bodies
+    // as they are emitted.
+    std::vector< Bytecode > rebuilt;
+    rebuilt.reserve( code.size() );
+    std::vector< size_t > newIdx( code.size() + 1 );
+    std::vector< std::pair< size_t, size_t > > originalBranches;
+    std::vector< std::pair< size_t, size_t > > inlinedBranches;
+    for ( size_t idx = 0; idx < code.size(); ++idx ) {
+        newIdx[ idx ] = rebuilt.size();
+        const Caller * caller =
+            owner[ idx ] != UNKNOWN ? &callers[ owner[ idx ] ] : nullptr;
+        const Site * site = siteAt[ idx ];
+        if ( !site ) {
+            auto instruction = code[ idx ];
+            if ( caller && usesSlot( instruction.op ) &&
+                 instruction.arg >= caller->pushedFrom ) {
+                instruction.arg += caller->extraFrame;
+            }
+            if ( isBranch( instruction.op ) ) {
+                originalBranches.emplace_back( rebuilt.size(),
+                                               branchTarget( idx, code[ idx ] ) );
+            }
+            rebuilt.push_back( instruction );
+            continue;
+        }
+
+        const Callee & callee = *site->callee;
+        const auto & body = bodies[ callee.functionIdx ];
+        std::unordered_map< size_t, size_t > copyIdx;
+        size_t next = rebuilt.size();
+        for ( const size_t calleeIdx : body ) {
+            copyIdx[ calleeIdx ] = next;
+            if ( code[ calleeIdx ].op == Opcode::RET ) {
+                next += ( popCount( callee, calleeIdx ) > 0 ) +
+                    ( calleeIdx != body.back() );
+            } else {
+                next += 1;
+            }
+        }
+        const size_t exit = next;
+        for ( const size_t calleeIdx : body ) {
+            auto instruction = code[ calleeIdx ];
+            if ( instruction.op == Opcode::RET ) {
+                const size_t pop = popCount( callee, calleeIdx );
+                if ( pop > 0 ) {
+                    rebuilt.push_back( { Opcode::POP, U8( pop ) } );
+                }
+                if ( calleeIdx != body.back() ) {
+                    inlinedBranches.emplace_back( rebuilt.size(), exit );
+                    rebuilt.push_back( { Opcode::JMP, 0 } );
+                }
+                continue;
+            }
+            if ( usesSlot( instruction.op ) ) {
+                instruction.arg = U8( remap( *caller, *site, instruction.arg ) );
+            }
+            if ( isBranch( instruction.op ) ) {
+                const size_t target = branchTarget( calleeIdx, code[ calleeIdx ] );
+                inlinedBranches.emplace_back( rebuilt.size(), copyIdx.at( target ) );
+            }
+            rebuilt.push_back( instruction );
+        }
+        assert( rebuilt.size() == exit );
+        stats.callSitesInlined += 1;
+    }
+    newIdx[ code.size() ] = rebuilt.size();
+
+    vm.m_code = std::move( rebuilt );
+    for ( const auto & [ branchIdx, target ] : originalBranches ) {
+        vm.setBranchTarget( branchIdx, newIdx[ target ] );
+    }
+    for ( const auto & [ branchIdx, target ] : inlinedBranches ) {
+        vm.setBranchTarget( branchIdx, target );
+    }
+    for ( size_t f = 0; f < functionCount; ++f ) {
+        vm.functionTable[ f ] =
+            newIdx[ std::min( vm.functionTable[ f ], newIdx.size() - 1 ) ];
+        vm.functionFrameSizeTable[ f ] += callers[ f ].extraFrame;
+    }
+    vm.computeFunctionCosts();
+    vm.m_nextInstructionIdx =
+        newIdx[ std::min( vm.m_nextInstructionIdx, newIdx.size() - 1 ) ];
+    stats.instructionsAfter = vm.m_code.size();
+    return stats;
+}
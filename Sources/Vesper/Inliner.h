@@ -0,0 +1,56 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "Vm.h"
+
+// Replaces `CALL`s of small functions with copies of their bodies, so that the call
+// no longer pushes a call frame or reserves a stack frame.
+//
+// A call site can be inlined when the number of arguments it passes is known (the
+// `ZERO_ACC; ARG ...; CALL` sequence), and so is the depth of the caller's stack
+// there. That depth depends on how many arguments the caller itself takes, which is
+// inferred from its own call sites, or given in `Config::entryArities` for functions
+// called from outside the code.
+//
+// The arguments are still pushed, and an inlined body addresses them where they
+// land. Its locals become locals of the caller, whose frame grows to fit the largest
+// inlined callee, and the caller's references to slots pushed above its frame shift
+// to match. Each `RET` becomes a `POP` of whatever the callee would have left above
+// its return values, and a jump past the inlined body.
+//
+// Callees that are (mutually) recursive, or use vector opcodes, are never inlined.
+// Calls within an inlined body are left as they are, so each run inlines one level.
+//
+// The code is rebuilt, so this must run before the VM starts executing it, and with
+// no breakpoints set.
+class Inliner {
+public:
+    struct Config {
+        // Callees with more instructions than this are left alone.
+        size_t maxCalleeInstructions = 8;
+        // Stop inlining into a function once it has grown to this many
+        // instructions.
+        size_t maxCallerInstructions = 256;
+        // Argument counts of functions, by label, for those that can't be inferred
+        // from their call sites.
+        std::unordered_map< std::string, size_t > entryArities;
+    };
+
+    struct Stats {
+        size_t callSitesInlined = 0;
+        size_t instructionsBefore = 0;
+        size_t instructionsAfter = 0;
+    };
+
+    Inliner();
+    explicit Inliner( Config config );
+
+    Stats run( Vm & vm ) const;
+
+private:
+    Config m_config;
+};
@@ -0,0 +1,118 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Value.h"
+
+class Vm;
+
+// The arguments of a `CALL_NATIVE`: the slots the caller pushed them to, in place.
+// Valid until the native function pushes onto the VM's stack.
+struct NativeArgs {
+    const Register * slots;
+    size_t count;
+
+    const Register & operator[]( size_t i ) const { return slots[ i ]; }
+};
+
+// What `CALL_NATIVE` calls. The result goes in ACC, as an integer.
+using NativeFunction = Register ( * )( Vm & vm, NativeArgs args );
+
+namespace NativeAdapter {
+
+template < typename T >
+T
+fromRegister( Register reg ) {
+    static_assert( std::is_same_v< T, I32 > || std::is_same_v< T, U32 > ||
+                       std::is_same_v< T, bool > || std::is_same_v< T, Register >,
+                   "Native arguments must be I32, U32, bool or Register" );
+    if constexpr ( std::is_same_v< T, I32 > ) {
+        return reg.i32;
+    } else if constexpr ( std::is_same_v< T, U32 > ) {
+        return reg.ref;
+    } else if constexpr ( std::is_same_v< T, bool > ) {
+        return reg.i32 != 0;
+    } else {
+        return reg;
+    }
+}
+
+template < typename T >
+Register
+toRegister( T value ) {
+    static_assert( std::is_same_v< T, I32 > || std::is_same_v< T, U32 > ||
+                       std::is_same_v< T, bool > || std::is_same_v< T, Register >,
+                   "Native results must be I32, U32, bool, Register or void" );
+    if constexpr ( std::is_same_v< T, U32 > ) {
+        Register reg( 0 );
+        reg.ref = value;
+        return reg;
+    } else if constexpr ( std::is_same_v< T, Register > ) {
+        return value;
+    } else {
+        return Register( I32( value ) );
+    }
+}
+
+template < typename... Args >
+struct TakesVm : std::false_type {};
+template < typename... Rest >
+struct TakesVm< Vm &, Rest... > : std::true_type {};
+
+template < auto F, typename Signature >
+struct Adapter;
+
+// Calls `F` with each argument slot converted to its parameter's type, and `vm`
+// first if it asks for it.
+template < auto F, typename R, typename... Args >
+struct Adapter< F, R ( * )( Args... ) > {
+    static constexpr bool TAKES_VM = TakesVm< Args... >::value;
+
+    static Register
+    call( Vm & vm, NativeArgs args ) {
+        constexpr size_t ARGUMENT_COUNT = sizeof...( Args ) - ( TAKES_VM ? 1 : 0 );
+        return callWith( vm, args, std::make_index_sequence< ARGUMENT_COUNT >() );
+    }
+
+    template < size_t... I >
+    static Register
+    callWith( Vm & vm, NativeArgs args, std::index_sequence< I... > ) {
+        assert( args.count == sizeof...( I ) );
+        ( void )args;
+        ( void )vm;
+        const auto invoke = [ & ]() -> R {
+            if constexpr ( TAKES_VM ) {
+                return F( vm, fromRegister< std::decay_t< Parameter< I + 1 > > >(
+                                  args[ I ] )... );
+            } else {
+                return F(
+                    fromRegister< std::decay_t< Parameter< I > > >( args[ I ] )... );
+            }
+        };
+        if constexpr ( std::is_void_v< R > ) {
+            invoke();
+            return Register( 0 );
+        } else {
+            return toRegister( invoke() );
+        }
+    }
+
+    template < size_t I >
+    using Parameter = std::tuple_element_t< I, std::tuple< Args... > >;
+};
+
+} // namespace NativeAdapter
+
+// A `NativeFunction` for the ordinary function `F`, generated at compile time, e.g.
+// `adaptNative< hash >()` for `I32 hash( I32, I32 )`. `F` may take a `Vm &` first.
+template < auto F >
+constexpr NativeFunction
+adaptNative() {
+    return &NativeAdapter::Adapter< F, decltype( F ) >::call;
+}
@@ -1,7 +1,17 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <utility>
+
+#include "Vesper/BatchVm.h"
 #include "Vesper/Bytecode.h"
+#include "Vesper/Inliner.h"
+#include "Vesper/VectorKernels.h"
 #include "Vesper/Vm.h"
+#include "Vesper/VmImage.h"
 #include "BytecodeTest.h"
 
 void
@@ -134,3 +144,1125 @@ testBytecodeRet( Tm42_TestContext * ctx ) {
 
     TM42_END_TEST();
 }
+
+void
+testBytecodeCons( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "CONS, CAR and CDR opcodes" );
+
+    Vm vm( { { Opcode::ZERO_ACC, 0 },
+             { Opcode::CONS, 0 },
+             { Opcode::CONS, 1 },
+             { Opcode::CDR, 0 },
+             { Opcode::CAR, 0 } } );
+    vm.pushDataOntoStack( Register( 1 ) );
+    vm.pushDataOntoStack( Register( 2 ) );
+    for ( int i = 0; i < 3; ++i ) {
+        vm.executeNextInstruction();
+    }
+    // ( 2 1 . 0 )
+    TM42_TEST_ASSERT( ctx, vm.accumulatorIsRef() );
+    const auto list = vm.accumulatorValue();
+    TM42_TEST_ASSERT( ctx, vm.heap.field( list, 0 ).i32 == 2 );
+    TM42_TEST_ASSERT( ctx, !vm.heap.fieldIsRef( list, 0 ) );
+    TM42_TEST_ASSERT( ctx, vm.heap.fieldIsRef( list, 1 ) );
+    vm.executeNextInstruction();
+    TM42_TEST_ASSERT( ctx, vm.accumulatorIsRef() );
+    vm.executeNextInstruction();
+    TM42_TEST_ASSERT( ctx, !vm.accumulatorIsRef() );
+    TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 1 );
+
+    TM42_END_TEST();
+}
+
+void
+testHeapCollection( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Heap collection" );
+
+    // Builds a list of LENGTH 7s in slot 1, making two cells of garbage per element.
+    constexpr int LENGTH = 5000;
+    Vm vm;
+    vm.heap = Heap( { 256, 1024 } );
+    vm.pushDataOntoStack( Register( 7 ) );
+    vm.pushDataOntoStack( Register( 0 ) );
+    for ( int i = 0; i < LENGTH; ++i ) {
+        vm.pushInstruction( { Opcode::CONS, 0 } );
+        vm.pushInstruction( { Opcode::STORE, 1 } );
+        vm.pushInstruction( { Opcode::CONS, 0 } );
+        vm.pushInstruction( { Opcode::CONS, 0 } );
+        vm.pushInstruction( { Opcode::LOAD, 1 } );
+    }
+    while ( vm.m_nextInstructionIdx < vm.m_code.size() ) {
+        vm.executeNextInstruction();
+    }
+
+    const auto & stats = vm.heap.stats();
+    TM42_TEST_ASSERT( ctx, stats.minorCollections > 0 );
+    TM42_TEST_ASSERT( ctx, stats.majorCollections > 0 );
+    TM42_TEST_ASSERT( ctx, stats.bytesAllocated == 3 * LENGTH * 12 );
+    TM42_TEST_ASSERT( ctx, stats.bytesPromoted > 0 );
+    TM42_TEST_ASSERT( ctx, stats.bytesPromoted < stats.bytesAllocated );
+    U64 pauses = 0;
+    for ( const auto count : stats.pauseHistogram ) {
+        pauses += count;
+    }
+    TM42_TEST_ASSERT( ctx, pauses == stats.minorCollections );
+
+    // Only the list survives a full collection.
+    vm.collectGarbage( true );
+    TM42_TEST_ASSERT( ctx, vm.heap.nurseryBytesUsed() == 0 );
+    TM42_TEST_ASSERT( ctx, vm.heap.tenuredBytesUsed() == LENGTH * 12 );
+
+    int length = 0;
+    Register cell = vm.m_stack.get( 1 );
+    bool isRef = vm.m_stack.isRef( 1 );
+    while ( isRef ) {
+        TM42_TEST_ASSERT( ctx, vm.heap.field( cell, 0 ).i32 == 7 );
+        isRef = vm.heap.fieldIsRef( cell, 1 );
+        cell = vm.heap.field( cell, 1 );
+        length += 1;
+    }
+    TM42_TEST_ASSERT( ctx, length == LENGTH );
+    TM42_TEST_ASSERT( ctx, cell.i32 == 0 );
+
+    TM42_END_TEST();
+}
+
+void
+testVectorKernels( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Vector kernels" );
+
+    // Every length up to a few vectors, so each tail length is covered, with values
+    // big enough to overflow.
+    U32 seed = 12345;
+    const auto next = [ & ]() {
+        seed = seed * 1103515245u + 12345u;
+        return static_cast< I32 >( seed );
+    };
+    for ( size_t n = 0; n < 70; ++n ) {
+        std::vector< I32 > a( n );
+        std::vector< I32 > b( n );
+        for ( size_t i = 0; i < n; ++i ) {
+            a[ i ] = next();
+            b[ i ] = next();
+        }
+        U32 sum = 0;
+        U32 dot = 0;
+        std::vector< I32 > added( n );
+        std::vector< I32 > multiplied( n );
+        for ( size_t i = 0; i < n; ++i ) {
+            sum += U32( a[ i ] );
+            dot += U32( a[ i ] ) * U32( b[ i ] );
+            added[ i ] = I32( U32( a[ i ] ) + U32( b[ i ] ) );
+            multiplied[ i ] = I32( U32( a[ i ] ) * U32( b[ i ] ) );
+        }
+        TM42_TEST_ASSERT( ctx, VectorKernels::sum( a.data(), n ) == I32( sum ) );
+        TM42_TEST_ASSERT( ctx, VectorKernels::dot( a.data(), b.data(), n ) == I32( dot ) );
+        auto result = a;
+        VectorKernels::add( result.data(), b.data(), n );
+        TM42_TEST_ASSERT( ctx, result == added );
+        result = a;
+        VectorKernels::mul( result.data(), b.data(), n );
+        TM42_TEST_ASSERT( ctx, result == multiplied );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testBytecodeVector( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Vector opcodes" );
+
+    { // A million-element reduction is one instruction.
+        constexpr I32 LENGTH = 1 << 20;
+        Vm vm( { { Opcode::VSUM, 0 } } );
+        for ( I32 i = 0; i < LENGTH; ++i ) {
+            vm.pushDataOntoStack( Register( i % 1000 ) );
+        }
+        vm.setAccumulator( Register( LENGTH ) );
+        vm.executeNextInstruction();
+        I64 expected = 0;
+        for ( I32 i = 0; i < LENGTH; ++i ) {
+            expected += i % 1000;
+        }
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == I32( expected ) );
+    }
+    { // Slices at two offsets.
+        constexpr I32 LENGTH = 37;
+        Vm vm( { { Opcode::VDOT, 0, 40 },
+                 { Opcode::LOAD, 80 },
+                 { Opcode::VADD, 0, 40 },
+                 { Opcode::VMUL, 40, 0 },
+                 { Opcode::VSUM, 40 } } );
+        for ( I32 i = 0; i < 40; ++i ) {
+            vm.pushDataOntoStack( Register( i ) );
+        }
+        for ( I32 i = 0; i < 40; ++i ) {
+            vm.pushDataOntoStack( Register( 2 ) );
+        }
+        vm.pushDataOntoStack( Register( LENGTH ) );
+        vm.setAccumulator( Register( LENGTH ) );
+
+        vm.executeNextInstruction();
+        // 2 * ( 0 + ... + 36 )
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 2 * 666 );
+        vm.executeNextInstruction();
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == LENGTH );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 36 ).i32 == 38 );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 37 ).i32 == 37 );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 76 ).i32 == 76 );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 77 ).i32 == 2 );
+        vm.executeNextInstruction();
+        // 2 * ( 2 + ... + 38 )
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 2 * ( 741 - 1 ) );
+    }
+    { // Slices past the top of the frame stop the VM, and leave the slots alone.
+        Vm vm( { { Opcode::VADD, 0, 6 }, { Opcode::VDOT, 6, 0 }, { Opcode::VSUM, 2 } } );
+        for ( I32 i = 0; i < 10; ++i ) {
+            vm.pushDataOntoStack( Register( i ) );
+        }
+        vm.setAccumulator( Register( 5 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::SLICE_OUT_OF_BOUNDS );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 0 ).i32 == 0 );
+        vm.restoreStoppedIp();
+        TM42_TEST_ASSERT( ctx, vm.m_nextInstructionIdx == 0 );
+
+        // Fits exactly.
+        vm.clearError();
+        vm.setAccumulator( Register( 4 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.get( 3 ).i32 == 3 + 9 );
+
+        vm.setAccumulator( Register( 5 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::SLICE_OUT_OF_BOUNDS );
+        vm.restoreStoppedIp();
+        TM42_TEST_ASSERT( ctx, vm.m_code[ vm.m_nextInstructionIdx ].op == Opcode::VDOT );
+
+        vm.clearError();
+        vm.m_nextInstructionIdx = 2;
+        vm.setAccumulator( Register( -1 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::SLICE_OUT_OF_BOUNDS );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testBatchVm( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Batched execution" );
+
+    Vm vm;
+    // sum( a, b ), into slot 0.
+    vm.beginLabel( "sum", 0 );
+    vm.pushInstruction( { Opcode::LOAD, 1 } );
+    vm.pushInstruction( { Opcode::ADD, 2 } );
+    vm.pushInstruction( { Opcode::STORE, 0 } );
+    vm.pushInstruction( { Opcode::RET, 1 } );
+    vm.endLabel();
+    // f( x, y ) = sum( x, y ) + 7, in ACC. Slot 2 is a local.
+    const auto f = vm.beginLabel( "f", 1 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG_IMM, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 1 } );
+    vm.pushCallInstruction( "sum" );
+    vm.pushInstruction( { Opcode::LOAD, 3 } );
+    vm.pushInstruction( { Opcode::ADD_IMM, 7 } );
+    vm.pushInstruction( { Opcode::STORE, 2 } );
+    vm.pushInstruction( { Opcode::RET, 3 } );
+    vm.endLabel();
+    // g( x ) = x + 1, using an opcode that has no lane-parallel form.
+    const auto g = vm.beginLabel( "g", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ADD_IMM, 1 } );
+    vm.pushInstruction( { Opcode::VSUM, 0 } );
+    vm.pushInstruction( { Opcode::ADD_IMM, 1 } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+
+    constexpr size_t LANES = 1000;
+    std::vector< I32 > xs( LANES );
+    std::vector< I32 > ys( LANES );
+    for ( size_t l = 0; l < LANES; ++l ) {
+        xs[ l ] = I32( l );
+        ys[ l ] = I32( 3 * l );
+    }
+
+    BatchVm batch( vm );
+    { // All lanes in lockstep, through a call.
+        batch.run( f, LANES, { xs, ys } );
+        TM42_TEST_ASSERT( ctx, !batch.fellBack() );
+        TM42_TEST_ASSERT( ctx, batch.slotCount() == 3 );
+        bool allRight = true;
+        for ( size_t l = 0; l < LANES; ++l ) {
+            allRight = allRight && batch.accumulator()[ l ] == I32( 4 * l + 7 );
+            allRight = allRight && batch.slot( 2 )[ l ] == I32( 4 * l + 7 );
+            allRight = allRight && batch.slot( 1 )[ l ] == I32( 3 * l );
+        }
+        TM42_TEST_ASSERT( ctx, allRight );
+    }
+    { // Lane by lane.
+        batch.run( g, LANES, { xs } );
+        TM42_TEST_ASSERT( ctx, batch.fellBack() );
+        bool allRight = true;
+        for ( size_t l = 0; l < LANES; ++l ) {
+            allRight = allRight && batch.accumulator()[ l ] == I32( l + 1 );
+        }
+        TM42_TEST_ASSERT( ctx, allRight );
+    }
+    { // Same results as calling each lane on its own.
+        for ( size_t l = 0; l < 3; ++l ) {
+            Vm single;
+            single.m_code = vm.m_code;
+            single.functionTable = vm.functionTable;
+            single.functionFrameSizeTable = vm.functionFrameSizeTable;
+            single.pushDataOntoStack( Register( xs[ l ] ) );
+            single.pushDataOntoStack( Register( ys[ l ] ) );
+            single.setAccumulator( Register( 2 ) );
+            single.executeInstructions( { { Opcode::CALL, U8( f ) } } );
+            batch.run( f, LANES, { xs, ys } );
+            TM42_TEST_ASSERT( ctx, single.accumulatorValue().i32 ==
+                                       batch.accumulator()[ l ] );
+        }
+    }
+
+    TM42_END_TEST();
+}
+
+namespace {
+
+// triangle( n ) = n + ( n - 1 ) + ... + 1, in ACC, with a counted loop. Slot 1 is
+// the running total.
+size_t
+emitTriangle( Vm & vm ) {
+    const auto idx = vm.beginLabel( "triangle", 1 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::STORE, 1 } );
+    const auto body = vm.m_code.size();
+    vm.pushInstruction( { Opcode::LOAD, 1 } );
+    vm.pushInstruction( { Opcode::ADD, 0 } );
+    vm.pushInstruction( { Opcode::STORE, 1 } );
+    vm.pushInstruction( { Opcode::LOOP, 0 } );
+    vm.setBranchTarget( vm.m_code.size() - 1, body );
+    vm.pushInstruction( { Opcode::LOAD, 1 } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    return idx;
+}
+
+// max( a, b ), in ACC.
+size_t
+emitMax( Vm & vm ) {
+    const auto idx = vm.beginLabel( "max", 0 );
+    vm.pushInstruction( { Opcode::LOAD, 0 } );
+    vm.pushInstruction( { Opcode::LT, 1 } );
+    const auto jz = vm.m_code.size();
+    vm.pushInstruction( { Opcode::JZ, 0 } );
+    vm.pushInstruction( { Opcode::LOAD, 1 } );
+    const auto jmp = vm.m_code.size();
+    vm.pushInstruction( { Opcode::JMP, 0 } );
+    vm.setBranchTarget( jz, vm.m_code.size() );
+    vm.pushInstruction( { Opcode::LOAD, 0 } );
+    vm.setBranchTarget( jmp, vm.m_code.size() );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    return idx;
+}
+
+} // namespace
+
+void
+testBytecodeBranch( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Branch opcodes" );
+
+    { // Compares.
+        Vm vm( { { Opcode::EQ, 0 },
+                 { Opcode::LT, 0 },
+                 { Opcode::LE, 0 },
+                 { Opcode::LT, 1 } } );
+        vm.pushDataOntoStack( Register( 5 ) );
+        vm.pushDataOntoStack( Register( -3 ) );
+        vm.setAccumulator( Register( 5 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 1 );
+        vm.setAccumulator( Register( 5 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 0 );
+        vm.setAccumulator( Register( 5 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 1 );
+        vm.setAccumulator( Register( -4 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 1 );
+    }
+    { // Offsets are relative to the instruction after the branch.
+        Vm vm;
+        vm.pushInstruction( { Opcode::JMP, 0 } );
+        vm.pushInstruction( { Opcode::ADD_IMM, 1 } );
+        vm.pushInstruction( { Opcode::ADD_IMM, 2 } );
+        vm.setBranchTarget( 0, 2 );
+        TM42_TEST_ASSERT( ctx, branchOffset( vm.m_code[ 0 ] ) == 1 );
+        vm.setAccumulator( Register( 0 ) );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.m_nextInstructionIdx == 2 );
+        vm.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 2 );
+    }
+    { // Conditional branches.
+        Vm vm;
+        const auto max = emitMax( vm );
+        const std::pair< I32, I32 > cases[] = { { 1, 2 }, { 2, 1 }, { -7, -7 } };
+        for ( const auto & [ a, b ] : cases ) {
+            vm.pushDataOntoStack( Register( a ) );
+            vm.pushDataOntoStack( Register( b ) );
+            vm.setAccumulator( Register( 2 ) );
+            vm.executeInstructions( { { Opcode::CALL, U8( max ) } } );
+            TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == std::max( a, b ) );
+        }
+    }
+    { // A counted loop runs within its frame.
+        Vm vm;
+        const auto triangle = emitTriangle( vm );
+        vm.pushDataOntoStack( Register( 1000 ) );
+        vm.setAccumulator( Register( 1 ) );
+        vm.pushInstruction( { Opcode::CALL, U8( triangle ) } );
+        vm.m_nextInstructionIdx = vm.m_code.size() - 1;
+        size_t dispatches = 0;
+        size_t maxFrames = 0;
+        while ( vm.m_nextInstructionIdx < vm.m_code.size() ) {
+            vm.executeNextInstruction();
+            dispatches += 1;
+            maxFrames = std::max( maxFrames, vm.callStack.frames.size() );
+        }
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 500500 );
+        TM42_TEST_ASSERT( ctx, maxFrames == 1 );
+        // CALL, the two setup instructions, 4 per iteration, and the two after.
+        TM42_TEST_ASSERT( ctx, dispatches == 1 + 2 + 4 * 1000 + 2 );
+    }
+    { // Batched.
+        Vm vm;
+        const auto triangle = emitTriangle( vm );
+        const auto max = emitMax( vm );
+        BatchVm batch( vm );
+        constexpr size_t LANES = 100;
+
+        std::vector< I32 > same( LANES, 10 );
+        batch.run( triangle, LANES, { same } );
+        TM42_TEST_ASSERT( ctx, !batch.fellBack() );
+        TM42_TEST_ASSERT( ctx, batch.accumulator()[ LANES - 1 ] == 55 );
+
+        std::vector< I32 > xs( LANES );
+        std::vector< I32 > ys( LANES );
+        for ( size_t l = 0; l < LANES; ++l ) {
+            xs[ l ] = I32( l + 1 );
+            ys[ l ] = I32( LANES / 2 );
+        }
+        batch.run( triangle, LANES, { xs } );
+        TM42_TEST_ASSERT( ctx, batch.fellBack() );
+        bool allRight = true;
+        for ( size_t l = 0; l < LANES; ++l ) {
+            allRight =
+                allRight && batch.accumulator()[ l ] == xs[ l ] * ( xs[ l ] + 1 ) / 2;
+        }
+        TM42_TEST_ASSERT( ctx, allRight );
+
+        batch.run( max, LANES, { xs, ys } );
+        TM42_TEST_ASSERT( ctx, batch.fellBack() );
+        allRight = true;
+        for ( size_t l = 0; l < LANES; ++l ) {
+            allRight =
+                allRight && batch.accumulator()[ l ] == std::max( xs[ l ], ys[ l ] );
+        }
+        TM42_TEST_ASSERT( ctx, allRight );
+
+        batch.run( max, LANES, { same, ys } );
+        TM42_TEST_ASSERT( ctx, !batch.fellBack() );
+        TM42_TEST_ASSERT( ctx, batch.accumulator()[ 0 ] == I32( LANES / 2 ) );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testVmImage( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "VM images" );
+
+    // A VM paused inside a call, with a heap object on the stack.
+    Vm vm;
+    const auto triangle = emitTriangle( vm );
+    vm.pushDataOntoStack( Register( 5 ) );
+    vm.setAccumulator( Register( 0 ) );
+    vm.executeInstructions( { { Opcode::CONS, 0 } } );
+    vm.m_stack.push( vm.accumulatorValue(), true );
+    vm.pushDataOntoStack( Register( 100 ) );
+    vm.setAccumulator( Register( 1 ) );
+    vm.pushInstruction( { Opcode::CALL, U8( triangle ) } );
+    vm.m_nextInstructionIdx = vm.m_code.size() - 1;
+    for ( int i = 0; i < 10; ++i ) {
+        vm.executeNextInstruction();
+    }
+    const auto runToEnd = []( Vm & v ) {
+        while ( v.m_nextInstructionIdx < v.m_code.size() ) {
+            v.executeNextInstruction();
+        }
+    };
+
+    { // Through memory.
+        const auto bytes = VmImage::serialize( vm );
+        Vm restored;
+        TM42_TEST_ASSERT( ctx, VmImage::deserialize( bytes, restored ) );
+        TM42_TEST_ASSERT( ctx, restored.labels == vm.labels );
+        TM42_TEST_ASSERT( ctx, restored.callStack.frames.size() == 1 );
+        // Slot 1 of the outermost frame; the current one starts at 2.
+        TM42_TEST_ASSERT( ctx, restored.m_stack.m_baseIdx == 2 );
+        TM42_TEST_ASSERT( ctx, restored.m_stack.m_isRef[ 1 ] );
+        TM42_TEST_ASSERT(
+            ctx, restored.heap.field( restored.m_stack.m_stack[ 1 ], 0 ).i32 == 5 );
+        runToEnd( restored );
+        TM42_TEST_ASSERT( ctx, restored.accumulatorValue().i32 == 5050 );
+        // The image is unchanged, whatever the restored VM did.
+        TM42_TEST_ASSERT( ctx, VmImage::serialize( restored ) != bytes );
+        // Restoring over a stopped VM clears its error.
+        Vm again( { { Opcode::VSUM, 0 } } );
+        again.setAccumulator( Register( 1 ) );
+        again.executeNextInstruction();
+        TM42_TEST_ASSERT( ctx, again.error() == VmError::SLICE_OUT_OF_BOUNDS );
+        TM42_TEST_ASSERT( ctx, VmImage::deserialize( bytes, again ) );
+        TM42_TEST_ASSERT( ctx, again.error() == VmError::NONE );
+        runToEnd( again );
+        TM42_TEST_ASSERT( ctx, again.accumulatorValue().i32 == 5050 );
+    }
+    { // Bad images are rejected, and leave the VM alone.
+        const auto bytes = VmImage::serialize( vm );
+        Vm other;
+        other.setAccumulator( Register( 42 ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( bytes.substr( 0, bytes.size() - 1 ),
+                                                      other ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( bytes + "x", other ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( "VSPI", other ) );
+        auto wrongVersion = bytes;
+        wrongVersion[ 4 ] += 1;
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( wrongVersion, other ) );
+
+        // Header fields, by their offsets in `VmImage::Header`.
+        const auto withField = [ & ]( size_t offset, U64 value ) {
+            auto patched = bytes;
+            std::memcpy( &patched[ offset ], &value, sizeof( value ) );
+            return patched;
+        };
+        constexpr size_t CODE_COUNT = 16;
+        constexpr size_t FRAME_COUNT = 72;
+        constexpr size_t HEADER_SIZE = 104;
+        // A count that wraps when multiplied by the record size.
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize(
+                                   withField( FRAME_COUNT, 0x5555555555555556 ) +
+                                       std::string( 16, '\0' ),
+                                   other ) );
+        // A function starting past the end of the code.
+        U64 codeCount;
+        std::memcpy( &codeCount, &bytes[ CODE_COUNT ], sizeof( codeCount ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize(
+                                   withField( HEADER_SIZE + codeCount * sizeof( Bytecode ),
+                                              codeCount + 1 ),
+                                   other ) );
+        // A reference in ACC to a nursery object, to the middle of the cons cell, and
+        // past the end of the heap.
+        constexpr size_t ACCUMULATOR = 96;
+        const auto withRefInAcc = [ & ]( U32 ref ) {
+            return withField( ACCUMULATOR, U64( 1 ) << 32 | ref );
+        };
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( withRefInAcc( 1 ), other ) );
+        TM42_TEST_ASSERT(
+            ctx, !VmImage::deserialize( withRefInAcc( Heap::TENURED_BIT | 2 ), other ) );
+        TM42_TEST_ASSERT(
+            ctx, !VmImage::deserialize( withRefInAcc( Heap::TENURED_BIT | 4 ), other ) );
+        Vm accepted;
+        TM42_TEST_ASSERT(
+            ctx, VmImage::deserialize( withRefInAcc( Heap::TENURED_BIT | 1 ), accepted ) );
+        // The heap is only the cons cell, ( 5 . 0 ), which ends the image. Give it
+        // too many fields, a reference past its count, or its car as a reference.
+        const auto withCellHeader = [ & ]( U32 value ) {
+            auto patched = bytes;
+            std::memcpy( &patched[ bytes.size() - 3 * sizeof( U32 ) ], &value,
+                         sizeof( value ) );
+            return patched;
+        };
+        TM42_TEST_ASSERT( ctx, VmImage::deserialize( withCellHeader( 2 << 16 ), accepted ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::deserialize( withCellHeader( 3 << 16 ), other ) );
+        TM42_TEST_ASSERT(
+            ctx, !VmImage::deserialize( withCellHeader( 1 << 16 | 1 << 2 ), other ) );
+        TM42_TEST_ASSERT(
+            ctx, !VmImage::deserialize( withCellHeader( 2 << 16 | 1 << 1 ), other ) );
+        TM42_TEST_ASSERT( ctx, other.accumulatorValue().i32 == 42 );
+        TM42_TEST_ASSERT( ctx, other.m_code.empty() );
+    }
+    { // Through a file.
+        char directory[] = "/tmp/vesper_image_XXXXXX";
+        TM42_TEST_ASSERT( ctx, mkdtemp( directory ) );
+        const std::string path = std::string( directory ) + "/vm.image";
+        TM42_TEST_ASSERT( ctx, VmImage::save( vm, path ) );
+        Vm restored;
+        TM42_TEST_ASSERT( ctx, VmImage::load( path, restored ) );
+        TM42_TEST_ASSERT( ctx, !VmImage::load( path + ".missing", restored ) );
+        runToEnd( restored );
+        runToEnd( vm );
+        TM42_TEST_ASSERT( ctx, restored.accumulatorValue().i32 == 5050 );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 5050 );
+        unlink( path.c_str() );
+        rmdir( directory );
+    }
+
+    TM42_END_TEST();
+}
+
+namespace {
+
+struct InlineProgram {
+    size_t w;
+    size_t h;
+    size_t k;
+};
+
+InlineProgram
+emitInlineProgram( Vm & vm ) {
+    InlineProgram program;
+    // add( ret, a, b ): ret = a + b, as in `testBytecodeRet`.
+    const auto add = vm.beginLabel( "add", 0 );
+    vm.pushInstruction( { Opcode::LOAD, 1 } );
+    vm.pushInstruction( { Opcode::ADD, 2 } );
+    vm.pushInstruction( { Opcode::STORE, 0 } );
+    vm.pushInstruction( { Opcode::RET, 1 } );
+    vm.endLabel();
+    const auto triangle = emitTriangle( vm );
+    // f( x, y ) = add( x, y ) + 7. Slot 2 is a local.
+    const auto f = vm.beginLabel( "f", 1 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG_IMM, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 1 } );
+    vm.pushInstruction( { Opcode::CALL, U8( add ) } );
+    vm.pushInstruction( { Opcode::LOAD, 3 } );
+    vm.pushInstruction( { Opcode::ADD_IMM, 7 } );
+    vm.pushInstruction( { Opcode::STORE, 2 } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    // w( x, y ) = f( x, y ), which is how f's arity is known.
+    program.w = vm.beginLabel( "w", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 1 } );
+    vm.pushInstruction( { Opcode::CALL, U8( f ) } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    // h( n ) = triangle( n ) + add( n, n ). Slot 1 is a local; the sum lands in
+    // slot 2, above the frame.
+    program.h = vm.beginLabel( "h", 1 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::CALL, U8( triangle ) } );
+    vm.pushInstruction( { Opcode::STORE, 1 } );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG_IMM, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::CALL, U8( add ) } );
+    vm.pushInstruction( { Opcode::LOAD, 2 } );
+    vm.pushInstruction( { Opcode::ADD, 1 } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    // Never run: `self` is recursive, so can't be inlined into `k`.
+    const auto self = vm.beginLabel( "self", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::CALL, U8( self ) } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    program.k = vm.beginLabel( "k", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::CALL, U8( self ) } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    return program;
+}
+
+size_t
+countCalls( const Vm & vm ) {
+    return std::count_if( vm.m_code.begin(), vm.m_code.end(),
+                          []( Bytecode b ) { return b.op == Opcode::CALL; } );
+}
+
+} // namespace
+
+void
+testInliner( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Inliner" );
+
+    constexpr size_t LANES = 50;
+    std::vector< I32 > xs( LANES );
+    std::vector< I32 > ys( LANES );
+    for ( size_t l = 0; l < LANES; ++l ) {
+        xs[ l ] = I32( l + 1 );
+        ys[ l ] = I32( 3 * l );
+    }
+    const auto resultsOf = [ & ]( const Vm & vm, size_t functionIdx,
+                                  const std::vector< std::vector< I32 > > & arguments ) {
+        BatchVm batch( vm );
+        batch.run( functionIdx, LANES, arguments );
+        return std::vector< I32 >( batch.accumulator(), batch.accumulator() + LANES );
+    };
+
+    Vm original;
+    const auto program = emitInlineProgram( original );
+    const auto wResults = resultsOf( original, program.w, { xs, ys } );
+    const auto hResults = resultsOf( original, program.h, { xs } );
+    TM42_TEST_ASSERT( ctx, wResults[ 1 ] == 2 + 3 + 7 );
+    TM42_TEST_ASSERT( ctx, hResults[ 3 ] == 10 + 8 );
+    TM42_TEST_ASSERT( ctx, countCalls( original ) == 6 );
+
+    { // Only callers whose arity is known are inlined into.
+        Vm vm = original;
+        const auto stats = Inliner().run( vm );
+        TM42_TEST_ASSERT( ctx, stats.callSitesInlined == 1 );
+        TM42_TEST_ASSERT( ctx, countCalls( vm ) == 5 );
+        // The CALL becomes the three instructions of add's body and a POP of the
+        // arguments it didn't return.
+        TM42_TEST_ASSERT( ctx, stats.instructionsAfter == stats.instructionsBefore + 3 );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, program.w, { xs, ys } ) == wResults );
+    }
+    { // Given the arities of entry points, and growing frames for callee locals.
+        Vm vm = original;
+        Inliner::Config config;
+        config.entryArities = { { "h", 1 }, { "k", 1 } };
+        const auto stats = Inliner( config ).run( vm );
+        TM42_TEST_ASSERT( ctx, stats.callSitesInlined == 3 );
+        // w -> f, and the recursive ones.
+        TM42_TEST_ASSERT( ctx, countCalls( vm ) == 3 );
+        TM42_TEST_ASSERT( ctx, vm.functionFrameSizeTable[ program.h ] == 2 );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, program.w, { xs, ys } ) == wResults );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, program.h, { xs } ) == hResults );
+
+        // With no calls left, `h` runs in one frame.
+        vm.pushDataOntoStack( Register( 4 ) );
+        vm.setAccumulator( Register( 1 ) );
+        vm.pushInstruction( { Opcode::CALL, U8( program.h ) } );
+        vm.m_nextInstructionIdx = vm.m_code.size() - 1;
+        size_t maxFrames = 0;
+        while ( vm.m_nextInstructionIdx < vm.m_code.size() ) {
+            vm.executeNextInstruction();
+            maxFrames = std::max( maxFrames, vm.callStack.frames.size() );
+        }
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 10 + 8 );
+        TM42_TEST_ASSERT( ctx, maxFrames == 1 );
+    }
+    { // Thresholds.
+        Vm vm = original;
+        Inliner::Config config;
+        config.entryArities = { { "h", 1 } };
+        config.maxCalleeInstructions = 4;
+        TM42_TEST_ASSERT( ctx, Inliner( config ).run( vm ).callSitesInlined == 2 );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, program.h, { xs } ) == hResults );
+
+        vm = original;
+        config.maxCalleeInstructions = 3;
+        TM42_TEST_ASSERT( ctx, Inliner( config ).run( vm ).callSitesInlined == 0 );
+        TM42_TEST_ASSERT( ctx, vm.m_code.size() == original.m_code.size() );
+
+        vm = original;
+        config.maxCalleeInstructions = 8;
+        config.maxCallerInstructions = 19;
+        // h grows to 19 with triangle inlined, so add isn't; f grows to 12.
+        TM42_TEST_ASSERT( ctx, Inliner( config ).run( vm ).callSitesInlined == 2 );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, program.h, { xs } ) == hResults );
+    }
+    { // A callee returning one of its locals is left as a call.
+        Vm vm;
+        const auto g = vm.beginLabel( "g", 1 );
+        vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+        vm.pushInstruction( { Opcode::ADD_IMM, 42 } );
+        vm.pushInstruction( { Opcode::STORE, 0 } );
+        vm.pushInstruction( { Opcode::ARG_IMM, 9 } );
+        vm.pushInstruction( { Opcode::RET, 1 } );
+        vm.endLabel();
+        const auto main = vm.beginLabel( "main", 0 );
+        vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+        vm.pushInstruction( { Opcode::CALL, U8( g ) } );
+        vm.pushInstruction( { Opcode::LOAD, 0 } );
+        vm.pushInstruction( { Opcode::RET, 0 } );
+        vm.endLabel();
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, main, {} )[ 0 ] == 42 );
+
+        Inliner::Config config;
+        config.entryArities = { { "main", 0 } };
+        TM42_TEST_ASSERT( ctx, Inliner( config ).run( vm ).callSitesInlined == 0 );
+        TM42_TEST_ASSERT( ctx, resultsOf( vm, main, {} )[ 0 ] == 42 );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testMemoryLimits( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Memory accounting and limits" );
+
+    Vm vm;
+    const auto program = emitInlineProgram( vm );
+    const auto self = vm.labels.at( "self" );
+    const auto call = [ & ]( size_t functionIdx, I32 argument ) {
+        vm.pushDataOntoStack( Register( argument ) );
+        vm.setAccumulator( Register( 1 ) );
+        vm.executeInstructions( { { Opcode::CALL, U8( functionIdx ) } } );
+    };
+
+    { // Accounting.
+        call( program.h, 4 );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 10 + 8 );
+        const auto usage = vm.memoryUsage();
+        // h's argument and local, and the three arguments it passes to add.
+        TM42_TEST_ASSERT( ctx, usage.peakStackSlots == 5 );
+        TM42_TEST_ASSERT( ctx, usage.stackSlots == 0 );
+        TM42_TEST_ASSERT( ctx, usage.peakFrameDepth == 2 );
+        TM42_TEST_ASSERT( ctx, usage.frameDepth == 0 );
+        TM42_TEST_ASSERT( ctx, usage.codeBytes == vm.m_code.size() * sizeof( Bytecode ) );
+        TM42_TEST_ASSERT( ctx, usage.tableBytes >= 2 * 6 * sizeof( size_t ) );
+        TM42_TEST_ASSERT( ctx, usage.heapBytes == 0 );
+    }
+    { // Unbounded recursion stops at the limit, and can carry on past it.
+        vm.reset();
+        Vm::Limits limits;
+        limits.maxFrameDepth = 100;
+        vm.setLimits( limits );
+        call( self, 1 );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::FRAME_LIMIT );
+        TM42_TEST_ASSERT( ctx, vm.callStack.frames.size() == 100 );
+        TM42_TEST_ASSERT( ctx, vm.m_code[ vm.m_nextInstructionIdx ].op == Opcode::CALL );
+
+        limits.maxFrameDepth = 150;
+        vm.setLimits( limits );
+        vm.clearError();
+        // Stepping by hand also ends at the error, past the end of the code.
+        while ( vm.m_nextInstructionIdx < vm.m_code.size() ) {
+            vm.executeNextInstruction();
+        }
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::FRAME_LIMIT );
+        TM42_TEST_ASSERT( ctx, vm.memoryUsage().peakFrameDepth == 150 );
+        vm.restoreStoppedIp();
+        TM42_TEST_ASSERT( ctx, vm.m_code[ vm.m_nextInstructionIdx ].op == Opcode::CALL );
+
+        vm.reset();
+        limits = Vm::Limits();
+        limits.maxStackSlots = 50;
+        vm.setLimits( limits );
+        call( self, 1 );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::STACK_LIMIT );
+        TM42_TEST_ASSERT( ctx, vm.memoryUsage().stackSlots == 50 );
+        TM42_TEST_ASSERT( ctx, vm.m_code[ vm.m_nextInstructionIdx ].op == Opcode::ARG );
+    }
+    { // After a reset, the VM is usable, and reuses what it grew to.
+        vm.reset();
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.callStack.frames.empty() );
+        const auto * slots = vm.m_stack.m_stack.data();
+        const auto peak = vm.memoryUsage().peakStackSlots;
+        call( program.h, 4 );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 10 + 8 );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.m_stack.data() == slots );
+        TM42_TEST_ASSERT( ctx, vm.memoryUsage().peakStackSlots == peak );
+
+        Vm fresh;
+        fresh.reserveFor( vm.memoryUsage() );
+        TM42_TEST_ASSERT( ctx, fresh.m_stack.m_stack.capacity() >= peak );
+        TM42_TEST_ASSERT( ctx, fresh.callStack.frames.capacity() >= 150 );
+    }
+
+    TM42_END_TEST();
+}
+
+namespace {
+
+// Records each breakpoint hit, and what the counter slot of `triangle` held.
+class RecordingDebugger : public Debugger {
+public:
+    void
+    onBreakpoint( Vm & vm, size_t ip ) override {
+        this->hits.push_back( ip );
+        this->counts.push_back( vm.m_stack.get( 0 ).i32 );
+        if ( this->hits.size() == this->clearAfter ) {
+            vm.clearBreakpoint( ip );
+        }
+        if ( this->overrideAccumulator ) {
+            vm.setAccumulator( Register( 99 ) );
+        }
+    }
+
+    std::vector< size_t > hits;
+    std::vector< I32 > counts;
+    size_t clearAfter = 0;
+    bool overrideAccumulator = false;
+};
+
+} // namespace
+
+void
+testBreakpoints( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Breakpoints" );
+
+    Vm vm;
+    const auto triangle = emitTriangle( vm );
+    const auto original = vm.m_code;
+    size_t loopIdx = 0;
+    while ( vm.m_code[ loopIdx ].op != Opcode::LOOP ) {
+        loopIdx += 1;
+    }
+    const auto call = [ & ]( I32 n ) {
+        vm.reset();
+        vm.pushDataOntoStack( Register( n ) );
+        vm.setAccumulator( Register( 1 ) );
+        vm.executeInstructions( { { Opcode::CALL, U8( triangle ) } } );
+        vm.m_code.pop_back();
+        return vm.accumulatorValue().i32;
+    };
+
+    RecordingDebugger debugger;
+    vm.setDebugger( &debugger );
+    { // Stops before the instruction, then runs it.
+        vm.setBreakpoint( loopIdx );
+        vm.setBreakpoint( loopIdx );
+        TM42_TEST_ASSERT( ctx, vm.breakpointCount() == 1 );
+        TM42_TEST_ASSERT( ctx, vm.m_code[ loopIdx ].op == Opcode::BREAK );
+        TM42_TEST_ASSERT( ctx, vm.instructionAt( loopIdx ).op == Opcode::LOOP );
+        TM42_TEST_ASSERT( ctx, vm.codeWithoutBreakpoints() == original );
+        TM42_TEST_ASSERT( ctx, call( 4 ) == 10 );
+        TM42_TEST_ASSERT( ctx, debugger.hits == std::vector< size_t >( 4, loopIdx ) );
+        TM42_TEST_ASSERT( ctx, debugger.counts == std::vector< I32 >( { 4, 3, 2, 1 } ) );
+    }
+    { // The debugger can clear breakpoints, and change the state.
+        debugger.hits.clear();
+        debugger.counts.clear();
+        debugger.clearAfter = 2;
+        TM42_TEST_ASSERT( ctx, call( 4 ) == 10 );
+        TM42_TEST_ASSERT( ctx, debugger.hits.size() == 2 );
+        TM42_TEST_ASSERT( ctx, !vm.hasBreakpoint( loopIdx ) );
+        TM42_TEST_ASSERT( ctx, vm.m_code == original );
+
+        // At the RET.
+        vm.setBreakpoint( original.size() - 1 );
+        debugger.overrideAccumulator = true;
+        TM42_TEST_ASSERT( ctx, call( 4 ) == 99 );
+    }
+    { // Breakpoints are left out of batches.
+        BatchVm batch( vm );
+        batch.run( triangle, 2, { { 3, 4 } } );
+        TM42_TEST_ASSERT( ctx, batch.accumulator()[ 0 ] == 6 );
+        TM42_TEST_ASSERT( ctx, batch.accumulator()[ 1 ] == 10 );
+        vm.clearBreakpoints();
+        TM42_TEST_ASSERT( ctx, vm.m_code == original );
+        TM42_TEST_ASSERT( ctx, call( 4 ) == 10 );
+    }
+
+    TM42_END_TEST();
+}
+
+namespace {
+
+std::vector< I32 > recordedValues;
+const Register * lastArgumentSlots = nullptr;
+
+I32
+mixHash( I32 a, U32 b ) {
+    return I32( U32( a ) * 31u + b );
+}
+
+void
+recordValue( I32 value ) {
+    recordedValues.push_back( value );
+}
+
+I32
+frameDepth( Vm & vm ) {
+    return I32( vm.callStack.frames.size() );
+}
+
+Register
+sumArguments( Vm &, NativeArgs args ) {
+    lastArgumentSlots = args.slots;
+    I32 total = 0;
+    for ( size_t i = 0; i < args.count; ++i ) {
+        total += args[ i ].i32;
+    }
+    return Register( total );
+}
+
+} // namespace
+
+void
+testCallNative( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "CALL_NATIVE opcode" );
+
+    Vm vm;
+    TM42_TEST_ASSERT( ctx, vm.registerNative< mixHash >( "mix" ) == 0 );
+    vm.registerNative< recordValue >( "record" );
+    vm.registerNative< frameDepth >( "depth" );
+    vm.registerNative( "sum", sumArguments );
+
+    // use( x, y ) = mix( x, y ) + depth(), recording the hash.
+    const auto use = vm.beginLabel( "use", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 1 } );
+    vm.pushCallNativeInstruction( "mix" );
+    vm.pushInstruction( { Opcode::STORE, 0 } );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushInstruction( { Opcode::ARG, 0 } );
+    vm.pushCallNativeInstruction( "record" );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushCallNativeInstruction( "depth" );
+    vm.pushInstruction( { Opcode::ADD, 0 } );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+
+    { // Adapted from ordinary signatures.
+        vm.pushDataOntoStack( Register( 2 ) );
+        vm.pushDataOntoStack( Register( 5 ) );
+        vm.setAccumulator( Register( 2 ) );
+        vm.executeInstructions( { { Opcode::CALL, U8( use ) } } );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 2 * 31 + 5 + 1 );
+        TM42_TEST_ASSERT( ctx, recordedValues == std::vector< I32 >( { 2 * 31 + 5 } ) );
+        TM42_TEST_ASSERT( ctx, vm.memoryUsage().peakStackSlots == 4 );
+    }
+    { // Raw, with any number of arguments, in place.
+        vm.reset();
+        vm.executeInstructions( { { Opcode::ZERO_ACC, 0 },
+                                  { Opcode::ARG_IMM, 1 },
+                                  { Opcode::ARG_IMM, 2 },
+                                  { Opcode::ARG_IMM, 3 },
+                                  { Opcode::CALL_NATIVE, 3 } } );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 6 );
+        TM42_TEST_ASSERT( ctx, lastArgumentSlots == vm.m_stack.m_stack.data() );
+        TM42_TEST_ASSERT( ctx, vm.m_stack.m_topIdx == 0 );
+    }
+    { // Batched, lane by lane.
+        recordedValues.clear();
+        BatchVm batch( vm );
+        batch.run( use, 3, { { 0, 1, 2 }, { 7, 7, 7 } } );
+        TM42_TEST_ASSERT( ctx, batch.fellBack() );
+        TM42_TEST_ASSERT( ctx, batch.accumulator()[ 2 ] == 2 * 31 + 7 + 1 );
+        TM42_TEST_ASSERT( ctx, recordedValues ==
+                                   std::vector< I32 >( { 7, 31 + 7, 62 + 7 } ) );
+    }
+
+    TM42_END_TEST();
+}
+
+void
+testFuel( Tm42_TestContext * ctx ) {
+    TM42_BEGIN_TEST( "Fuel metering" );
+
+    Vm vm;
+    const auto triangle = emitTriangle( vm );
+    // spin() = spin(), forever.
+    const auto spin = vm.beginLabel( "spin", 0 );
+    vm.pushInstruction( { Opcode::ZERO_ACC, 0 } );
+    vm.pushCallInstruction( "spin" );
+    vm.pushInstruction( { Opcode::RET, 0 } );
+    vm.endLabel();
+    TM42_TEST_ASSERT( ctx, vm.functionCostTable[ triangle ] == 8 );
+    TM42_TEST_ASSERT( ctx, vm.functionCostTable[ spin ] == 3 );
+    { // Costs are of the code without breakpoints, and are saved in images.
+        // On the RET, which as a BREAK would seem to fall through into `spin`.
+        vm.setBreakpoint( vm.functionTable[ triangle ] + 7 );
+        vm.computeFunctionCosts();
+        TM42_TEST_ASSERT( ctx, vm.functionCostTable[ triangle ] == 8 );
+        vm.clearBreakpoints();
+
+        Vm restored;
+        const auto image = VmImage::serialize( vm );
+        TM42_TEST_ASSERT( ctx, VmImage::deserialize( image, restored ) );
+        TM42_TEST_ASSERT( ctx, restored.functionCostTable == vm.functionCostTable );
+    }
+
+    // The CALL pays for the body, and each LOOP back for the 4 instructions of the
+    // next iteration.
+    const I64 triangleCost = 8 + 4 * 999;
+    const auto callTriangle = [ & ]() {
+        vm.reset();
+        vm.pushDataOntoStack( Register( 1000 ) );
+        vm.setAccumulator( Register( 1 ) );
+        vm.pushInstruction( { Opcode::CALL, U8( triangle ) } );
+        vm.m_nextInstructionIdx = vm.m_code.size() - 1;
+    };
+
+    { // Unlimited by default.
+        callTriangle();
+        const I64 fuel = vm.fuel();
+        TM42_TEST_ASSERT( ctx, vm.run() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 500500 );
+        TM42_TEST_ASSERT( ctx, fuel - vm.fuel() == triangleCost );
+        // And stays so.
+        vm.addFuel( INT64_MAX );
+        TM42_TEST_ASSERT( ctx, vm.fuel() == INT64_MAX );
+        vm.setFuel( -5 );
+        vm.addFuel( INT64_MIN );
+        TM42_TEST_ASSERT( ctx, vm.fuel() == INT64_MIN );
+        vm.setFuel( INT64_MAX );
+    }
+    { // Preempted, and resumed where it stopped.
+        callTriangle();
+        vm.setFuel( 100 );
+        size_t slices = 1;
+        while ( vm.run() == VmError::OUT_OF_FUEL ) {
+            TM42_TEST_ASSERT( ctx, vm.callStack.frames.size() == 1 );
+            vm.addFuel( 100 );
+            slices += 1;
+        }
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 500500 );
+        TM42_TEST_ASSERT( ctx, slices == 41 );
+        TM42_TEST_ASSERT( ctx, vm.fuel() == I64( 100 * slices ) - triangleCost );
+    }
+    { // Debt is paid before running again.
+        callTriangle();
+        vm.setFuel( -5 );
+        const auto ip = vm.m_nextInstructionIdx;
+        TM42_TEST_ASSERT( ctx, vm.run() == VmError::OUT_OF_FUEL );
+        TM42_TEST_ASSERT( ctx, vm.m_nextInstructionIdx == ip );
+        vm.setFuel( INT64_MAX );
+        TM42_TEST_ASSERT( ctx, vm.run() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.accumulatorValue().i32 == 500500 );
+    }
+    { // Unbounded recursion stops with it.
+        vm.reset();
+        vm.setFuel( 30 );
+        vm.executeInstructions(
+            { { Opcode::ZERO_ACC, 0 }, { Opcode::CALL, U8( spin ) } } );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::OUT_OF_FUEL );
+        TM42_TEST_ASSERT( ctx, vm.callStack.frames.size() == 11 );
+        TM42_TEST_ASSERT( ctx, vm.m_nextInstructionIdx == vm.functionTable[ spin ] );
+    }
+    { // And so does an unbounded loop, at the branch.
+        vm.reset();
+        vm.setFuel( 10 );
+        vm.executeInstructions( { { Opcode::JMP, 0, U16( I16( -1 ) ) } } );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::OUT_OF_FUEL );
+        TM42_TEST_ASSERT( ctx, vm.fuel() == -1 );
+        TM42_TEST_ASSERT( ctx, vm.m_nextInstructionIdx == vm.m_code.size() - 1 );
+    }
+    { // A function called before its label ends pays as for an empty body.
+        vm.reset();
+        const auto early = vm.beginLabel( "early", 0 );
+        vm.pushInstruction( { Opcode::RET, 0 } );
+        vm.setFuel( 10 );
+        vm.executeInstructions( { { Opcode::ZERO_ACC, 0 }, { Opcode::CALL, U8( early ) } } );
+        TM42_TEST_ASSERT( ctx, vm.error() == VmError::NONE );
+        TM42_TEST_ASSERT( ctx, vm.fuel() == 9 );
+        vm.endLabel();
+    }
+
+    TM42_END_TEST();
+}
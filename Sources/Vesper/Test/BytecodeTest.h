@@ -11,3 +11,15 @@ void testBytecodeZeroAcc( Tm42_TestContext * ctx );
 void testBytecodeCall( Tm42_TestContext * ctx );
 void testBytecodeArg( Tm42_TestContext * ctx );
 void testBytecodeRet( Tm42_TestContext * ctx );
+void testBytecodeCons( Tm42_TestContext * ctx );
+void testHeapCollection( Tm42_TestContext * ctx );
+void testVectorKernels( Tm42_TestContext * ctx );
+void testBytecodeVector( Tm42_TestContext * ctx );
+void testBatchVm( Tm42_TestContext * ctx );
+void testBytecodeBranch( Tm42_TestContext * ctx );
+void testVmImage( Tm42_TestContext * ctx );
+void testInliner( Tm42_TestContext * ctx );
+void testMemoryLimits( Tm42_TestContext * ctx );
+void testBreakpoints( Tm42_TestContext * ctx );
+void testCallNative( Tm42_TestContext * ctx );
+void testFuel( Tm42_TestContext * ctx );
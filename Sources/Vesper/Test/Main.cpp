@@ -14,6 +14,18 @@ main() {
     testBytecodeCall( &ctx );
     testBytecodeArg( &ctx );
     testBytecodeRet( &ctx );
+    testBytecodeCons( &ctx );
+    testHeapCollection( &ctx );
+    testVectorKernels( &ctx );
+    testBytecodeVector( &ctx );
+    testBatchVm( &ctx );
+    testBytecodeBranch( &ctx );
+    testVmImage( &ctx );
+    testInliner( &ctx );
+    testMemoryLimits( &ctx );
+    testBreakpoints( &ctx );
+    testCallNative( &ctx );
+    testFuel( &ctx );
 
     return 0;
 }
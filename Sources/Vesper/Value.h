@@ -0,0 +1,25 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+using I32 = std::int32_t;
+using I64 = std::int64_t;
+using U32 = std::uint32_t;
+using U64 = std::uint64_t;
+using F64 = double;
+
+// A value is 32 bits. Whether it is an integer or a reference to a heap object is
+// not stored in the value itself but alongside it (see `DataStack`), so that
+// integers keep their full range and stack slices stay plain `I32` arrays.
+union Register {
+    I32 i32;
+    // See `Heap` for the encoding.
+    U32 ref;
+
+    Register( I32 i32 ): i32( i32 ) {}
+};
+
+std::ostream & operator<<( std::ostream & os, Register reg );
@@ -0,0 +1,293 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include "VectorKernels.h"
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#endif
+
+namespace VectorKernels {
+
+namespace {
+
+// Wrapping arithmetic, done unsigned so that it is defined.
+I32
+wrapAdd( I32 a, I32 b ) {
+    return static_cast< I32 >( static_cast< U32 >( a ) + static_cast< U32 >( b ) );
+}
+
+I32
+wrapMul( I32 a, I32 b ) {
+    return static_cast< I32 >( static_cast< U32 >( a ) * static_cast< U32 >( b ) );
+}
+
+// --- Scalar -------------------------------------------------------------------------
+// Also the tails of the vector versions.
+
+void
+addScalar( I32 * dst, const I32 * src, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+        dst[ i ] = wrapAdd( dst[ i ], src[ i ] );
+    }
+}
+
+void
+mulScalar( I32 * dst, const I32 * src, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+        dst[ i ] = wrapMul( dst[ i ], src[ i ] );
+    }
+}
+
+I32
+sumScalar( const I32 * src, size_t n ) {
+    I32 total = 0;
+    for ( size_t i = 0; i < n; ++i ) {
+        total = wrapAdd( total, src[ i ] );
+    }
+    return total;
+}
+
+I32
+dotScalar( const I32 * a, const I32 * b, size_t n ) {
+    I32 total = 0;
+    for ( size_t i = 0; i < n; ++i ) {
+        total = wrapAdd( total, wrapMul( a[ i ], b[ i ] ) );
+    }
+    return total;
+}
+
+#if defined( __x86_64__ )
+
+// --- SSE2 ---------------------------------------------------------------------------
+
+// SSE2 has no 32-bit multiply keeping the low halves, so multiply the even and
+// odd lanes separately and interleave the results.
+__m128i
+mullo32( __m128i a, __m128i b ) {
+    const __m128i even = _mm_mul_epu32( a, b );
+    const __m128i odd = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ) );
+    return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+                               _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+}
+
+I32
+horizontalSum( __m128i v ) {
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_cvtsi128_si32( v );
+}
+
+void
+addSse2( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        const __m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i * >( dst + i ) );
+        const __m128i s = _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i * >( dst + i ), _mm_add_epi32( d, s ) );
+    }
+    addScalar( dst + i, src + i, n - i );
+}
+
+void
+mulSse2( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        const __m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i * >( dst + i ) );
+        const __m128i s = _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i * >( dst + i ), mullo32( d, s ) );
+    }
+    mulScalar( dst + i, src + i, n - i );
+}
+
+I32
+sumSse2( const I32 * src, size_t n ) {
+    // Two accumulators, so consecutive adds don't wait on each other.
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+        acc0 = _mm_add_epi32(
+            acc0, _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i ) ) );
+        acc1 = _mm_add_epi32(
+            acc1, _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + i + 4 ) ) );
+    }
+    return wrapAdd( horizontalSum( _mm_add_epi32( acc0, acc1 ) ),
+                    sumScalar( src + i, n - i ) );
+}
+
+I32
+dotSse2( const I32 * a, const I32 * b, size_t n ) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        const __m128i x = _mm_loadu_si128( reinterpret_cast< const __m128i * >( a + i ) );
+        const __m128i y = _mm_loadu_si128( reinterpret_cast< const __m128i * >( b + i ) );
+        acc = _mm_add_epi32( acc, mullo32( x, y ) );
+    }
+    return wrapAdd( horizontalSum( acc ), dotScalar( a + i, b + i, n - i ) );
+}
+
+// --- AVX2 ---------------------------------------------------------------------------
+
+__attribute__( ( target( "avx2" ) ) ) I32
+horizontalSumAvx2( __m256i v ) {
+    return horizontalSum(
+        _mm_add_epi32( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) ) );
+}
+
+__attribute__( ( target( "avx2" ) ) ) void
+addAvx2( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+        const __m256i d = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( dst + i ) );
+        const __m256i s = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i ) );
+        _mm256_storeu_si256( reinterpret_cast< __m256i * >( dst + i ),
+                             _mm256_add_epi32( d, s ) );
+    }
+    addScalar( dst + i, src + i, n - i );
+}
+
+__attribute__( ( target( "avx2" ) ) ) void
+mulAvx2( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+        const __m256i d = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( dst + i ) );
+        const __m256i s = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i ) );
+        _mm256_storeu_si256( reinterpret_cast< __m256i * >( dst + i ),
+                             _mm256_mullo_epi32( d, s ) );
+    }
+    mulScalar( dst + i, src + i, n - i );
+}
+
+__attribute__( ( target( "avx2" ) ) ) I32
+sumAvx2( const I32 * src, size_t n ) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 16 <= n; i += 16 ) {
+        acc0 = _mm256_add_epi32(
+            acc0, _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i ) ) );
+        acc1 = _mm256_add_epi32(
+            acc1,
+            _mm256_loadu_si256( reinterpret_cast< const __m256i * >( src + i + 8 ) ) );
+    }
+    return wrapAdd( horizontalSumAvx2( _mm256_add_epi32( acc0, acc1 ) ),
+                    sumScalar( src + i, n - i ) );
+}
+
+__attribute__( ( target( "avx2" ) ) ) I32
+dotAvx2( const I32 * a, const I32 * b, size_t n ) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+        const __m256i x = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( a + i ) );
+        const __m256i y = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( b + i ) );
+        acc = _mm256_add_epi32( acc, _mm256_mullo_epi32( x, y ) );
+    }
+    return wrapAdd( horizontalSumAvx2( acc ), dotScalar( a + i, b + i, n - i ) );
+}
+
+#elif defined( __aarch64__ )
+
+// --- NEON ---------------------------------------------------------------------------
+
+void
+addNeon( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        vst1q_s32( dst + i, vaddq_s32( vld1q_s32( dst + i ), vld1q_s32( src + i ) ) );
+    }
+    addScalar( dst + i, src + i, n - i );
+}
+
+void
+mulNeon( I32 * dst, const I32 * src, size_t n ) {
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        vst1q_s32( dst + i, vmulq_s32( vld1q_s32( dst + i ), vld1q_s32( src + i ) ) );
+    }
+    mulScalar( dst + i, src + i, n - i );
+}
+
+I32
+sumNeon( const I32 * src, size_t n ) {
+    int32x4_t acc0 = vdupq_n_s32( 0 );
+    int32x4_t acc1 = vdupq_n_s32( 0 );
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+        acc0 = vaddq_s32( acc0, vld1q_s32( src + i ) );
+        acc1 = vaddq_s32( acc1, vld1q_s32( src + i + 4 ) );
+    }
+    return wrapAdd( vaddvq_s32( vaddq_s32( acc0, acc1 ) ), sumScalar( src + i, n - i ) );
+}
+
+I32
+dotNeon( const I32 * a, const I32 * b, size_t n ) {
+    int32x4_t acc = vdupq_n_s32( 0 );
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        acc = vmlaq_s32( acc, vld1q_s32( a + i ), vld1q_s32( b + i ) );
+    }
+    return wrapAdd( vaddvq_s32( acc ), dotScalar( a + i, b + i, n - i ) );
+}
+
+#endif
+
+struct Kernels {
+    void ( *add )( I32 *, const I32 *, size_t );
+    void ( *mul )( I32 *, const I32 *, size_t );
+    I32 ( *sum )( const I32 *, size_t );
+    I32 ( *dot )( const I32 *, const I32 *, size_t );
+    const char * name;
+};
+
+Kernels
+selectKernels() {
+#if defined( __x86_64__ )
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        return { addAvx2, mulAvx2, sumAvx2, dotAvx2, "avx2" };
+    }
+    return { addSse2, mulSse2, sumSse2, dotSse2, "sse2" };
+#elif defined( __aarch64__ )
+    return { addNeon, mulNeon, sumNeon, dotNeon, "neon" };
+#else
+    return { addScalar, mulScalar, sumScalar, dotScalar, "scalar" };
+#endif
+}
+
+const Kernels &
+kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+} // namespace
+
+void
+add( I32 * dst, const I32 * src, size_t n ) {
+    kernels().add( dst, src, n );
+}
+
+void
+mul( I32 * dst, const I32 * src, size_t n ) {
+    kernels().mul( dst, src, n );
+}
+
+I32
+sum( const I32 * src, size_t n ) {
+    return kernels().sum( src, n );
+}
+
+I32
+dot( const I32 * a, const I32 * b, size_t n ) {
+    return kernels().dot( a, b, n );
+}
+
+const char *
+implementation() {
+    return kernels().name;
+}
+
+} // namespace VectorKernels
@@ -0,0 +1,26 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Value.h"
+
+// Element-wise and reduction kernels over contiguous `I32` arrays, for the vector
+// opcodes. Arithmetic wraps, as it does for `ADD`.
+//
+// The implementation is picked once, on first use: AVX2 if the CPU has it, else
+// SSE2 on x86-64, NEON on AArch64, and plain loops elsewhere.
+namespace VectorKernels {
+
+// dst[ i ] += src[ i ]
+void add( I32 * dst, const I32 * src, size_t n );
+// dst[ i ] *= src[ i ]
+void mul( I32 * dst, const I32 * src, size_t n );
+I32 sum( const I32 * src, size_t n );
+I32 dot( const I32 * a, const I32 * b, size_t n );
+
+// "avx2", "sse2", "neon" or "scalar".
+const char * implementation();
+
+} // namespace VectorKernels
@@ -1,9 +1,14 @@
 // Copyright (C) 2025 by Varun Malladi
 
+#include <algorithm>
 #include <assert.h>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
+#include <unordered_set>
 
 #include "Ui.h"
+#include "VectorKernels.h"
 #include "Vm.h"
 
 std::ostream & operator<<( std::ostream & os, Register reg ) {
@@ -12,13 +17,13 @@ std::ostream & operator<<( std::ostream & os, Register reg ) {
 
 void
 CallStack::push( CallStack::Frame frame ) {
-    this->frames.push( frame );
+    this->frames.push_back( frame );
 }
 
 CallStack::Frame
 CallStack::pop() {
-    const auto toReturn = this->frames.top();
-    this->frames.pop();
+    const auto toReturn = this->frames.back();
+    this->frames.pop_back();
     return toReturn;
 }
 
@@ -29,25 +34,50 @@ DataStack::get( size_t offsetFromBase ) {
     return this->m_stack[ this->m_baseIdx + offsetFromBase ];
 }
 
+bool
+DataStack::isRef( size_t offsetFromBase ) const {
+    return this->m_isRef[ this->m_baseIdx + offsetFromBase ];
+}
+
 void
-DataStack::set( size_t offsetFromBase, Register reg ) {
+DataStack::set( size_t offsetFromBase, Register reg, bool isRef ) {
     this->m_stack[ this->m_baseIdx + offsetFromBase ] = reg;
+    this->m_isRef[ this->m_baseIdx + offsetFromBase ] = isRef;
 }
 
 void
-DataStack::push( Register value ) {
-    this->m_stack.push_back( value );
+DataStack::push( Register value, bool isRef ) {
+    // Slots past the top are left over from returned frames, and get reused.
+    this->reserve( 1 );
+    this->m_stack[ this->m_topIdx ] = value;
+    this->m_isRef[ this->m_topIdx ] = isRef;
     this->m_topIdx += 1;
 }
 
+I32 *
+DataStack::slice( size_t offsetFromBase, size_t length ) {
+    assert( this->m_baseIdx + offsetFromBase + length <= this->m_stack.size() );
+    static_assert( sizeof( Register ) == sizeof( I32 ) );
+    return reinterpret_cast< I32 * >( this->m_stack.data() + this->m_baseIdx +
+                                      offsetFromBase );
+}
+
+void
+DataStack::clearRefs( size_t offsetFromBase, size_t length ) {
+    std::memset( this->m_isRef.data() + this->m_baseIdx + offsetFromBase, 0, length );
+}
+
 void
 DataStack::reserve( size_t amount ) {
-    this->m_stack.resize( this->m_baseIdx + amount, 0 );
+    if ( this->m_stack.size() < this->m_topIdx + amount ) {
+        this->m_stack.resize( this->m_topIdx + amount, 0 );
+        this->m_isRef.resize( this->m_topIdx + amount, false );
+    }
 }
 
 void
 DataStack::expand( size_t amount ) {
-    this->m_stack.resize( this->m_baseIdx + amount, 0 );
+    this->reserve( amount );
     this->m_topIdx += amount;
 }
 
@@ -76,6 +106,145 @@ Vm::pushDataOntoStack( Register value ) {
 void
 Vm::setAccumulator( Register value ) {
     this->m_accumulator = value;
+    this->m_accumulatorIsRef = false;
+}
+
+HeapRoots
+Vm::heapRoots() {
+    return { this->m_stack.m_stack.data(), this->m_stack.m_isRef.data(),
+             this->m_stack.m_stack.size(), &this->m_accumulator,
+             this->m_accumulatorIsRef };
+}
+
+void
+Vm::collectGarbage( bool major ) {
+    this->heap.collect( this->heapRoots(), major );
+}
+
+std::ostream &
+operator<<( std::ostream & os, VmError error ) {
+    switch ( error ) {
+    case VmError::NONE:
+        return os << "no error";
+    case VmError::STACK_LIMIT:
+        return os << "stack limit exceeded";
+    case VmError::FRAME_LIMIT:
+        return os << "frame depth limit exceeded";
+    case VmError::OUT_OF_FUEL:
+        return os << "out of fuel";
+    case VmError::SLICE_OUT_OF_BOUNDS:
+        return os << "vector slice out of bounds";
+    default:
+        assert( false );
+    }
+}
+
+Vm::MemoryUsage
+Vm::memoryUsage() const {
+    MemoryUsage usage;
+    usage.stackSlots = this->m_stack.m_topIdx;
+    usage.peakStackSlots = this->m_stack.m_stack.size();
+    usage.frameDepth = this->callStack.frames.size();
+    usage.peakFrameDepth = this->m_peakFrameDepth;
+    usage.codeBytes = this->m_code.size() * sizeof( Bytecode );
+    usage.tableBytes =
+        ( this->functionTable.size() + this->functionFrameSizeTable.size() ) *
+            sizeof( size_t ) +
+        this->functionCostTable.size() * sizeof( U32 );
+    for ( const auto & [ label, functionIdx ] : this->labels ) {
+        usage.tableBytes += sizeof( label ) + label.size() + sizeof( functionIdx );
+    }
+    usage.heapBytes = this->heap.nurseryBytesUsed() + this->heap.tenuredBytesUsed();
+    return usage;
+}
+
+void
+Vm::reserveFor( const MemoryUsage & usage ) {
+    this->m_stack.m_stack.reserve( usage.peakStackSlots );
+    this->m_stack.m_isRef.reserve( usage.peakStackSlots );
+    this->callStack.frames.reserve( usage.peakFrameDepth );
+}
+
+void
+Vm::reset() {
+    // Stale flags would keep dead objects alive.
+    std::fill( this->m_stack.m_isRef.begin(), this->m_stack.m_isRef.end(), false );
+    this->m_stack.m_baseIdx = 0;
+    this->m_stack.m_topIdx = 0;
+    this->callStack.frames.clear();
+    this->m_nextInstructionIdx = this->m_code.size();
+    this->m_accumulator = 0;
+    this->m_accumulatorIsRef = false;
+    this->m_error = VmError::NONE;
+}
+
+bool
+Vm::withinLimits( size_t slots, size_t frames ) {
+    // The IP is already past the instruction being executed.
+    if ( this->m_stack.m_topIdx + slots > this->m_limits.maxStackSlots ) {
+        this->stop( VmError::STACK_LIMIT, this->m_nextInstructionIdx - 1 );
+        return false;
+    }
+    if ( this->callStack.frames.size() + frames > this->m_limits.maxFrameDepth ) {
+        this->stop( VmError::FRAME_LIMIT, this->m_nextInstructionIdx - 1 );
+        return false;
+    }
+    return true;
+}
+
+bool
+Vm::slicesInFrame( size_t offset, size_t offset2 ) {
+    const I32 length = this->m_accumulator.i32;
+    const size_t frameSlots = this->m_stack.m_topIdx - this->m_stack.m_baseIdx;
+    const size_t furthest = std::max( offset, offset2 );
+    if ( length < 0 || furthest > frameSlots ||
+         static_cast< size_t >( length ) > frameSlots - furthest ) {
+        this->stop( VmError::SLICE_OUT_OF_BOUNDS, this->m_nextInstructionIdx - 1 );
+        return false;
+    }
+    return true;
+}
+
+U32
+Vm::functionCost( size_t functionIdx ) const {
+    // As `reachableFrom()`, but walking `m_code` in place, and with a visited set
+    // the size of the body rather than of the code, as this runs for every label.
+    const size_t entry = this->functionTable[ functionIdx ];
+    if ( entry >= this->m_code.size() ) {
+        return 1;
+    }
+    std::unordered_set< size_t > seen = { entry };
+    std::vector< size_t > worklist = { entry };
+    while ( !worklist.empty() ) {
+        const size_t idx = worklist.back();
+        worklist.pop_back();
+        const Bytecode instruction = this->instructionAt( idx );
+        size_t successors[ 2 ];
+        size_t successorCount = 0;
+        if ( instruction.op != Opcode::RET && instruction.op != Opcode::JMP ) {
+            successors[ successorCount++ ] = idx + 1;
+        }
+        if ( isBranch( instruction.op ) ) {
+            successors[ successorCount++ ] = branchTarget( idx, instruction );
+        }
+        for ( size_t i = 0; i < successorCount; ++i ) {
+            if ( successors[ i ] >= this->m_code.size() ) {
+                return 1;
+            }
+            if ( seen.insert( successors[ i ] ).second ) {
+                worklist.push_back( successors[ i ] );
+            }
+        }
+    }
+    return U32( seen.size() );
+}
+
+void
+Vm::computeFunctionCosts() {
+    this->functionCostTable.resize( this->functionTable.size() );
+    for ( size_t f = 0; f < this->functionTable.size(); ++f ) {
+        this->functionCostTable[ f ] = this->functionCost( f );
+    }
 }
 
 void
@@ -84,36 +253,170 @@ Vm::executeInstruction( Bytecode instruction ) {
     case Opcode::ADD:
         this->m_accumulator.i32 = ( this->m_stack.get( instruction.arg ).i32 +
                                     this->m_accumulator.i32 );
+        this->m_accumulatorIsRef = false;
         break;
     case Opcode::ADD_IMM:
         this->m_accumulator.i32 = instruction.arg + this->m_accumulator.i32;
+        this->m_accumulatorIsRef = false;
         break;
     case Opcode::LOAD:
         this->m_accumulator = this->m_stack.get( instruction.arg );
+        this->m_accumulatorIsRef = this->m_stack.isRef( instruction.arg );
         break;
     case Opcode::STORE:
-        this->m_stack.set( instruction.arg, this->m_accumulator );
+        this->m_stack.set( instruction.arg, this->m_accumulator,
+                           this->m_accumulatorIsRef );
         break;
     case Opcode::ZERO_ACC:
         this->m_accumulator = 0;
+        this->m_accumulatorIsRef = false;
+        break;
+    case Opcode::CONS: {
+        // The collection may move both halves, so they are read after it.
+        const auto cell = this->heap.allocate( Heap::CONS_FIELDS, this->heapRoots() );
+        this->heap.setField( cell, 0, this->m_stack.get( instruction.arg ),
+                             this->m_stack.isRef( instruction.arg ) );
+        this->heap.setField( cell, 1, this->m_accumulator, this->m_accumulatorIsRef );
+        this->m_accumulator = cell;
+        this->m_accumulatorIsRef = true;
         break;
+    }
+    case Opcode::CAR:
+    case Opcode::CDR: {
+        assert( this->m_accumulatorIsRef );
+        const U32 field = instruction.op == Opcode::CAR ? 0 : 1;
+        const auto cell = this->m_accumulator;
+        this->m_accumulator = this->heap.field( cell, field );
+        this->m_accumulatorIsRef = this->heap.fieldIsRef( cell, field );
+        break;
+    }
+    case Opcode::VADD:
+    case Opcode::VMUL: {
+        if ( !this->slicesInFrame( instruction.arg, instruction.arg2 ) ) {
+            break;
+        }
+        const size_t length = this->m_accumulator.i32;
+        I32 * dst = this->m_stack.slice( instruction.arg, length );
+        const I32 * src = this->m_stack.slice( instruction.arg2, length );
+        assert( dst == src || dst + length <= src || src + length <= dst );
+        if ( instruction.op == Opcode::VADD ) {
+            VectorKernels::add( dst, src, length );
+        } else {
+            VectorKernels::mul( dst, src, length );
+        }
+        this->m_stack.clearRefs( instruction.arg, length );
+        break;
+    }
+    case Opcode::VSUM: {
+        if ( !this->slicesInFrame( instruction.arg, instruction.arg ) ) {
+            break;
+        }
+        const size_t length = this->m_accumulator.i32;
+        this->m_accumulator.i32 =
+            VectorKernels::sum( this->m_stack.slice( instruction.arg, length ), length );
+        this->m_accumulatorIsRef = false;
+        break;
+    }
+    case Opcode::VDOT: {
+        if ( !this->slicesInFrame( instruction.arg, instruction.arg2 ) ) {
+            break;
+        }
+        const size_t length = this->m_accumulator.i32;
+        this->m_accumulator.i32 =
+            VectorKernels::dot( this->m_stack.slice( instruction.arg, length ),
+                                this->m_stack.slice( instruction.arg2, length ), length );
+        this->m_accumulatorIsRef = false;
+        break;
+    }
+    case Opcode::EQ:
+    case Opcode::LT:
+    case Opcode::LE: {
+        const I32 lhs = this->m_accumulator.i32;
+        const I32 rhs = this->m_stack.get( instruction.arg ).i32;
+        const bool holds = instruction.op == Opcode::EQ ? lhs == rhs
+            : instruction.op == Opcode::LT              ? lhs < rhs
+                                                        : lhs <= rhs;
+        this->m_accumulator = holds ? 1 : 0;
+        this->m_accumulatorIsRef = false;
+        break;
+    }
+    // The IP already points past the branch, which is what offsets are relative to.
+    case Opcode::JMP:
+        this->takeBranch( instruction );
+        break;
+    case Opcode::JZ:
+    case Opcode::JNZ:
+        if ( ( this->m_accumulator.i32 == 0 ) == ( instruction.op == Opcode::JZ ) ) {
+            this->takeBranch( instruction );
+        }
+        break;
+    case Opcode::LOOP: {
+        const I32 count = this->m_stack.get( instruction.arg ).i32 - 1;
+        this->m_stack.set( instruction.arg, count );
+        if ( count > 0 ) {
+            this->takeBranch( instruction );
+        }
+        break;
+    }
     case Opcode::ARG:
-        this->m_stack.push( this->m_stack.get( instruction.arg ) );
+        if ( !this->withinLimits( 1, 0 ) ) {
+            break;
+        }
+        this->m_stack.push( this->m_stack.get( instruction.arg ),
+                            this->m_stack.isRef( instruction.arg ) );
         this->m_accumulator.i32 += 1;
         break;
     case Opcode::ARG_IMM:
+        if ( !this->withinLimits( 1, 0 ) ) {
+            break;
+        }
         this->m_stack.push( instruction.arg );
         this->m_accumulator.i32 += 1;
         break;
+    case Opcode::POP:
+        assert( this->m_stack.m_topIdx - instruction.arg >= this->m_stack.m_baseIdx );
+        this->m_stack.m_topIdx -= instruction.arg;
+        break;
+    case Opcode::BREAK: {
+        const size_t ip = this->m_nextInstructionIdx - 1;
+        const Bytecode original = this->instructionAt( ip );
+        if ( this->m_debugger ) {
+            this->m_debugger->onBreakpoint( *this, ip );
+        }
+        if ( this->m_nextInstructionIdx == ip + 1 ) {
+            this->executeInstruction( original );
+        }
+        break;
+    }
     case Opcode::CALL:
+        if ( !this->withinLimits( this->functionFrameSizeTable[ instruction.arg ], 1 ) ) {
+            break;
+        }
         this->callStack.push(
             { this->m_nextInstructionIdx,
               this->m_stack.m_baseIdx,
               this->m_stack.m_topIdx - this->m_accumulator.i32 } );
         this->m_stack.m_baseIdx = this->m_stack.m_topIdx - this->m_accumulator.i32;
         this->m_nextInstructionIdx = this->functionTable[ instruction.arg ];
-        this->m_stack.reserve( this->functionFrameSizeTable[ instruction.arg ] );
+        // Locals go above the arguments, and below anything the callee pushes.
+        this->m_stack.expand( this->functionFrameSizeTable[ instruction.arg ] );
+        this->m_peakFrameDepth =
+            std::max( this->m_peakFrameDepth, this->callStack.frames.size() );
+        assert( instruction.arg < this->functionCostTable.size() );
+        this->consumeFuel( this->functionCostTable[ instruction.arg ] );
+        break;
+    case Opcode::CALL_NATIVE: {
+        assert( instruction.arg < this->nativeTable.size() );
+        const size_t count = this->m_accumulator.i32;
+        assert( this->m_stack.m_topIdx - this->m_stack.m_baseIdx >= count );
+        const size_t first = this->m_stack.m_topIdx - count;
+        const auto result = this->nativeTable[ instruction.arg ](
+            *this, { this->m_stack.m_stack.data() + first, count } );
+        this->m_stack.m_topIdx = first;
+        this->m_accumulator = result;
+        this->m_accumulatorIsRef = false;
         break;
+    }
     case Opcode::RET: {
         const auto frame = this->callStack.pop();
         this->m_nextInstructionIdx = frame.ip;
@@ -132,9 +435,17 @@ Vm::executeInstructions( const std::vector< Bytecode > & instructions ) {
     for ( const auto & instruction : instructions ) {
         this->m_code.push_back( instruction );
     }
+    if ( this->functionCostTable.size() != this->functionTable.size() ) {
+        this->computeFunctionCosts();
+    }
+    // Stopped, until the error is cleared.
+    if ( this->m_error != VmError::NONE ) {
+        return;
+    }
     while ( this->m_nextInstructionIdx < this->m_code.size() ) {
         this->executeNextInstruction();
     }
+    this->restoreStoppedIp();
 }
 
 void
@@ -150,11 +461,39 @@ Vm::executeNextInstruction() {
     this->executeInstruction( this->m_code[ instructionIdx ] );
 }
 
+void
+Vm::restoreStoppedIp() {
+    if ( this->m_error != VmError::NONE ) {
+        this->m_nextInstructionIdx = this->m_resumeIdx;
+    }
+}
+
+VmError
+Vm::run() {
+    this->m_error = VmError::NONE;
+    // Tables copied in from elsewhere may not have come with their costs.
+    if ( this->functionCostTable.size() != this->functionTable.size() ) {
+        this->computeFunctionCosts();
+    }
+    // Still in debt from last time.
+    if ( this->m_fuel < 0 ) {
+        this->m_error = VmError::OUT_OF_FUEL;
+        return this->m_error;
+    }
+    while ( this->m_nextInstructionIdx < this->m_code.size() ) {
+        this->executeNextInstruction();
+    }
+    this->restoreStoppedIp();
+    return this->m_error;
+}
+
 void
 Vm::printNextInstruction( std::ostream & os ) const {
     os << "--- NEXT INSTRUCTION ---\n";
     os << "  " << this->m_nextInstructionIdx << " | "
-       << this->m_code[ this->m_nextInstructionIdx ] << "\n";
+       << this->instructionAt( this->m_nextInstructionIdx )
+       << ( this->hasBreakpoint( this->m_nextInstructionIdx ) ? " (breakpoint)" : "" )
+       << "\n";
 }
 
 static void
@@ -163,6 +502,51 @@ printRegister( Register reg ) {
     std::cout << "    " << reg << "\n";
 }
 
+void
+Vm::setBreakpoint( size_t ip ) {
+    assert( ip < this->m_code.size() );
+    if ( this->m_breakpoints.emplace( ip, this->m_code[ ip ] ).second ) {
+        this->m_code[ ip ] = { Opcode::BREAK, 0 };
+    }
+}
+
+void
+Vm::clearBreakpoint( size_t ip ) {
+    const auto found = this->m_breakpoints.find( ip );
+    if ( found != this->m_breakpoints.end() ) {
+        this->m_code[ ip ] = found->second;
+        this->m_breakpoints.erase( found );
+    }
+}
+
+void
+Vm::clearBreakpoints() {
+    for ( const auto & [ ip, original ] : this->m_breakpoints ) {
+        this->m_code[ ip ] = original;
+    }
+    this->m_breakpoints.clear();
+}
+
+Bytecode
+Vm::instructionAt( size_t ip ) const {
+    if ( this->m_code[ ip ].op == Opcode::BREAK ) {
+        const auto found = this->m_breakpoints.find( ip );
+        if ( found != this->m_breakpoints.end() ) {
+            return found->second;
+        }
+    }
+    return this->m_code[ ip ];
+}
+
+std::vector< Bytecode >
+Vm::codeWithoutBreakpoints() const {
+    auto code = this->m_code;
+    for ( const auto & [ ip, original ] : this->m_breakpoints ) {
+        code[ ip ] = original;
+    }
+    return code;
+}
+
 void
 Vm::pushInstruction( Bytecode instruction ) {
     this->m_code.push_back( instruction );
@@ -175,6 +559,29 @@ Vm::pushCallInstruction( const std::string & label ) {
     this->pushInstruction( { Opcode::CALL, U8( functionTableIdx ) } );
 }
 
+void
+Vm::setBranchTarget( size_t branchIdx, size_t targetIdx ) {
+    assert( isBranch( this->m_code[ branchIdx ].op ) );
+    const auto offset = static_cast< std::ptrdiff_t >( targetIdx ) -
+        static_cast< std::ptrdiff_t >( branchIdx + 1 );
+    assert( offset >= INT16_MIN && offset <= INT16_MAX );
+    this->m_code[ branchIdx ].arg2 = static_cast< U16 >( static_cast< I16 >( offset ) );
+}
+
+void
+Vm::pushCallNativeInstruction( const std::string & name ) {
+    const auto nativeTableIdx = this->nativeLabels.at( name );
+    assert( nativeTableIdx < 256 );
+    this->pushInstruction( { Opcode::CALL_NATIVE, U8( nativeTableIdx ) } );
+}
+
+size_t
+Vm::registerNative( const std::string & name, NativeFunction function ) {
+    this->nativeLabels[ name ] = this->nativeTable.size();
+    this->nativeTable.push_back( function );
+    return this->nativeTable.size() - 1;
+}
+
 void
 Vm::printRegisters( std::ostream & os ) const {
     os << "--- ACC ---\n";
@@ -209,11 +616,17 @@ Vm::printCurrentState( std::ostream & os ) const {
 
 size_t
 Vm::beginLabel( const std::string & label, size_t frameSize ) {
-    this->labels[ label ] = this->m_code.size();
+    this->labels[ label ] = this->functionTable.size();
     this->functionTable.push_back( this->m_code.size() );
     this->functionFrameSizeTable.push_back( frameSize );
+    // Until `endLabel()`, when the body is complete, a CALL of it pays as for an
+    // empty one.
+    this->functionCostTable.resize( this->functionTable.size(), 1 );
     return this->functionTable.size() - 1;
 }
 
 void
-Vm::endLabel() {}
+Vm::endLabel() {
+    this->functionCostTable.resize( this->functionTable.size(), 1 );
+    this->functionCostTable.back() = this->functionCost( this->functionTable.size() - 1 );
+}
@@ -3,23 +3,14 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "Bytecode.h"
-
-using I32 = std::int32_t;
-using I64 = std::int64_t;
-using U64 = std::uint64_t;
-using F64 = double;
-
-union Register {
-    I32 i32;
-
-    Register( I32 i32 ): i32( i32 ) {}
-};
-
-std::ostream & operator<<( std::ostream & os, Register reg );
+#include "Heap.h"
+#include "Native.h"
+#include "Value.h"
 
 class CallStack {
 public:
@@ -32,21 +23,31 @@ public:
     void push( Frame frame );
     Frame pop();
 
-    std::stack< Frame > frames;
+    // From the bottom up.
+    std::vector< Frame > frames;
 };
 
 class DataStack {
 public:
     DataStack();
     Register get( size_t offsetFromBase );
-    void set( size_t offsetFromBase, Register reg );
-    void push( Register value );
-    // Reserve at least `amount` more slots on the stack.
+    bool isRef( size_t offsetFromBase ) const;
+    void set( size_t offsetFromBase, Register reg, bool isRef = false );
+    void push( Register value, bool isRef = false );
+    // The `length` slots from `offsetFromBase` on, as integers. Any heap references
+    // among them are read as their raw bits.
+    I32 * slice( size_t offsetFromBase, size_t length );
+    // Marks slots as holding integers.
+    void clearRefs( size_t offsetFromBase, size_t length );
+    // Make sure there are at least `amount` slots above the top of the stack.
     void reserve( size_t amount );
     // Increment the top of the stack by `amount`, allocating memory as necessary.
     void expand( size_t amount );
 
     std::vector< Register > m_stack;
+    // Parallel to `m_stack`: whether each slot holds a heap reference. These are
+    // the garbage collector's roots.
+    std::vector< std::uint8_t > m_isRef;
     // Points to the base item in the current stack frame.
     size_t m_baseIdx;
     // Points to the next available slot in the current stack frame, i.e. the one right
@@ -54,27 +55,178 @@ public:
     size_t m_topIdx;
 };
 
+// Why a `Vm` stopped. The instruction that hit a limit is not executed, and is next
+// to run, so execution can continue once the limit is raised (and the error
+// cleared), or the VM can be `reset()` and reused.
+enum class VmError : U8 {
+    NONE,
+    // The data stack would have grown past `Limits::maxStackSlots`.
+    STACK_LIMIT,
+    // A `CALL` would have nested deeper than `Limits::maxFrameDepth`.
+    FRAME_LIMIT,
+    // The fuel ran out. Unlike the limits, the instruction that used the last of it
+    // has been executed, and the one after it is next.
+    OUT_OF_FUEL,
+    // A vector opcode's slices would have run past the top of the current frame, or
+    // ACC held a negative length.
+    SLICE_OUT_OF_BOUNDS,
+};
+
+std::ostream & operator<<( std::ostream & os, VmError error );
+
+class Vm;
+
+// Receives control at breakpoints.
+class Debugger {
+public:
+    virtual ~Debugger() = default;
+    // Called before the instruction at `ip` runs, with `vm` as it is then. The
+    // debugger may inspect or change anything, including breakpoints. If it moves
+    // the IP, the instruction at `ip` is skipped.
+    virtual void onBreakpoint( Vm & vm, size_t ip ) = 0;
+};
+
 class Vm {
 public:
+    // Bounds on what a VM's execution may grow to. The host can still push data or
+    // code past them.
+    struct Limits {
+        size_t maxStackSlots = SIZE_MAX;
+        size_t maxFrameDepth = SIZE_MAX;
+    };
+
+    struct MemoryUsage {
+        size_t stackSlots = 0;
+        // The most slots ever in use, which is also what the data stack holds on to.
+        size_t peakStackSlots = 0;
+        size_t frameDepth = 0;
+        size_t peakFrameDepth = 0;
+        size_t codeBytes = 0;
+        // Function tables and labels. Labels are counted by their contents, without
+        // the hash map's own overhead.
+        size_t tableBytes = 0;
+        // Live and not yet collected objects.
+        size_t heapBytes = 0;
+    };
+
     Vm();
     Vm( std::vector< Bytecode > && code );
 
+    void setLimits( Limits limits ) { this->m_limits = limits; }
+    const Limits & limits() const { return this->m_limits; }
+    MemoryUsage memoryUsage() const;
+    // Reserves room for a run that used `usage`, e.g. the peak of a previous VM,
+    // so that one like it doesn't have to grow the stacks as it goes.
+    void reserveFor( const MemoryUsage & usage );
+
+    VmError error() const { return this->m_error; }
+    void clearError() { this->m_error = VmError::NONE; }
+    // Empties the data and call stacks and clears the accumulator and any error,
+    // keeping the code, tables and heap. The stacks keep their memory, so a reused
+    // VM starts out with room for as much as it has needed before.
+    void reset();
+
     Register accumulatorValue();
 
     void pushDataOntoStack( Register value );
     void setAccumulator( Register value );
+    bool accumulatorIsRef() const { return this->m_accumulatorIsRef; }
+
+    // Runs a collection now, rather than when the nursery fills up.
+    void collectGarbage( bool major = false );
 
     void executeInstruction( Bytecode instruction );
     void executeInstructions( const std::vector< Bytecode > & instructions );
+    // An error stops the VM by moving the IP past the end of the code, so that the
+    // loop driving it ends without checking for errors after every instruction.
+    // `run()` and `executeInstructions()` then put the IP back where execution
+    // resumes; a caller stepping through the code itself should call
+    // `restoreStoppedIp()` once it sees `error()` set.
     void executeNextInstruction();
+    void restoreStoppedIp();
+    // Executes from the next instruction until the end of the code or until the VM
+    // stops, and returns why it stopped: `VmError::NONE` if it got to the end. Any
+    // previous error is cleared first, so after `OUT_OF_FUEL`, add fuel and call
+    // this again to carry on.
+    VmError run();
+
+    // --- begin fuel ---------------------------------------------------------------
+    // Fuel bounds how long a VM runs before handing control back, e.g. so that
+    // several can take turns in one thread. It is measured in instructions, but
+    // only paid at CALL (the callee's whole body, from `functionCostTable`) and at
+    // taken backward branches (the instructions jumped back over), so execution
+    // never goes further than one function body or loop iteration without paying.
+    // Between those points, the interpreter does no fuel checks at all.
+    //
+    // Overspending leaves the fuel negative, and the debt is paid out of whatever
+    // is added next. There is no limit unless one is set.
+
+    void setFuel( I64 fuel ) { this->m_fuel = fuel; }
+    // Saturates, so that adding to the default (unlimited) fuel can't overflow.
+    void
+    addFuel( I64 fuel ) {
+        if ( fuel > 0 && this->m_fuel > INT64_MAX - fuel ) {
+            this->m_fuel = INT64_MAX;
+        } else if ( fuel < 0 && this->m_fuel < INT64_MIN - fuel ) {
+            this->m_fuel = INT64_MIN;
+        } else {
+            this->m_fuel += fuel;
+        }
+    }
+    I64 fuel() const { return this->m_fuel; }
+    // Recomputes `functionCostTable`, for when the code has been changed other
+    // than by defining labels.
+    void computeFunctionCosts();
+
+    // --- end fuel -----------------------------------------------------------------
 
     void printNextInstruction( std::ostream & os = std::cout ) const;
     void printRegisters( std::ostream & os = std::cout ) const;
     void printFunctionTable( std::ostream & os = std::cout ) const;
     void printCurrentState( std::ostream & os = std::cout ) const;
 
+    // --- begin breakpoints --------------------------------------------------------
+    // A breakpoint replaces the instruction at its IP with BREAK, keeping the
+    // original aside, so the interpreter does no per-instruction checks for them.
+    // Reaching one hands control to the debugger, then runs the original.
+    //
+    // `m_code` holds the BREAKs while breakpoints are set, so anything that reads
+    // or rewrites the code should use `codeWithoutBreakpoints()`, or clear them
+    // first.
+
+    void setDebugger( Debugger * debugger ) { this->m_debugger = debugger; }
+    void setBreakpoint( size_t ip );
+    void clearBreakpoint( size_t ip );
+    void clearBreakpoints();
+    bool hasBreakpoint( size_t ip ) const { return this->m_breakpoints.count( ip ); }
+    size_t breakpointCount() const { return this->m_breakpoints.size(); }
+    // The instruction at `ip`, as it is without breakpoints.
+    Bytecode instructionAt( size_t ip ) const;
+    std::vector< Bytecode > codeWithoutBreakpoints() const;
+
+    // --- end breakpoints ----------------------------------------------------------
+
     void pushInstruction( Bytecode instruction );
     void pushCallInstruction( const std::string & label );
+    void pushCallNativeInstruction( const std::string & name );
+
+    // --- begin natives ------------------------------------------------------------
+    // Native functions are called through a plain table of function pointers, by
+    // index. Registering one returns its index.
+
+    size_t registerNative( const std::string & name, NativeFunction function );
+    // Registers an ordinary function, e.g. `I32 hash( I32, I32 )`, through an
+    // adapter generated for its signature (see `adaptNative()`).
+    template < auto F >
+    size_t
+    registerNative( const std::string & name ) {
+        return this->registerNative( name, adaptNative< F >() );
+    }
+
+    // --- end natives --------------------------------------------------------------
+    // Points the branch at `branchIdx` to the instruction at `targetIdx`, e.g. once
+    // a forward target has been emitted.
+    void setBranchTarget( size_t branchIdx, size_t targetIdx );
 
     // --- begin labels -------------------------------------------------------------
     // Labels don't actually exist in the bytecode. They are just a convenience
@@ -105,8 +257,63 @@ public:
 
     std::vector< size_t > functionTable;
     std::vector< size_t > functionFrameSizeTable;
+    // The fuel a CALL of each function pays: the number of instructions in its
+    // body.
+    std::vector< U32 > functionCostTable;
     std::unordered_map< std::string, size_t > labels;
+    std::vector< NativeFunction > nativeTable;
+    std::unordered_map< std::string, size_t > nativeLabels;
     CallStack callStack;
 
     Register m_accumulator;
+    bool m_accumulatorIsRef = false;
+
+    Heap heap;
+
+private:
+    HeapRoots heapRoots();
+    // Sets the error and stops (see `executeNextInstruction()`), to resume at
+    // `resumeIdx`.
+    void
+    stop( VmError error, size_t resumeIdx ) {
+        this->m_error = error;
+        this->m_resumeIdx = resumeIdx;
+        this->m_nextInstructionIdx = this->m_code.size();
+    }
+    // Returns false after stopping, if `slots` more stack slots or `frames` more call
+    // frames would go past the limits. The instruction being executed isn't, and
+    // runs again on resuming.
+    bool withinLimits( size_t slots, size_t frames );
+    // Returns false after stopping, unless the ACC slots from `offset` on, and from
+    // `offset2` on, are all in the current frame.
+    bool slicesInFrame( size_t offset, size_t offset2 );
+    U32 functionCost( size_t functionIdx ) const;
+    void
+    consumeFuel( I64 amount ) {
+        this->m_fuel -= amount;
+        if ( this->m_fuel < 0 ) {
+            this->stop( VmError::OUT_OF_FUEL, this->m_nextInstructionIdx );
+        }
+    }
+    // Moves the IP by the offset of `branch`, paying for a loop iteration if it
+    // goes back.
+    void
+    takeBranch( Bytecode branch ) {
+        const I16 offset = branchOffset( branch );
+        this->m_nextInstructionIdx += offset;
+        if ( offset < 0 ) {
+            this->consumeFuel( -offset );
+        }
+    }
+
+    // Instructions replaced by BREAK, by IP.
+    std::unordered_map< size_t, Bytecode > m_breakpoints;
+    Debugger * m_debugger = nullptr;
+
+    Limits m_limits;
+    VmError m_error = VmError::NONE;
+    // Where to resume after stopping on `m_error`.
+    size_t m_resumeIdx = 0;
+    size_t m_peakFrameDepth = 0;
+    I64 m_fuel = INT64_MAX;
 };
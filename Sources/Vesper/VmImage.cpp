@@ -0,0 +1,348 @@
+// Copyright (C) 2025 by Varun Malladi
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+#include "VmImage.h"
+
+namespace VmImage {
+
+namespace {
+
+constexpr char MAGIC[ 4 ] = { 'V', 'S', 'P', 'I' };
+// Bump whenever the format changes, so old images are rejected.
+constexpr U32 FORMAT_VERSION = 2;
+
+struct Header {
+    char magic[ 4 ];
+    U32 version;
+    // The layouts copied as is, which differ between incompatible builds.
+    U32 bytecodeSize;
+    U32 registerSize;
+    U64 codeCount;
+    U64 functionCount;
+    U64 labelCount;
+    U64 labelNameBytes;
+    U64 stackSlots;
+    U64 baseIdx;
+    U64 topIdx;
+    U64 frameCount;
+    U64 nextInstructionIdx;
+    U64 tenuredWords;
+    U32 accumulator;
+    U32 accumulatorIsRef;
+};
+
+static_assert( std::is_trivially_copyable_v< Bytecode > );
+static_assert( std::is_trivially_copyable_v< Register > &&
+               sizeof( Register ) == sizeof( U32 ) );
+
+// Sections follow the header in this order:
+// - code: `Bytecode[ codeCount ]`
+// - function table, then frame sizes: `U64[ functionCount ]` each
+// - function costs: `U32[ functionCount ]`
+// - labels: `{ U64 value, U64 nameLength }[ labelCount ]`, then the names, back to
+//   back (`labelNameBytes` in all)
+// - stack: `Register[ stackSlots ]`, then its reference flags, `U8[ stackSlots ]`
+// - call frames, from the bottom: `{ U64 ip, U64 sbp, U64 sp }[ frameCount ]`
+// - tenured space: `U32[ tenuredWords ]`
+
+template < typename T >
+void
+append( std::string & out, const T * items, size_t count ) {
+    out.append( reinterpret_cast< const char * >( items ), count * sizeof( T ) );
+}
+
+template < typename T >
+void
+append( std::string & out, T item ) {
+    append( out, &item, 1 );
+}
+
+// Bounds-checked reads. Once a read fails, `ok` stays false and every later read
+// returns nothing, so callers can check once at the end.
+class Reader {
+public:
+    explicit Reader( std::string_view bytes ) : m_bytes( bytes ) {}
+
+    bool ok = true;
+
+    // Copies `count` records of `itemsPerRecord` items each into `out`, which is
+    // resized to fit. Counts come from the image, so they are only multiplied out
+    // once `skip()` has found that many bytes.
+    template < typename T >
+    void
+    take( std::vector< T > & out, U64 count, size_t itemsPerRecord = 1 ) {
+        const char * p = this->skip( count, itemsPerRecord * sizeof( T ) );
+        const size_t items = p ? count * itemsPerRecord : 0;
+        out.resize( items );
+        if ( p ) {
+            std::memcpy( out.data(), p, items * sizeof( T ) );
+        }
+    }
+
+    // Returns null if there aren't `count` items of `size` bytes left.
+    const char *
+    skip( U64 count, size_t size ) {
+        if ( !this->ok || count > ( this->m_bytes.size() - this->m_offset ) / size ) {
+            this->ok = false;
+            return nullptr;
+        }
+        const char * p = this->m_bytes.data() + this->m_offset;
+        this->m_offset += count * size;
+        return p;
+    }
+
+    bool atEnd() const { return this->m_offset == this->m_bytes.size(); }
+
+private:
+    std::string_view m_bytes;
+    size_t m_offset = 0;
+};
+
+} // namespace
+
+std::string
+serialize( Vm & vm ) {
+    vm.collectGarbage( true );
+    const auto & stack = vm.m_stack;
+    const auto & tenured = vm.heap.tenuredWords();
+
+    const auto & frames = vm.callStack.frames;
+
+    U64 labelNameBytes = 0;
+    for ( const auto & [ name, value ] : vm.labels ) {
+        labelNameBytes += name.size();
+    }
+
+    Header header = {};
+    std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+    header.version = FORMAT_VERSION;
+    header.bytecodeSize = sizeof( Bytecode );
+    header.registerSize = sizeof( Register );
+    header.codeCount = vm.m_code.size();
+    header.functionCount = vm.functionTable.size();
+    header.labelCount = vm.labels.size();
+    header.labelNameBytes = labelNameBytes;
+    header.stackSlots = stack.m_stack.size();
+    header.baseIdx = stack.m_baseIdx;
+    header.topIdx = stack.m_topIdx;
+    header.frameCount = frames.size();
+    header.nextInstructionIdx = vm.m_nextInstructionIdx;
+    header.tenuredWords = tenured.size();
+    header.accumulator = vm.m_accumulator.ref;
+    header.accumulatorIsRef = vm.m_accumulatorIsRef;
+
+    if ( vm.functionCostTable.size() != vm.functionTable.size() ) {
+        vm.computeFunctionCosts();
+    }
+
+    std::string out;
+    out.reserve( sizeof( header ) + vm.m_code.size() * sizeof( Bytecode ) +
+                 stack.m_stack.size() * ( sizeof( Register ) + 1 ) +
+                 tenured.size() * sizeof( U32 ) );
+    append( out, header );
+    const auto code = vm.codeWithoutBreakpoints();
+    append( out, code.data(), code.size() );
+    for ( const auto entry : vm.functionTable ) {
+        append( out, U64( entry ) );
+    }
+    for ( const auto frameSize : vm.functionFrameSizeTable ) {
+        append( out, U64( frameSize ) );
+    }
+    append( out, vm.functionCostTable.data(), vm.functionCostTable.size() );
+    for ( const auto & [ name, value ] : vm.labels ) {
+        append( out, U64( value ) );
+        append( out, U64( name.size() ) );
+    }
+    for ( const auto & [ name, value ] : vm.labels ) {
+        out.append( name );
+    }
+    append( out, stack.m_stack.data(), stack.m_stack.size() );
+    append( out, stack.m_isRef.data(), stack.m_isRef.size() );
+    for ( const auto & frame : frames ) {
+        append( out, U64( frame.ip ) );
+        append( out, U64( frame.sbp ) );
+        append( out, U64( frame.sp ) );
+    }
+    append( out, tenured.data(), tenured.size() );
+    return out;
+}
+
+bool
+deserialize( std::string_view bytes, Vm & vm ) {
+    Reader reader( bytes );
+    const char * headerBytes = reader.skip( 1, sizeof( Header ) );
+    if ( !headerBytes ) {
+        return false;
+    }
+    Header header;
+    std::memcpy( &header, headerBytes, sizeof( header ) );
+    if ( std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 ||
+         header.version != FORMAT_VERSION || header.bytecodeSize != sizeof( Bytecode ) ||
+         header.registerSize != sizeof( Register ) ) {
+        return false;
+    }
+
+    // Everything is read into temporaries, so a bad image leaves `vm` alone.
+    std::vector< Bytecode > code;
+    std::vector< U64 > functionTable;
+    std::vector< U64 > frameSizes;
+    std::vector< U32 > functionCosts;
+    std::vector< U64 > labelRecords;
+    // `Register` has no default constructor, so slots are read as raw words.
+    std::vector< U32 > slotWords;
+    std::vector< std::uint8_t > isRef;
+    std::vector< U64 > frameWords;
+    std::vector< U32 > tenured;
+    reader.take( code, header.codeCount );
+    reader.take( functionTable, header.functionCount );
+    reader.take( frameSizes, header.functionCount );
+    reader.take( functionCosts, header.functionCount );
+    reader.take( labelRecords, header.labelCount, 2 );
+    const char * names = reader.skip( header.labelNameBytes, 1 );
+    reader.take( slotWords, header.stackSlots );
+    reader.take( isRef, header.stackSlots );
+    reader.take( frameWords, header.frameCount, 3 );
+    reader.take( tenured, header.tenuredWords );
+    if ( !reader.ok || !reader.atEnd() || header.tenuredWords == 0 ||
+         header.baseIdx > header.topIdx || header.topIdx > header.stackSlots ||
+         header.nextInstructionIdx > header.codeCount ) {
+        return false;
+    }
+    // Anything that indexes the code or the stack must be in range, or running the
+    // restored VM would read out of bounds.
+    for ( const auto entry : functionTable ) {
+        if ( entry > header.codeCount ) {
+            return false;
+        }
+    }
+    for ( U64 i = 0; i < header.frameCount; ++i ) {
+        const U64 ip = frameWords[ 3 * i ];
+        const U64 sbp = frameWords[ 3 * i + 1 ];
+        const U64 sp = frameWords[ 3 * i + 2 ];
+        if ( ip > header.codeCount || sbp > sp || sp > header.stackSlots ) {
+            return false;
+        }
+    }
+
+    // Likewise every reference, or the heap would read (and a collection write)
+    // wherever it pointed.
+    std::vector< U32 > roots;
+    for ( size_t i = 0; i < slotWords.size(); ++i ) {
+        if ( isRef[ i ] ) {
+            roots.push_back( slotWords[ i ] );
+        }
+    }
+    if ( header.accumulatorIsRef ) {
+        roots.push_back( header.accumulator );
+    }
+    if ( !Heap::isValidTenured( tenured.data(), tenured.size(), roots ) ) {
+        return false;
+    }
+
+    std::unordered_map< std::string, size_t > labels;
+    labels.reserve( header.labelCount );
+    U64 nameOffset = 0;
+    for ( U64 i = 0; i < header.labelCount; ++i ) {
+        const U64 nameLength = labelRecords[ 2 * i + 1 ];
+        if ( nameLength > header.labelNameBytes - nameOffset ||
+             labelRecords[ 2 * i ] >= header.functionCount ) {
+            return false;
+        }
+        labels.emplace( std::string( names + nameOffset, nameLength ),
+                        labelRecords[ 2 * i ] );
+        nameOffset += nameLength;
+    }
+
+    vm.clearBreakpoints();
+    vm.m_code = std::move( code );
+    vm.functionTable.assign( functionTable.begin(), functionTable.end() );
+    vm.functionFrameSizeTable.assign( frameSizes.begin(), frameSizes.end() );
+    vm.functionCostTable = std::move( functionCosts );
+    vm.labels = std::move( labels );
+    vm.m_stack.m_stack.assign( slotWords.size(), Register( 0 ) );
+    for ( size_t i = 0; i < slotWords.size(); ++i ) {
+        vm.m_stack.m_stack[ i ].ref = slotWords[ i ];
+    }
+    vm.m_stack.m_isRef = std::move( isRef );
+    vm.m_stack.m_baseIdx = header.baseIdx;
+    vm.m_stack.m_topIdx = header.topIdx;
+    vm.callStack = CallStack();
+    for ( U64 i = 0; i < header.frameCount; ++i ) {
+        vm.callStack.push(
+            { frameWords[ 3 * i ], frameWords[ 3 * i + 1 ], frameWords[ 3 * i + 2 ] } );
+    }
+    vm.m_nextInstructionIdx = header.nextInstructionIdx;
+    vm.m_accumulator.ref = header.accumulator;
+    vm.m_accumulatorIsRef = header.accumulatorIsRef;
+    vm.clearError();
+    vm.heap.restoreTenured( tenured.data(), tenured.size() );
+    return true;
+}
+
+bool
+save( Vm & vm, const std::string & path ) {
+    const auto bytes = serialize( vm );
+    const auto tempPath = path + ".tmp." + std::to_string( getpid() );
+
+    const int fd = open( tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 ) {
+        std::cerr << "error: " << tempPath << ": " << std::strerror( errno ) << "\n";
+        return false;
+    }
+    size_t written = 0;
+    while ( written < bytes.size() ) {
+        const auto n = write( fd, bytes.data() + written, bytes.size() - written );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            std::cerr << "error: " << tempPath << ": " << std::strerror( errno ) << "\n";
+            close( fd );
+            unlink( tempPath.c_str() );
+            return false;
+        }
+        written += n;
+    }
+    close( fd );
+    if ( rename( tempPath.c_str(), path.c_str() ) != 0 ) {
+        std::cerr << "error: " << path << ": " << std::strerror( errno ) << "\n";
+        unlink( tempPath.c_str() );
+        return false;
+    }
+    return true;
+}
+
+bool
+load( const std::string & path, Vm & vm ) {
+    const int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+        close( fd );
+        return false;
+    }
+    const size_t size = static_cast< size_t >( st.st_size );
+    void * mapping = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( mapping == MAP_FAILED ) {
+        return false;
+    }
+    madvise( mapping, size, MADV_SEQUENTIAL );
+    const bool ok = deserialize(
+        std::string_view( static_cast< const char * >( mapping ), size ), vm );
+    munmap( mapping, size );
+    return ok;
+}
+
+} // namespace VmImage
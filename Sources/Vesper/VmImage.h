@@ -0,0 +1,41 @@
+/* Copyright (C) 2025 by Varun Malladi */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "Vm.h"
+
+// Snapshots of a whole `Vm`, so that a process can skip its setup (defining labels,
+// running initialization code) and resume from where another one left off.
+//
+// An image holds the code (without breakpoints), the function tables and labels, the
+// data stack with its reference flags, the call stack, the accumulator and the next
+// instruction, and the heap. Every section is a flat array in native layout, so
+// restoring is a bulk copy per section, and takes time proportional to the size of
+// the image rather than to the work that produced it. Only the labels are rebuilt
+// one by one.
+//
+// Native functions are pointers into the process, so they aren't saved: the VM an
+// image is restored into keeps its own, which must be registered in the same order.
+//
+// Images are in native byte order and are not meant to be portable. One that is
+// truncated, written by an incompatible build, or has indices or heap references
+// out of place is rejected.
+namespace VmImage {
+
+// Runs a major collection first, so that every live object is tenured and the
+// nursery needn't be saved. References in `vm` may change as a result.
+std::string serialize( Vm & vm );
+// Replaces the state of `vm` with the image's, with no error set. Returns false,
+// leaving `vm` as it was, if `bytes` isn't a usable image.
+bool deserialize( std::string_view bytes, Vm & vm );
+
+// As above, through a file. Saving writes a temporary file and renames it into
+// place, so a concurrent load never sees half an image, and prints why if it
+// fails. Loading `mmap`s the image, privately and read-only.
+bool save( Vm & vm, const std::string & path );
+bool load( const std::string & path, Vm & vm );
+
+} // namespace VmImage